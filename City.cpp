@@ -1,10 +1,12 @@
 // Created by david on 4/10/2024.
 
 #include "City.h"
+#include "metrics.h"
 #include <iostream>
 #include <cmath>
 #include <vector>
 #include <fstream>
+#include <algorithm>
 
 // Constructors
 
@@ -12,31 +14,81 @@ City::City() {
     this->rows = 64;
     this->cols = 64;
     this->mapSize = 64;
-    this->cityMap = std::vector<std::vector<int>>(cols, std::vector<int>(rows, EMPTY));
+    this->cityMap.allocate(rows, cols, EMPTY);
 
-    generateMap();
+    generateMap(std::random_device()());
 }
 
-City::City(int size) {
-    // ensure its large enough to generate anything meaningful
-    if (size <= 1) {
-        size = 3;
+City::City(int size, int hubCount) : City(size, hubCount, std::random_device()()) {
+}
+
+/**
+ * Constructor that generates the same city every time for the same seed, used to make benchmarks repeatable
+ * @param size 1 for a 64x64 city, 2 for a 256x256 city
+ * @param hubCount how many hubs to build
+ * @param seed seed for the random number generator
+ */
+City::City(int size, int hubCount, unsigned int seed) : City(size, hubCount, seed, true) {
+}
+
+/**
+ * Constructor that generates the same city every time for the same seed
+ * @param size 1 for a 64x64 city, 2 for a 256x256 city
+ * @param hubCount how many hubs to build
+ * @param seed seed for the random number generator
+ * @param writeMap false to skip writing map.txt, the map is then only read through fillGrid and fillHouses
+ */
+City::City(int size, int hubCount, unsigned int seed, bool writeMap) {
+    this->writeMap = writeMap;
     // ensure its small enough to output
-    } else if (size >= 2) {
-        size = 4;
+    setSize(std::min(size, 2), hubCount);
+    this->cityMap.allocate(rows, cols, EMPTY);
+
+    generateMap(seed);
+}
+
+/**
+ * Constructor that generates the city into a tile file instead of memory, only a bounded number of tiles are in
+ * memory at once so the map can be much bigger than the memory of the machine. If the file cant be made nothing is
+ * generated and getGrid().isFileBacked() is false
+ * @param size 1 - 5, the city is 4^(size + 2) cells on each side (5 is 16384x16384, a 1 GB file)
+ * @param hubCount how many hubs to build
+ * @param seed seed for the random number generator
+ * @param tilePath where to make the tile file
+ * @param cacheTiles the most 16 KB tiles kept in memory at once
+ */
+City::City(int size, int hubCount, unsigned int seed, const std::string& tilePath, size_t cacheTiles) {
+    setSize(std::min(size, MAX_TILED_SIZE), hubCount);
+    if (!this->cityMap.create(tilePath, rows, cols, EMPTY, cacheTiles)) {
+        return;
     }
 
-    this->mapSize = (int)pow(4,size);
-    this->rows = (int)pow(4,size);
-    this->cols = (int)pow(4, size);
+    generateMap(seed);
+    this->cityMap.flush();
+}
 
-    this->cityMap = std::vector<std::vector<int>>(cols, std::vector<int>(rows, EMPTY));
+/**
+ * Work out the dimensions from the size given to a constructor
+ * @param size the size, 1 is the smallest
+ * @param hubCount how many hubs to build
+ */
+void City::setSize(int size, int hubCount) {
+    // ensure its large enough to generate anything meaningful
+    int exponent = std::max(size, 1) + 2;
 
-    generateMap();
+    this->mapSize = (int)pow(4,exponent);
+    this->rows = (int)pow(4,exponent);
+    this->cols = (int)pow(4, exponent);
+    this->hubCount = std::max(1, hubCount);
 }
 // end of constructors
 
-void City::printMapToFile(const std::vector<std::vector<int>>& matrix) {
+/**
+ * Write the map to map.txt a row at a time, a row of tiles stays in memory while its rows are written
+ * so even a tiled map is read from its file only once
+ */
+void City::printMapToFile() {
+    METRICS_TIMER("city.write_map");
     std::ofstream outFile("map.txt"); // Create an ofstream object for output to a file
 
     if (!outFile) {
@@ -44,9 +96,10 @@ void City::printMapToFile(const std::vector<std::vector<int>>& matrix) {
         return;
     }
 
-    // Output the 2D vector to the file with double spaces
-    for (const auto &row : matrix) {
-        for (int elem : row) {
+    // Output every cell to the file separated by commas
+    for (int row = 0; row < rows; row++) {
+        for (int col = 0; col < cols; col++) {
+            int elem = getSpot(row, col);
             if (elem == -1) {
                 outFile << "-1"; // Double space after each character
             } else if (elem == -2) {
@@ -60,6 +113,7 @@ void City::printMapToFile(const std::vector<std::vector<int>>& matrix) {
         }
         outFile << "\n"; // New line after each row
     }
+    METRICS_COUNT("city.map_bytes_written", (long long)outFile.tellp());
 
     outFile.close(); // Close the file after writing
 }
@@ -73,6 +127,11 @@ void City::printMapToFile(const std::vector<std::vector<int>>& matrix) {
  * @param max the maximum number to generate
  */
 int City::generateRandomNumber(std::mt19937& gen, int min, int max) {
+    // an inverted range is undefined for uniform_int_distribution (it recurses forever on some standard libraries)
+    // so hand back min, callers already treat a number outside of their range as invalid
+    if (max < min) {
+        return min;
+    }
     std::uniform_int_distribution<int> dist(min, max);
     return dist(gen);
 }
@@ -118,21 +177,21 @@ int City::generateRandomNeighborhoodLength(std::pair<int,int> coordinates, std::
 
 bool City::isHouse(std::pair<int,int> coordinates) {
     // if the value at that point is greater than road it's a house
-    if (this->cityMap[coordinates.first][coordinates.second] > ROAD) {
+    if (getSpot(coordinates.first, coordinates.second) > ROAD) {
         return true;
     }
     return false;
 }
 
 bool City::isRoad(std::pair<int,int> coordinates) {
-    if (this->cityMap[coordinates.first][coordinates.second] == ROAD) {
+    if (getSpot(coordinates.first, coordinates.second) == ROAD) {
         return true;
     }
     return false;
 }
 
 bool City::isEmpty(std::pair<int,int> coordinates) {
-    if (this->cityMap[coordinates.first][coordinates.second] == EMPTY) {
+    if (getSpot(coordinates.first, coordinates.second) == EMPTY) {
         return true;
     }
     return false;
@@ -182,7 +241,17 @@ bool City::inBounds(std::pair<int,int> coordinates) const {
  * @return the information stored at row, col
  */
 int City::getSpot(int row, int col) {
-    return this->cityMap[row][col];
+    return this->cityMap.get(row, col);
+}
+
+/**
+ * Sets the spot at row and col on the cityMap
+ * @param row the row of the spot to set
+ * @param col the col of the spot to set
+ * @param value what to store there (EMPTY, HUB, ROAD or a house number)
+ */
+void City::setSpot(int row, int col, int value) {
+    this->cityMap.set(row, col, value);
 }
 
 // getter for max row
@@ -203,6 +272,47 @@ std::pair<int,int> City::getHubLocation() const {
     return std::make_pair(this->hubx, this->huby);
 }
 
+// getter for every hub, the first one is the same as getHubLocation()
+std::vector<std::pair<int,int>> City::getHubLocations() const {
+    return this->hubs;
+}
+
+// getter for the cells of the map, for reading a tiled map back without holding it all in memory
+TiledGrid& City::getGrid() {
+    return this->cityMap;
+}
+
+/**
+ * Fill a dijkstra grid straight from the map, the same grid MapReader::buildGrid makes from map.txt.
+ * The rows of the grid are reused if it already has the right size
+ * @param grid set to 1 for every cell that isnt empty and 0 for the rest
+ */
+void City::fillGrid(std::vector<std::vector<int>>& grid) {
+    grid.resize(rows);
+    for (int row = 0; row < rows; row++) {
+        grid[row].resize(cols);
+        for (int col = 0; col < cols; col++) {
+            grid[row][col] = getSpot(row, col) != EMPTY;
+        }
+    }
+}
+
+/**
+ * Fill a list of every house straight from the map, the same list MapReader::findHouses makes from map.txt
+ * @param houses cleared and then given every house with x as the column, y as the row and c as its house number
+ */
+void City::fillHouses(std::vector<Point>& houses) {
+    houses.clear();
+    for (int row = 0; row < rows; row++) {
+        for (int col = 0; col < cols; col++) {
+            int spot = getSpot(row, col);
+            if (spot > 0) {
+                houses.push_back(Point{(float)col, (float)row, std::to_string(spot)});
+            }
+        }
+    }
+}
+
 // end of getters
 // ####################################################################################################################
 // Polymorphic street building methods for roads and infrastructure
@@ -213,7 +323,7 @@ std::pair<int,int> City::getHubLocation() const {
  */
 void City::buildRoad(std::pair<int,int> coordinates) {
     if(isValid(coordinates)) {
-        cityMap[coordinates.first][coordinates.second] = ROAD;
+        setSpot(coordinates.first, coordinates.second, ROAD);
     }
 }
 
@@ -227,7 +337,7 @@ void City::buildHouse(std::pair<int,int> coordinates, std::pair<int,int> directi
     std::pair<int,int> newCoordinates = updateCoordinates(coordinates,direction);
     if(isValid(newCoordinates)) {
         this->houseCount++;
-        cityMap[newCoordinates.first][newCoordinates.second] = houseCount;
+        setSpot(newCoordinates.first, newCoordinates.second, houseCount);
     }
 }
 
@@ -263,7 +373,7 @@ void City::buildHighway(std::pair<int,int> curCoordinates, std::pair<int,int> cu
         }
 
         // if there isn't much room left for the road then turn to an optimal direction for it to continue
-        if (probeBounds(curCoordinates,curDirection) <= 3) {
+        if (probeBounds(curCoordinates,curDirection,4) <= 3) {
             curDirection = choseOptimalDirection(curCoordinates,curDirection,gen);
             iterationsNoBranch = 0; // we count a turn as a branch otherwise it generates poorly
         }
@@ -318,7 +428,7 @@ void City::buildStreet(std::pair<int,int> curCoordinates, std::pair<int,int> cur
         }
 
         // if there isn't much room left for the road then turn to an optimal direction for it to continue
-        if (probeBounds(curCoordinates,curDirection) <= 3) {
+        if (probeBounds(curCoordinates,curDirection,4) <= 3) {
             curDirection = choseOptimalDirection(curCoordinates,curDirection,gen);
             iterationsNoBranch = 0; // we count a turn as a branch otherwise it generates poorly
         }
@@ -373,7 +483,7 @@ void City::buildNeighborhood(std::pair<int,int> curCoordinates, std::pair<int,in
         }
 
         // if there isn't much room left for the road then turn to an optimal direction for it to continue
-        if (probeBounds(curCoordinates,curDirection) <= 3) {
+        if (probeBounds(curCoordinates,curDirection,4) <= 3) {
             curDirection = choseOptimalDirection(curCoordinates,curDirection,gen);
             iterationsNoHouse = 0; // we count a turn as a branch otherwise it generates poorly
         }
@@ -404,15 +514,22 @@ void City::buildNeighborhood(std::pair<int,int> curCoordinates, std::pair<int,in
 /**
  * Place the hub randomly on the cityMap then generate a highway going N/S or E/W adjacent to the hub
  * this will prompt the rest of the maps generation. The random spot this choses is basically the origin point
+ * every hub after the first is placed on a spot that hasnt been built on yet
  * @param gen the random number generator
  * @returns a vector of two pairs, the first is the coordinates of the hub, the second is the direction to go
  */
 std::vector<std::pair<int,int>> City::buildHub(std::mt19937& gen) {
     // randomly find hub location
     std::pair<int,int> currentLocation = pickRandomSpot(gen);
-    this->hubx = currentLocation.first;
-    this->huby = currentLocation.second;
-    this->cityMap[hubx][huby] = HUB;
+    while (!isEmpty(currentLocation)) {
+        currentLocation = pickRandomSpot(gen);
+    }
+    if (this->hubs.empty()) {
+        this->hubx = currentLocation.first;
+        this->huby = currentLocation.second;
+    }
+    this->hubs.push_back(currentLocation);
+    setSpot(currentLocation.first, currentLocation.second, HUB);
 
     // at this location find the optimal direction (can also be done mathematically)
     std::pair<int,int> optimalDirection = choseOptimalDirection(currentLocation,std::make_pair(0,0),gen);
@@ -512,7 +629,11 @@ std::pair<int,int> City::choseSidewaysDirection(std::pair<int,int> coordinates,
  * @return
  */
 std::pair<int,int> City::choseOptimalDirection(std::pair<int,int> coordinates, std::pair<int,int> currentDirection, std::mt19937& gen) {
-    std::pair<int,int> finalDirection;
+    // when every direction is blocked keep going the way we were, a zero direction would never leave its cell
+    std::pair<int,int> finalDirection = currentDirection;
+    if (finalDirection == std::make_pair(0, 0)) {
+        finalDirection = this->DIRECTIONS[0];
+    }
     int maxLen = 0;
     int probeLength;
 
@@ -557,12 +678,14 @@ int City::probeDirection(std::pair<int,int> coordinates, std::pair<int,int> dire
  * this WILL NOT count roads. This allows roads to connect when using this method for validation
  * @param coordinates the current coordinates
  * @param direction the current direction
- * @return the length before a house or boundary is reached
+ * @param limit stop probing after this many cells, the builders only need to know if there are more than 3 and
+ *              walking to the edge of a large map on every step made generation quadratic
+ * @return the length before a house or boundary is reached, at most limit
  */
-int City::probeBounds(std::pair<int,int> coordinates, std::pair<int,int> direction) {
+int City::probeBounds(std::pair<int,int> coordinates, std::pair<int,int> direction, int limit) {
     std::pair<int,int> newCoordinates = updateCoordinates(coordinates,direction);
     int distance = 0;
-    while (inBounds(newCoordinates) && !isHouse(newCoordinates)) {
+    while (distance < limit && inBounds(newCoordinates) && !isHouse(newCoordinates)) {
         newCoordinates = updateCoordinates(newCoordinates,direction);
         distance++;
     }
@@ -594,10 +717,11 @@ std::pair<int,int> City::pickRandomSpot(std::mt19937& gen) const {
 /**
  * Creates a random number generator and passes it into the city builder function
  * Basically calls the city generation through generateCity(std::mt19937 gen)
+ * @param seed seed for the random number generator
  */
-void City::generateMap() {
-    std::random_device rd;  // a random seed for the mt19937
-    std::mt19937 gen(rd()); // random number generator with a random seed
+void City::generateMap(unsigned int seed) {
+    METRICS_TIMER("city.generate");
+    std::mt19937 gen(seed); // random number generator with the given seed
     generateCity(gen);
 }
 
@@ -617,14 +741,23 @@ void City::generateCity(std::mt19937& gen) {
     currentDirection = hubAdjacency[1];
 
     int maxLength = generateRandomHighwayLength(currentSpot,currentDirection,gen);
+    buildHighway(currentSpot,currentDirection,maxLength,gen);
+
+    // every other hub starts its own highway, these grow into the roads that are already there
+    for (int hub = 1; hub < this->hubCount; hub++) {
+        std::vector<std::pair<int,int>> otherAdjacency = buildHub(gen);
+        int otherLength = generateRandomHighwayLength(otherAdjacency[0],otherAdjacency[1],gen);
+        buildHighway(otherAdjacency[0],otherAdjacency[1],otherLength,gen);
+    }
 
     // ensure we generate a map with houses, it is random after all
     while (this->houseCount == 0) {
         buildHighway(currentSpot,currentDirection,maxLength,gen);
     }
 
-    //printMap(this->cityMap); // prints the map to the console
-    printMapToFile(this->cityMap);
+    if (this->writeMap) {
+        printMapToFile();
+    }
 }
 
 // end main generation methods
@@ -7,6 +7,8 @@
 #include <vector>
 #include <cmath>
 #include <random>
+#include "quadtree.h"
+#include "tiledgrid.h"
 
 /*
  * City generator class, given a size as integer procedurally generates a city
@@ -19,11 +21,14 @@ private:
     const int HUB = -2;
     const int ROAD = -1;
 
+    // the biggest size a tiled city can be generated at, 16384x16384
+    static const int MAX_TILED_SIZE = 5;
+
     // Directions N,S,E,W
     const std::vector<std::pair<int,int>> DIRECTIONS = {{-1,0},{1,0},{0,1},{0,-1}};
 
     // Class attributes
-    std::vector<std::vector<int>> cityMap;
+    TiledGrid cityMap;
     int rows, cols;
     int mapSize;
     int roadCount = 0;
@@ -31,6 +36,10 @@ private:
 
     int hubx = -1;
     int huby = -1;
+    int hubCount = 1;
+    std::vector<std::pair<int,int>> hubs;
+    // false keeps the map in memory only, for running many cities in one process
+    bool writeMap = true;
 
     // validation and positional checking
     bool isHouse(std::pair<int,int> coordinates);
@@ -41,6 +50,7 @@ private:
 
     // spacial localization and orientation
     int getSpot(int row, int col);
+    void setSpot(int row, int col, int value);
     std::pair<int,int> pickRandomSpot(std::mt19937& gen) const;
     bool countAdjacentRoads(std::pair<int,int> coordinates);
     std::pair<int,int> updateCoordinates(std::pair<int,int> coordinates, std::pair<int,int> direction);
@@ -51,7 +61,7 @@ private:
 
     // road and infrastructure building
     int probeDirection(std::pair<int,int> coordinates, std::pair<int,int> direction);
-    int probeBounds(std::pair<int,int> coordinates, std::pair<int,int> direction);
+    int probeBounds(std::pair<int,int> coordinates, std::pair<int,int> direction, int limit);
 
     void buildRoad(std::pair<int,int> coordinates);
     void buildHouse(std::pair<int,int> coordinates, std::pair<int,int> direction);
@@ -63,8 +73,9 @@ private:
     std::vector<std::pair<int,int>> buildHub(std::mt19937& gen);
 
     // main generators / runners
+    void setSize(int size, int hubCount);
     void generateCity(std::mt19937& gen);
-    void generateMap();
+    void generateMap(unsigned int seed);
 
     // random number generators
     int generateRandomNeighborhoodLength(std::pair<int,int> coordinates, std::pair<int,int> currentDirection, std::mt19937& gen);
@@ -74,20 +85,28 @@ private:
 public:
     // City constructors
     City();
-    explicit City(int size);
+    explicit City(int size, int hubCount = 1);
+    City(int size, int hubCount, unsigned int seed);
+    City(int size, int hubCount, unsigned int seed, bool writeMap);
+    City(int size, int hubCount, unsigned int seed, const std::string& tilePath,
+         size_t cacheTiles = TiledGrid::DEFAULT_CACHE_TILES);
 
     // City getter methods
     int getMaxRows() const;
     int getMaxCols() const;
     int getHouseCount() const;
     std::pair<int,int> getHubLocation() const;
+    std::vector<std::pair<int,int>> getHubLocations() const;
+    TiledGrid& getGrid();
+    void fillGrid(std::vector<std::vector<int>>& grid);
+    void fillHouses(std::vector<Point>& houses);
 
 
     // public random number generator for utility
     int generateRandomNumber(std::mt19937& gen, int min, int max);
 
     // print the map to file
-    void printMapToFile(const std::vector<std::vector<int>>& matrix);
+    void printMapToFile();
 };
 
 #endif //UNTITLED17_CITY_H
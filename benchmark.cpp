@@ -0,0 +1,545 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "City.h"
+#include "quadtree.h"
+#include "dijkstra.h"
+#include "bucketsort.h"
+#include "radixsort.h"
+#include "routeoptimizer.h"
+#include "fleetplanner.h"
+#include "ordersampler.h"
+#include "orderclusterer.h"
+#include "mapreader.h"
+#include "snapshot.h"
+#include "citysession.h"
+#include "dynamicrouter.h"
+#include "timedependentrouter.h"
+#include "hierarchicalrouter.h"
+#include "landmarkrouter.h"
+#include "bitbfs.h"
+#include "tiledrouter.h"
+#include "shardedrouter.h"
+#include "simulation.h"
+
+// every benchmark draws from a generator with this seed so runs can be compared against each other
+static const unsigned int SEED = 20240410;
+
+/*
+ * Tiny benchmark runner. Every benchmark is run a fixed amount of times, each run is timed on its own and the
+ * mean, 50th, 90th and 99th percentile and the throughput (items per second over the mean) are printed
+ */
+class BenchmarkRunner {
+public:
+    explicit BenchmarkRunner(const std::string& filter) : filter(filter) {
+        std::printf("%-36s %8s %12s %12s %12s %12s %16s\n", "benchmark", "samples", "mean ms", "p50 ms", "p90 ms", "p99 ms", "items/s");
+    }
+
+    /**
+     * Run one benchmark
+     * @param name the name printed in the report, also what the filter matches against
+     * @param samples how many times to run the task
+     * @param items how many items (cells, queries, keys...) a single run handles, used for the throughput
+     * @param task the work to time, given the sample number
+     * @param setup untimed work done before every sample (for example copying the keys to sort), can be empty
+     */
+    void run(const std::string& name, int samples, long long items, const std::function<void(int)>& task,
+             const std::function<void(int)>& setup = std::function<void(int)>()) {
+        if (name.find(filter) == std::string::npos) {
+            return;
+        }
+        std::vector<double> times;
+        for (int sample = 0; sample < samples; sample++) {
+            if (setup) {
+                setup(sample);
+            }
+            auto start = std::chrono::steady_clock::now();
+            task(sample);
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            times.push_back(elapsed.count());
+        }
+
+        std::sort(times.begin(), times.end());
+        double total = 0;
+        for (double time : times) {
+            total += time;
+        }
+        double mean = total / times.size();
+        double throughput = mean > 0 ? items / (mean / 1000) : 0;
+        std::printf("%-36s %8d %12.4f %12.4f %12.4f %12.4f %16.0f\n", name.c_str(), samples, mean,
+                    percentile(times, 0.5), percentile(times, 0.9), percentile(times, 0.99), throughput);
+        std::fflush(stdout);
+    }
+
+private:
+    std::string filter;
+
+    /**
+     * Nearest rank percentile of sorted samples
+     */
+    static double percentile(const std::vector<double>& sorted, double fraction) {
+        int rank = (int)(fraction * sorted.size() + 0.999999) - 1;
+        return sorted[std::max(0, std::min(rank, (int)sorted.size() - 1))];
+    }
+};
+
+/**
+ * Random pairs of houses as (x, y) Dijkstra coordinates
+ */
+static std::vector<std::pair<std::pair<int,int>, std::pair<int,int>>> pickHousePairs(const std::vector<Point>& houses, int count, std::mt19937& gen) {
+    std::uniform_int_distribution<int> pick(0, houses.size() - 1);
+    std::vector<std::pair<std::pair<int,int>, std::pair<int,int>>> pairs;
+    for (int i = 0; i < count; i++) {
+        const Point& from = houses[pick(gen)];
+        const Point& to = houses[pick(gen)];
+        pairs.push_back(std::make_pair(std::make_pair((int)from.x, (int)from.y), std::make_pair((int)to.x, (int)to.y)));
+    }
+    return pairs;
+}
+
+/**
+ * A symmetric distance matrix between random points on a 256x256 grid, manhattan distances like the road grid has
+ */
+static std::vector<std::vector<int>> randomDistances(int stops, std::mt19937& gen) {
+    std::uniform_int_distribution<int> coordinate(0, 255);
+    std::vector<std::pair<int,int>> points;
+    for (int i = 0; i < stops; i++) {
+        points.push_back(std::make_pair(coordinate(gen), coordinate(gen)));
+    }
+    std::vector<std::vector<int>> distances(stops, std::vector<int>(stops));
+    for (int i = 0; i < stops; i++) {
+        for (int j = 0; j < stops; j++) {
+            distances[i][j] = std::abs(points[i].first - points[j].first) + std::abs(points[i].second - points[j].second);
+        }
+    }
+    return distances;
+}
+
+static void benchmarkCity(BenchmarkRunner& runner) {
+    for (int size = 1; size <= 2; size++) {
+        int cells = size == 1 ? 64 * 64 : 256 * 256;
+        runner.run("city.generate.size" + std::to_string(size), size == 1 ? 50 : 10, cells, [size](int sample) {
+            City city(size, 1, SEED + sample);
+        });
+    }
+    // the same city generated into a tile file with room for all 16 of its tiles in memory, and for only 4
+    for (int cacheTiles : {16, 4}) {
+        runner.run("city.generate.size2.tiled." + std::to_string(cacheTiles), 10, 256 * 256, [cacheTiles](int sample) {
+            City city(2, 1, SEED + sample, "benchmark.tiles", cacheTiles);
+        });
+    }
+    std::remove("benchmark.tiles");
+}
+
+static void benchmarkMap(BenchmarkRunner& runner) {
+    // every later benchmark works on this map, map.txt is rewritten by the City constructor
+    City city(2, 1, SEED);
+    MapReader map("map.txt");
+    long long cells = (long long)map.getWidth() * map.getHeight();
+    std::vector<Point> houses = map.findHouses();
+
+    runner.run("map.parse", 20, cells, [](int) {
+        MapReader reader("map.txt");
+    });
+    runner.run("map.build_grid", 20, cells, [&map](int) {
+        std::vector<std::vector<int>> grid = map.buildGrid();
+    });
+
+    Rectangle boundary = {0, 0, (float)map.getWidth(), (float)map.getHeight()};
+    runner.run("quadtree.build", 10, cells, [&map, boundary](int) {
+        Quadtree quadtree(boundary);
+        map.fillQuadtree(quadtree);
+    });
+
+    // 1000 random 16x16 windows per sample
+    Quadtree quadtree(boundary);
+    map.fillQuadtree(quadtree);
+    std::mt19937 gen(SEED);
+    std::uniform_int_distribution<int> corner(0, map.getWidth() - 16);
+    std::vector<Rectangle> ranges;
+    for (int i = 0; i < 1000; i++) {
+        ranges.push_back(Rectangle{(float)corner(gen), (float)corner(gen), 16, 16});
+    }
+    runner.run("quadtree.query.16x16", 20, ranges.size(), [&quadtree, &ranges](int) {
+        for (const Rectangle& range : ranges) {
+            quadtree.query(range);
+        }
+    });
+
+    // cold start (parse and prepare everything) against a warm start from a mapped snapshot
+    runner.run("session.cold_start", 10, cells, [](int) {
+        MapReader reader("map.txt");
+        CitySession session(reader);
+    });
+    {
+        CitySession session(map);
+        session.getSnapshot().save("benchmark.snap");
+    }
+    runner.run("session.warm_start.snapshot", 50, cells, [](int) {
+        Snapshot snapshot;
+        snapshot.open("benchmark.snap");
+        CitySession session(snapshot);
+    });
+    std::remove("benchmark.snap");
+
+    // routing, one query per sample so the percentiles show the spread between short and long trips
+    std::vector<std::vector<int>> grid = map.buildGrid();
+    Dijkstra dijkstra(grid);
+    std::vector<std::pair<std::pair<int,int>, std::pair<int,int>>> pairs = pickHousePairs(houses, 500, gen);
+    runner.run("dijkstra.point_to_point", pairs.size(), 1, [&dijkstra, &pairs](int sample) {
+        const auto& pair = pairs[sample];
+        dijkstra.findShortestPath(pair.first.first, pair.first.second, pair.second.first, pair.second.second);
+    });
+    runner.run("dijkstra.point_to_point.compact", pairs.size(), 1, [&dijkstra, &pairs](int sample) {
+        const auto& pair = pairs[sample];
+        dijkstra.findCompactPath(pair.first.first, pair.first.second, pair.second.first, pair.second.second);
+    });
+    runner.run("dijkstra.point_to_point.distance_only", pairs.size(), 1, [&dijkstra, &pairs](int sample) {
+        const auto& pair = pairs[sample];
+        dijkstra.findDistance(pair.first.first, pair.first.second, pair.second.first, pair.second.second);
+    });
+    {
+        // the benchmark city again in a tile file, read through a cache of 4 of its 16 tiles
+        City tiledCity(2, 1, SEED, "benchmark.tiles", 4);
+        TiledRouter tiledRouter(tiledCity.getGrid());
+        runner.run("tiled_router.point_to_point.distance_only", pairs.size(), 1, [&tiledRouter, &pairs](int sample) {
+            const auto& pair = pairs[sample];
+            tiledRouter.findDistance(pair.first.first, pair.first.second, pair.second.first, pair.second.second);
+        });
+    }
+    std::remove("benchmark.tiles");
+
+    // the hub to 32 houses, in one search and in 32 separate searches
+    std::pair<int,int> hub = city.getHubLocation();
+    std::vector<std::vector<std::pair<int,int>>> targetSets;
+    std::uniform_int_distribution<int> pick(0, houses.size() - 1);
+    for (int i = 0; i < 50; i++) {
+        std::vector<std::pair<int,int>> targets;
+        for (int j = 0; j < 32; j++) {
+            const Point& house = houses[pick(gen)];
+            targets.push_back(std::make_pair((int)house.x, (int)house.y));
+        }
+        targetSets.push_back(targets);
+    }
+    runner.run("dijkstra.one_to_many.32", targetSets.size(), 32, [&dijkstra, &targetSets, hub](int sample) {
+        dijkstra.findDistances(hub.second, hub.first, targetSets[sample]);
+    });
+    runner.run("dijkstra.many_point_to_point.32", targetSets.size(), 32, [&dijkstra, &targetSets, hub](int sample) {
+        for (const auto& target : targetSets[sample]) {
+            dijkstra.findShortestPath(hub.second, hub.first, target.first, target.second);
+        }
+    });
+
+    // a tour of the hub and 32 houses like main plans it: one search from every stop for the distances and then
+    // every leg driven, by searching it again against walking it out of the kept search trees
+    runner.run("dijkstra.tour.research_legs.32", targetSets.size(), 33, [&dijkstra, &targetSets, hub](int sample) {
+        std::vector<std::pair<int,int>> stops(1, std::make_pair(hub.second, hub.first));
+        stops.insert(stops.end(), targetSets[sample].begin(), targetSets[sample].end());
+        for (const auto& stop : stops) {
+            dijkstra.findDistances(stop.first, stop.second, stops);
+        }
+        for (int leg = 1; leg < stops.size(); leg++) {
+            dijkstra.findCompactPath(stops[leg - 1].first, stops[leg - 1].second, stops[leg].first, stops[leg].second);
+        }
+    });
+    runner.run("dijkstra.tour.from_trees.32", targetSets.size(), 33, [&dijkstra, &targetSets, hub](int sample) {
+        std::vector<std::pair<int,int>> stops(1, std::make_pair(hub.second, hub.first));
+        stops.insert(stops.end(), targetSets[sample].begin(), targetSets[sample].end());
+        std::vector<SearchTree> trees;
+        for (const auto& stop : stops) {
+            trees.push_back(dijkstra.findSearchTree(stop.first, stop.second, stops));
+        }
+        for (int leg = 1; leg < stops.size(); leg++) {
+            trees[leg - 1].getPath(stops[leg].first, stops[leg].second);
+        }
+    });
+
+    // closing and reopening a road on one of 8 watched routes, repaired incrementally against searched from scratch
+    CitySession session(map);
+    DynamicRouter closures(session.getHeight(), session.getWidth(), session.getSnapshot().getPassable());
+    std::vector<int> watched;
+    std::vector<std::pair<int,int>> closed;
+    for (int i = 0; i < 8; i++) {
+        const auto& pair = pairs[i];
+        watched.push_back(closures.watch(pair.first.first, pair.first.second, pair.second.first, pair.second.second));
+        std::vector<std::pair<int, int>> path = closures.getPath(watched.back());
+        closed.push_back(path.size() > 2 ? path[path.size() / 2] : pair.second);
+    }
+    runner.run("dynamic_router.repair.8_routes", 100, 8, [&closures, &watched, &closed](int sample) {
+        const std::pair<int,int>& cell = closed[sample % closed.size()];
+        if (sample % 2 == 0) {
+            closures.block(cell.first, cell.second);
+        } else {
+            closures.unblock(cell.first, cell.second);
+        }
+        for (int route : watched) {
+            closures.getDistance(route);
+        }
+    });
+    runner.run("dynamic_router.from_scratch.8_routes", 20, 8, [&closures, &pairs](int) {
+        for (int i = 0; i < 8; i++) {
+            const auto& pair = pairs[i];
+            closures.findShortestPath(pair.first.first, pair.first.second, pair.second.first, pair.second.second);
+        }
+    });
+
+    // a third of the cells get a rush hour profile, compare with dijkstra.point_to_point for the cost of traffic
+    TrafficProfiles profiles(session.getHeight(), session.getWidth());
+    std::vector<int> rushHour = {profiles.addProfile(TrafficProfiles::rushHour(profiles.getFreeFlowSeconds(), 3, 2.5)),
+                                 profiles.addProfile(TrafficProfiles::rushHour(profiles.getFreeFlowSeconds(), 8, 6))};
+    std::uniform_int_distribution<int> column(0, session.getWidth() - 1);
+    std::uniform_int_distribution<int> row(0, session.getHeight() - 1);
+    for (int i = 0; i < session.getWidth() * session.getHeight() / 3; i++) {
+        profiles.setProfile(column(gen), row(gen), rushHour[i % 2]);
+    }
+    std::vector<int> lookupCells;
+    for (int i = 0; i < 1 << 20; i++) {
+        lookupCells.push_back(row(gen) * session.getWidth() + column(gen));
+    }
+    runner.run("traffic.travel_time.1M", 20, lookupCells.size(), [&profiles, &lookupCells](int sample) {
+        long long total = 0;
+        for (int i = 0; i < lookupCells.size(); i++) {
+            total += profiles.travelTime(lookupCells[i], sample * 997 + i * 13);
+        }
+        // keep the lookups from being optimized away
+        volatile long long sink = total;
+        (void)sink;
+    });
+    TrafficProfiles freeFlow(session.getHeight(), session.getWidth());
+    TimeDependentRouter freeFlowRouter(session.getHeight(), session.getWidth(), session.getSnapshot().getPassable(), freeFlow);
+    TimeDependentRouter trafficRouter(session.getHeight(), session.getWidth(), session.getSnapshot().getPassable(), profiles);
+    runner.run("time_dependent_router.free_flow", pairs.size(), 1, [&freeFlowRouter, &pairs](int sample) {
+        const auto& pair = pairs[sample];
+        int arrival;
+        freeFlowRouter.findFastestPath(pair.first.first, pair.first.second, pair.second.first, pair.second.second, 8 * 3600, arrival);
+    });
+    runner.run("time_dependent_router.rush_hour", pairs.size(), 1, [&trafficRouter, &pairs](int sample) {
+        const auto& pair = pairs[sample];
+        int arrival;
+        trafficRouter.findFastestPath(pair.first.first, pair.first.second, pair.second.first, pair.second.second, 8 * 3600, arrival);
+    });
+    runner.run("time_dependent_router.arrival_times.32", targetSets.size(), 32, [&trafficRouter, &targetSets, hub](int sample) {
+        trafficRouter.findArrivalTimes(hub.second, hub.first, 17 * 3600, targetSets[sample]);
+    });
+
+    // routes between houses on opposite sides of the city, the flat search against the hierarchical one
+    std::vector<std::pair<std::pair<int,int>, std::pair<int,int>>> crossCity;
+    for (const auto& pair : pickHousePairs(houses, 5000, gen)) {
+        int manhattan = std::abs(pair.first.first - pair.second.first) + std::abs(pair.first.second - pair.second.second);
+        if (manhattan > (session.getWidth() + session.getHeight()) / 2 && crossCity.size() < 200) {
+            crossCity.push_back(pair);
+        }
+    }
+    runner.run("hierarchical_router.build", 20, cells, [&session](int) {
+        HierarchicalRouter hierarchical(session.getHeight(), session.getWidth(), session.getSnapshot().getPassable());
+    });
+    HierarchicalRouter hierarchical(session.getHeight(), session.getWidth(), session.getSnapshot().getPassable());
+    runner.run("dijkstra.cross_city", crossCity.size(), 1, [&dijkstra, &crossCity](int sample) {
+        const auto& pair = crossCity[sample];
+        dijkstra.findShortestPath(pair.first.first, pair.first.second, pair.second.first, pair.second.second);
+    });
+    runner.run("hierarchical_router.distance.cross_city", crossCity.size(), 1, [&hierarchical, &crossCity](int sample) {
+        const auto& pair = crossCity[sample];
+        hierarchical.findDistance(pair.first.first, pair.first.second, pair.second.first, pair.second.second);
+    });
+    runner.run("hierarchical_router.path.cross_city", crossCity.size(), 1, [&hierarchical, &crossCity](int sample) {
+        const auto& pair = crossCity[sample];
+        hierarchical.findPath(pair.first.first, pair.first.second, pair.second.first, pair.second.second);
+    });
+
+    // the same pairs with every 64x64 shard in its own process, a batch sends one request to every shard
+    runner.run("sharded_router.build.4x4", 10, cells, [&session](int) {
+        ShardedRouter sharded(session.getHeight(), session.getWidth(), session.getSnapshot().getPassable(), 4, 4);
+    });
+    ShardedRouter sharded(session.getHeight(), session.getWidth(), session.getSnapshot().getPassable(), 4, 4);
+    runner.run("sharded_router.path.cross_city", crossCity.size(), 1, [&sharded, &crossCity](int sample) {
+        const auto& pair = crossCity[sample];
+        sharded.findShortestPath(pair.first.first, pair.first.second, pair.second.first, pair.second.second);
+    });
+    runner.run("sharded_router.distance.cross_city", crossCity.size(), 1, [&sharded, &crossCity](int sample) {
+        const auto& pair = crossCity[sample];
+        sharded.findDistance(pair.first.first, pair.first.second, pair.second.first, pair.second.second);
+    });
+    runner.run("sharded_router.distance_batch.cross_city", 10, crossCity.size(), [&sharded, &crossCity](int) {
+        sharded.findDistances(crossCity);
+    });
+
+    // ALT with 8 landmarks on the same pairs as dijkstra.point_to_point and dijkstra.cross_city
+    runner.run("landmark_router.build.8", 10, cells, [&session](int) {
+        LandmarkRouter landmarks(session.getHeight(), session.getWidth(), session.getSnapshot().getPassable());
+    });
+    LandmarkRouter landmarks(session.getHeight(), session.getWidth(), session.getSnapshot().getPassable());
+    runner.run("landmark_router.point_to_point", pairs.size(), 1, [&landmarks, &pairs](int sample) {
+        const auto& pair = pairs[sample];
+        landmarks.findShortestPath(pair.first.first, pair.first.second, pair.second.first, pair.second.second);
+    });
+    runner.run("landmark_router.cross_city", crossCity.size(), 1, [&landmarks, &crossCity](int sample) {
+        const auto& pair = crossCity[sample];
+        landmarks.findShortestPath(pair.first.first, pair.first.second, pair.second.first, pair.second.second);
+    });
+
+    // the distance from the hub to every road cell, with the priority queue loop and with whole rows at a time
+    std::vector<std::pair<int,int>> roadCells;
+    for (int y = 0; y < session.getHeight(); y++) {
+        for (int x = 0; x < session.getWidth(); x++) {
+            if (session.isPassable(x, y)) {
+                roadCells.push_back(std::make_pair(x, y));
+            }
+        }
+    }
+    runner.run("dijkstra.distance_field", 20, roadCells.size(), [&dijkstra, &roadCells, hub](int) {
+        dijkstra.findDistances(hub.second, hub.first, roadCells);
+    });
+    BitParallelBfs bitBfs(session.getHeight(), session.getWidth(), session.getSnapshot().getPassable());
+    runner.run("bit_bfs.distance_field", 100, roadCells.size(), [&bitBfs, hub](int) {
+        bitBfs.findDistanceField(hub.second, hub.first);
+    });
+
+    // the city has thin winding roads, an open 512x512 grid with 10% of the cells blocked has a wide frontier
+    const int OPEN = 512;
+    std::vector<uint64_t> open((OPEN * OPEN + 63) / 64, ~(uint64_t)0);
+    std::uniform_int_distribution<int> openCell(0, OPEN * OPEN - 1);
+    for (int i = 0; i < OPEN * OPEN / 10; i++) {
+        int cell = openCell(gen);
+        open[cell >> 6] &= ~((uint64_t)1 << (cell & 63));
+    }
+    open[0] |= 1;
+    std::vector<std::pair<int,int>> openCells;
+    for (int cell = 0; cell < OPEN * OPEN; cell++) {
+        if ((open[cell >> 6] >> (cell & 63)) & 1) {
+            openCells.push_back(std::make_pair(cell % OPEN, cell / OPEN));
+        }
+    }
+    Dijkstra openDijkstra(OPEN, OPEN, open.data());
+    BitParallelBfs openBitBfs(OPEN, OPEN, open.data());
+    runner.run("dijkstra.distance_field.open_512", 5, openCells.size(), [&openDijkstra, &openCells](int) {
+        openDijkstra.findDistances(0, 0, openCells);
+    });
+    runner.run("bit_bfs.distance_field.open_512", 20, openCells.size(), [&openBitBfs](int) {
+        openBitBfs.findDistanceField(0, 0);
+    });
+
+    // every house within 100 steps of the hub, one search per house list against one bounded search
+    std::vector<std::pair<int,int>> houseCells;
+    for (const Point& house : houses) {
+        houseCells.push_back(std::make_pair((int)house.x, (int)house.y));
+    }
+    runner.run("dijkstra.houses_within.100", 20, houseCells.size(), [&dijkstra, &houseCells, hub](int) {
+        std::vector<int> distances = dijkstra.findDistances(hub.second, hub.first, houseCells);
+        std::vector<std::pair<int,int>> within;
+        for (int i = 0; i < distances.size(); i++) {
+            if (distances[i] <= 100) {
+                within.push_back(std::make_pair(distances[i], i));
+            }
+        }
+        std::sort(within.begin(), within.end());
+    });
+    runner.run("isochrone.houses_within.100", 100, houseCells.size(), [&session, hub](int) {
+        session.findReachableHouses(hub.second, hub.first, 100);
+    });
+}
+
+static void benchmarkSorting(BenchmarkRunner& runner) {
+    const int COUNT = 1 << 20;
+    std::mt19937 gen(SEED);
+    std::uniform_int_distribution<int> value(0, 1 << 30);
+    std::vector<int> keys(COUNT);
+    for (int& key : keys) {
+        key = value(gen);
+    }
+    std::vector<int> values;
+    auto copyKeys = [&values, &keys](int) { values = keys; };
+
+    runner.run("sort.std_sort.1M", 10, COUNT, [&values](int) {
+        std::sort(values.begin(), values.end());
+    }, copyKeys);
+    BucketSortInt bucketSortInt(1);
+    runner.run("sort.bucket_sort_int.1M", 10, COUNT, [&values, &bucketSortInt](int) {
+        bucketSortInt.bucket_sort(values, COUNT / 16);
+    }, copyKeys);
+    BucketSort<int> bucketSort;
+    runner.run("sort.bucket_sort.1M", 10, COUNT, [&values, &bucketSort](int) {
+        bucketSort.sort(values);
+    }, copyKeys);
+    runner.run("sort.radix_argsort.1M", 10, COUNT, [&keys](int) {
+        RadixSort::argsort(keys);
+    });
+
+    // the savings list the fleet planner sorts, small keys with a payload
+    std::vector<std::pair<int, std::pair<int,int>>> savings(COUNT);
+    std::uniform_int_distribution<int> saving(0, 512);
+    for (int i = 0; i < COUNT; i++) {
+        savings[i] = std::make_pair(saving(gen), std::make_pair(i, i + 1));
+    }
+    std::vector<std::pair<int, std::pair<int,int>>> items;
+    auto copySavings = [&items, &savings](int) { items = savings; };
+    runner.run("sort.savings.std_stable_sort.1M", 10, COUNT, [&items](int) {
+        std::stable_sort(items.begin(), items.end(), [](const std::pair<int, std::pair<int,int>>& a, const std::pair<int, std::pair<int,int>>& b) {
+            return a.first > b.first;
+        });
+    }, copySavings);
+    runner.run("sort.savings.radix_sort.1M", 10, COUNT, [&items](int) {
+        RadixSort::sort(items, true);
+    }, copySavings);
+}
+
+static void benchmarkPlanning(BenchmarkRunner& runner) {
+    std::mt19937 gen(SEED);
+    OrderSampler sampler(1 << 16);
+    runner.run("orders.sample.4096", 100, 4096, [&sampler, &gen](int) {
+        sampler.sample(gen, 4096);
+    });
+
+    std::vector<std::vector<int>> small = randomDistances(13, gen);
+    runner.run("route_optimizer.held_karp.12", 10, 12, [&small](int) {
+        RouteOptimizer optimizer(small);
+        optimizer.solve();
+    });
+    std::vector<std::vector<int>> large = randomDistances(201, gen);
+    runner.run("route_optimizer.local_search.200", 10, 200, [&large](int) {
+        RouteOptimizer optimizer(large);
+        optimizer.solve();
+    });
+    std::vector<std::vector<int>> fleet = randomDistances(501, gen);
+    runner.run("fleet_planner.plan.500x10", 5, 500, [&fleet](int) {
+        FleetPlanner planner(fleet, 10, 50, 250);
+        planner.plan();
+    });
+
+    // 4096 orders spread over a 256x256 map into clusters of at most 12
+    std::vector<std::pair<int,int>> spread;
+    for (int order : sampler.sample(gen, 4096)) {
+        spread.push_back(std::make_pair(order / 256, order % 256));
+    }
+    OrderClusterer clusterer(256, 256, 12);
+    runner.run("order_clusterer.cluster.4096", 20, 4096, [&clusterer, &spread](int) {
+        clusterer.cluster(spread);
+    });
+
+    // 64 whole size 2 days (city, 10 orders, 3 hubs and their routes) on one worker and on every hardware thread
+    for (int workers : {1, 0}) {
+        Simulation simulation(2, 3, 10, 1, 0, SEED, workers);
+        std::string name = "simulation.days.size2." + (workers == 0 ? std::string("all_workers") : std::to_string(workers));
+        runner.run(name, 5, 64, [&simulation](int) {
+            simulation.run(64);
+        });
+    }
+}
+
+int main(int argc, char* argv[]) {
+    // an optional argument only runs the benchmarks whose name contains it, for example "sort" or "dijkstra"
+    std::string filter = argc > 1 ? argv[1] : "";
+    BenchmarkRunner runner(filter);
+    benchmarkCity(runner);
+    benchmarkMap(runner);
+    benchmarkSorting(runner);
+    benchmarkPlanning(runner);
+    return 0;
+}
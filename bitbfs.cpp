@@ -0,0 +1,183 @@
+#include "bitbfs.h"
+#include "metrics.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+const int BitParallelBfs::UNREACHABLE;
+
+/**
+ * @return the position of the lowest set bit, bits can not be 0
+ */
+static inline int lowestBit(uint64_t bits) {
+#if defined(_MSC_VER)
+    unsigned long position;
+    _BitScanForward64(&position, bits);
+    return position;
+#else
+    return __builtin_ctzll(bits);
+#endif
+}
+
+/**
+ * Constructor, repacks the road mask into padded rows
+ * @param rows the amount of rows in the grid
+ * @param cols the amount of collumns in the grid
+ * @param passable (rows * cols + 63) / 64 words, bit i is set if cell i can be driven on
+ */
+BitParallelBfs::BitParallelBfs(int rows, int cols, const uint64_t* passable) {
+    this->rows = rows;
+    this->cols = cols;
+    wordsPerRow = (cols + 63) / 64;
+    stride = wordsPerRow + 2;
+    size_t words = (size_t)(rows + 2) * stride;
+    mask = std::vector<uint64_t>(words, 0);
+    visited = std::vector<uint64_t>(words, 0);
+    frontier = std::vector<uint64_t>(words, 0);
+    next = std::vector<uint64_t>(words, 0);
+    for (int y = 0; y < rows; y++) {
+        for (int x = 0; x < cols; x++) {
+            int index = y * cols + x;
+            if ((passable[index >> 6] >> (index & 63)) & 1) {
+                mask[wordOf(x, y)] |= (uint64_t)1 << (x & 63);
+            }
+        }
+    }
+}
+
+/**
+ * @return the index of the word holding a cell in the padded bitplanes
+ */
+size_t BitParallelBfs::wordOf(int x, int y) const {
+    return (size_t)(y + 1) * stride + 1 + (x >> 6);
+}
+
+/**
+ * Work out the next frontier of one row from the frontier of that row and the rows above and below it,
+ * and mark the new cells visited
+ * @param y the row
+ * @return all the words of the new row ORed together, 0 if nothing new was reached in it
+ */
+uint64_t BitParallelBfs::expandRow(int y) {
+    size_t start = (size_t)(y + 1) * stride + 1;
+    const uint64_t* current = frontier.data() + start;
+    const uint64_t* above = current - stride;
+    const uint64_t* below = current + stride;
+    const uint64_t* road = mask.data() + start;
+    uint64_t* seen = visited.data() + start;
+    uint64_t* reached = next.data() + start;
+    uint64_t any = 0;
+    int w = 0;
+#if defined(__AVX2__)
+    // the loads one word to the left and right carry the bits that cross a word boundary,
+    // the padding words make them safe at the ends of the row
+    __m256i anyVector = _mm256_setzero_si256();
+    for (; w + 4 <= wordsPerRow; w += 4) {
+        __m256i middle = _mm256_loadu_si256((const __m256i*)(current + w));
+        __m256i left = _mm256_loadu_si256((const __m256i*)(current + w - 1));
+        __m256i right = _mm256_loadu_si256((const __m256i*)(current + w + 1));
+        __m256i neighbours = _mm256_or_si256(
+            _mm256_or_si256(_mm256_slli_epi64(middle, 1), _mm256_srli_epi64(left, 63)),
+            _mm256_or_si256(_mm256_srli_epi64(middle, 1), _mm256_slli_epi64(right, 63)));
+        neighbours = _mm256_or_si256(neighbours, _mm256_or_si256(
+            _mm256_loadu_si256((const __m256i*)(above + w)), _mm256_loadu_si256((const __m256i*)(below + w))));
+        __m256i oldSeen = _mm256_loadu_si256((const __m256i*)(seen + w));
+        __m256i fresh = _mm256_andnot_si256(oldSeen, _mm256_and_si256(neighbours, _mm256_loadu_si256((const __m256i*)(road + w))));
+        _mm256_storeu_si256((__m256i*)(reached + w), fresh);
+        _mm256_storeu_si256((__m256i*)(seen + w), _mm256_or_si256(oldSeen, fresh));
+        anyVector = _mm256_or_si256(anyVector, fresh);
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, anyVector);
+    any = lanes[0] | lanes[1] | lanes[2] | lanes[3];
+#endif
+    for (; w < wordsPerRow; w++) {
+        // cell x is reached from x - 1 (shift up one bit) and from x + 1 (shift down one bit)
+        uint64_t neighbours = (current[w] << 1) | (current[w - 1] >> 63) | (current[w] >> 1) | (current[w + 1] << 63) |
+                              above[w] | below[w];
+        uint64_t fresh = neighbours & road[w] & ~seen[w];
+        reached[w] = fresh;
+        seen[w] |= fresh;
+        any |= fresh;
+    }
+    return any;
+}
+
+/**
+ * Distance from a single cell to every cell, see the overload for more than one source
+ */
+std::vector<int> BitParallelBfs::findDistanceField(int startX, int startY, int maxDistance) {
+    return findDistanceField(std::vector<std::pair<int, int>>(1, std::make_pair(startX, startY)), maxDistance);
+}
+
+/**
+ * Distance from the closest of the sources to every cell, one level of the search at a time
+ * @param sources the cells to start from as (x, y) pairs, sources that arent road are ignored
+ * @param maxDistance stop after this many steps, cells further away are left UNREACHABLE
+ * @return the distance of every cell in row order (y * cols + x), UNREACHABLE if it cant be reached
+ */
+std::vector<int> BitParallelBfs::findDistanceField(const std::vector<std::pair<int, int>>& sources, int maxDistance) {
+    METRICS_TIMER("bit_bfs.find_distance_field");
+    std::vector<int> distances((size_t)rows * cols, UNREACHABLE);
+    std::fill(visited.begin(), visited.end(), 0);
+    std::fill(frontier.begin(), frontier.end(), 0);
+
+    // the rows the frontier has cells in, in order. only these rows and the ones next to them can gain cells
+    activeRows.clear();
+    for (const std::pair<int, int>& source : sources) {
+        int x = source.first;
+        int y = source.second;
+        if (x < 0 || x >= cols || y < 0 || y >= rows || !((mask[wordOf(x, y)] >> (x & 63)) & 1)) {
+            continue;
+        }
+        frontier[wordOf(x, y)] |= (uint64_t)1 << (x & 63);
+        visited[wordOf(x, y)] |= (uint64_t)1 << (x & 63);
+        distances[y * cols + x] = 0;
+        activeRows.push_back(y);
+    }
+    std::sort(activeRows.begin(), activeRows.end());
+    activeRows.erase(std::unique(activeRows.begin(), activeRows.end()), activeRows.end());
+
+    int level = 0;
+    long long rowsExpanded = 0;
+    while (!activeRows.empty() && level < maxDistance) {
+        level++;
+        nextRows.clear();
+        int lastExpanded = -1;
+        for (int active : activeRows) {
+            for (int y = std::max(active - 1, lastExpanded + 1); y <= std::min(active + 1, rows - 1); y++) {
+                lastExpanded = y;
+                rowsExpanded++;
+                if (expandRow(y) == 0) {
+                    continue;
+                }
+                nextRows.push_back(y);
+                // only the new cells get a distance written, each cell is written once over the whole search
+                const uint64_t* reached = next.data() + (size_t)(y + 1) * stride + 1;
+                int* row = distances.data() + (size_t)y * cols;
+                for (int w = 0; w < wordsPerRow; w++) {
+                    for (uint64_t bits = reached[w]; bits != 0; bits &= bits - 1) {
+                        row[w * 64 + lowestBit(bits)] = level;
+                    }
+                }
+            }
+        }
+        // next only has cells in the rows just expanded and the frontier only in the active rows, so clearing
+        // those and swapping makes the new cells the frontier and leaves next all zero for the following level
+        for (int y : activeRows) {
+            std::memset(frontier.data() + (size_t)(y + 1) * stride + 1, 0, wordsPerRow * sizeof(uint64_t));
+        }
+        frontier.swap(next);
+        activeRows.swap(nextRows);
+    }
+    METRICS_COUNT("bit_bfs.levels", level);
+    METRICS_COUNT("bit_bfs.rows_expanded", rowsExpanded);
+    return distances;
+}
@@ -0,0 +1,45 @@
+#ifndef BITBFS_H
+#define BITBFS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/*
+ * Breadth first search that moves a whole row of the frontier at once. The road mask, the visited cells and the
+ * frontier are bitplanes, one bit per cell packed into 64 bit words row by row. One level of the search is
+ *     next = (left | right | up | down of the frontier) & road & ~visited
+ * which is a few shifts and ANDs per 64 cells instead of a queue push per cell, done 4 words at a time with AVX2
+ * when the compiler targets it. Every row has a zero word on both sides and there is a zero row above and below
+ * the map, so the shifts never need bounds checks. Only the rows next to the frontier are touched each level.
+ * Every step costs 1, the distances are the same as Dijkstra's. Coordinates are (x, y) like Dijkstra
+ */
+class BitParallelBfs {
+public:
+    // distance reported for cells that cant be reached
+    static const int UNREACHABLE = INT32_MAX / 4;
+
+    BitParallelBfs(int rows, int cols, const uint64_t* passable);
+
+    std::vector<int> findDistanceField(int startX, int startY, int maxDistance = UNREACHABLE);
+    std::vector<int> findDistanceField(const std::vector<std::pair<int, int>>& sources, int maxDistance = UNREACHABLE);
+
+private:
+    int rows;
+    int cols;
+    int wordsPerRow;
+    int stride; // wordsPerRow plus the padding word on each side
+    std::vector<uint64_t> mask;
+    std::vector<uint64_t> visited;
+    std::vector<uint64_t> frontier;
+    std::vector<uint64_t> next;
+    // the rows of the frontier (and of next) that have a cell in them, in order
+    std::vector<int> activeRows;
+    std::vector<int> nextRows;
+
+    size_t wordOf(int x, int y) const;
+    uint64_t expandRow(int y);
+};
+
+#endif
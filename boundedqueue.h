@@ -0,0 +1,184 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+/*
+ * Fixed size lock free queue that any number of threads can push to and pop from at the same time (Vyukov's bounded
+ * MPMC queue). Every slot carries a sequence number that says whether it is ready to be written or read on the current
+ * lap around the ring, so a push or pop is one compare and swap on the tail or head and never takes a lock.
+ * A full queue makes push wait, which holds a fast stage back to the pace of the stage after it. A waiting push or pop
+ * retries a few times first and then sleeps on a condition variable until the other side makes room or adds an item,
+ * the lock is only taken when someone is asleep. Once every producer is done close lets the consumers drain what is
+ * left and stop
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    /**
+     * Constructor for the queue
+     * @param capacity the most items it holds, rounded up to a power of 2
+     */
+    explicit BoundedQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        mask = size - 1;
+        slots.reset(new Slot[size]);
+        for (size_t i = 0; i < size; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    /**
+     * Add an item if there is room
+     * @return false if the queue is full, the item is left alone
+     */
+    bool tryPush(T& item) {
+        size_t position = tail.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots[position & mask];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            long long lap = (long long)sequence - (long long)position;
+            if (lap == 0) {
+                // the slot is free on this lap, claim it by moving the tail past it
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.value = std::move(item);
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (lap < 0) {
+                // the slot still holds the item from the last lap, the queue is full
+                return false;
+            } else {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * Take the oldest item if there is one
+     * @return false if the queue is empty
+     */
+    bool tryPop(T& item) {
+        size_t position = head.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots[position & mask];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            long long lap = (long long)sequence - (long long)(position + 1);
+            if (lap == 0) {
+                if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    item = std::move(slot.value);
+                    // free the slot for the push one lap ahead
+                    slot.sequence.store(position + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (lap < 0) {
+                return false;
+            } else {
+                position = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * Add an item, waiting for room if the queue is full
+     */
+    void push(T item) {
+        for (int attempt = 0; attempt < SPIN_LIMIT; attempt++) {
+            if (tryPush(item)) {
+                wake(notEmpty, popWaiters);
+                return;
+            }
+        }
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            pushWaiters++;
+            notFull.wait(lock, [&]() { return tryPush(item); });
+            pushWaiters--;
+        }
+        wake(notEmpty, popWaiters);
+    }
+
+    /**
+     * Take the oldest item, waiting for one if the queue is empty
+     * @return false once the queue is closed and empty
+     */
+    bool pop(T& item) {
+        bool popped = false;
+        // an item pushed right before close is still picked up
+        auto ready = [&]() {
+            popped = tryPop(item) || (closed.load(std::memory_order_acquire) && tryPop(item));
+            return popped || closed.load(std::memory_order_acquire);
+        };
+        bool done = false;
+        for (int attempt = 0; attempt < SPIN_LIMIT && !done; attempt++) {
+            done = ready();
+        }
+        if (!done) {
+            std::unique_lock<std::mutex> lock(mutex);
+            popWaiters++;
+            notEmpty.wait(lock, ready);
+            popWaiters--;
+        }
+        if (popped) {
+            wake(notFull, pushWaiters);
+        }
+        return popped;
+    }
+
+    /**
+     * Say that nothing more will be pushed, call it after the last push of every producer. Every sleeping pop wakes up
+     * to drain what is left
+     */
+    void close() {
+        closed.store(true, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(mutex);
+        notEmpty.notify_all();
+    }
+
+private:
+    // failed tries before a push or pop goes to sleep
+    static const int SPIN_LIMIT = 64;
+
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    // the producers and consumers each get their own cache line so they dont slow each other down
+    alignas(64) std::atomic<size_t> tail{0};
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<bool> closed{false};
+    // only used to sleep, the waiter counts let push and pop skip the lock while nobody is asleep
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    std::atomic<int> pushWaiters{0};
+    std::atomic<int> popWaiters{0};
+
+    /**
+     * Wake whoever sleeps on the other side after a push or pop changed the queue
+     */
+    void wake(std::condition_variable& condition, std::atomic<int>& waiters) {
+        // a waiter counts itself before it tries again, so either it sees this change or we see it waiting
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            condition.notify_all();
+        }
+    }
+};
+
+#endif
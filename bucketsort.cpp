@@ -1,11 +1,126 @@
-#pragma once
-
 #include <vector>
 #include "bucketsort.h"
 
 #include <iostream>
 #include <algorithm>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * Find the smallest and largest int, 8 (AVX2) or 4 (SSE4.1) at a time when the compiler targets them
+ * @param values the values to search, count must be at least 1
+ * @param count how many values there are
+ * @param min set to the smallest value
+ * @param max set to the largest value
+ */
+void findMinMax(const int* values, size_t count, int& min, int& max) {
+    size_t i = 0;
+    min = values[0];
+    max = values[0];
+#if defined(__AVX2__)
+    if (count >= 8) {
+        __m256i low = _mm256_loadu_si256((const __m256i*)values);
+        __m256i high = low;
+        for (i = 8; i + 8 <= count; i += 8) {
+            __m256i block = _mm256_loadu_si256((const __m256i*)(values + i));
+            low = _mm256_min_epi32(low, block);
+            high = _mm256_max_epi32(high, block);
+        }
+        int lows[8];
+        int highs[8];
+        _mm256_storeu_si256((__m256i*)lows, low);
+        _mm256_storeu_si256((__m256i*)highs, high);
+        for (int lane = 0; lane < 8; lane++) {
+            min = std::min(min, lows[lane]);
+            max = std::max(max, highs[lane]);
+        }
+    }
+#elif defined(__SSE4_1__)
+    if (count >= 4) {
+        __m128i low = _mm_loadu_si128((const __m128i*)values);
+        __m128i high = low;
+        for (i = 4; i + 4 <= count; i += 4) {
+            __m128i block = _mm_loadu_si128((const __m128i*)(values + i));
+            low = _mm_min_epi32(low, block);
+            high = _mm_max_epi32(high, block);
+        }
+        int lows[4];
+        int highs[4];
+        _mm_storeu_si128((__m128i*)lows, low);
+        _mm_storeu_si128((__m128i*)highs, high);
+        for (int lane = 0; lane < 4; lane++) {
+            min = std::min(min, lows[lane]);
+            max = std::max(max, highs[lane]);
+        }
+    }
+#endif
+    // whatever did not fill a whole vector (or everything when there is no SIMD)
+    for (; i < count; i++) {
+        min = std::min(min, values[i]);
+        max = std::max(max, values[i]);
+    }
+}
+
+/**
+ * Find the smallest and largest float, 8 (AVX2) or 4 (SSE2, always there on x86-64) at a time
+ * @param values the values to search, count must be at least 1
+ * @param count how many values there are
+ * @param min set to the smallest value
+ * @param max set to the largest value
+ */
+void findMinMax(const float* values, size_t count, float& min, float& max) {
+    size_t i = 0;
+    min = values[0];
+    max = values[0];
+#if defined(__AVX2__)
+    if (count >= 8) {
+        __m256 low = _mm256_loadu_ps(values);
+        __m256 high = low;
+        for (i = 8; i + 8 <= count; i += 8) {
+            __m256 block = _mm256_loadu_ps(values + i);
+            low = _mm256_min_ps(low, block);
+            high = _mm256_max_ps(high, block);
+        }
+        float lows[8];
+        float highs[8];
+        _mm256_storeu_ps(lows, low);
+        _mm256_storeu_ps(highs, high);
+        for (int lane = 0; lane < 8; lane++) {
+            min = std::min(min, lows[lane]);
+            max = std::max(max, highs[lane]);
+        }
+    }
+#elif defined(__SSE2__)
+    if (count >= 4) {
+        __m128 low = _mm_loadu_ps(values);
+        __m128 high = low;
+        for (i = 4; i + 4 <= count; i += 4) {
+            __m128 block = _mm_loadu_ps(values + i);
+            low = _mm_min_ps(low, block);
+            high = _mm_max_ps(high, block);
+        }
+        float lows[4];
+        float highs[4];
+        _mm_storeu_ps(lows, low);
+        _mm_storeu_ps(highs, high);
+        for (int lane = 0; lane < 4; lane++) {
+            min = std::min(min, lows[lane]);
+            max = std::max(max, highs[lane]);
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        min = std::min(min, values[i]);
+        max = std::max(max, values[i]);
+    }
+}
+
 /**
  * Constructor for a bucketsort object
  * @param mode:
@@ -21,21 +136,14 @@ BucketSortInt::BucketSortInt(int mode) {
  * @param bucket
  */
 void BucketSortInt::insertion_sort_buckets(std::vector<int>& bucket) {
-    for (int i = 1; i < bucket.size(); i++) {
-        int item = bucket[i];
-        int j = i - 1;
-        if (mode == 0) {
-            while (j >= 0 && bucket[j] < item) { // Changed from bucket[j] > item
-                bucket[j + 1] = bucket[j];
-                j--;
-            }
-        } else {
-            while (j >= 0 && bucket[j] > item) { // Changed from bucket[j] < item
-                bucket[j + 1] = bucket[j];
-                j--;
-            }
-        }
-        bucket[j + 1] = item;
+    if (bucket.empty()) {
+        return;
+    }
+    // the mode is checked once here instead of on every step of the inner loop
+    if (mode == 0) {
+        BucketSort<int, std::greater<int>>::insertionSort(bucket.data(), bucket.data() + bucket.size(), std::greater<int>());
+    } else {
+        BucketSort<int, std::less<int>>::insertionSort(bucket.data(), bucket.data() + bucket.size(), std::less<int>());
     }
 }
 
@@ -56,36 +164,14 @@ void BucketSortInt::print_buckets(std::vector<int> buckets[], int num_buckets) {
 }
 
 /**
- * Main bucket sort algorithm
+ * Main bucket sort algorithm, hands off to the generic BucketSort in the order picked by mode
  * @param orders
  * @param num_buckets
  */
 void BucketSortInt::bucket_sort(std::vector<int>& numbers, int num_buckets) {
-    std::vector<std::vector<int> > buckets(num_buckets);
-
-    // Find the minimum and maximum values in the vector of numbers
-    int minId = *std::min_element(numbers.begin(), numbers.end());
-    int maxId = *std::max_element(numbers.begin(), numbers.end());
-
-    // Distribute the numbers into buckets
-    for (const auto& num : numbers) {
-        int bucket_index = (num - minId) * num_buckets / (maxId - minId + 1);
-        buckets[bucket_index].push_back(num);
-    }
-
-    // Clear numbers so we can fill it with sorted numbers
-    numbers.clear();
-
-    // Sort each bucket and merge the sorted buckets based on mode
     if (mode == 0) {
-        for (int i = num_buckets - 1; i >= 0; i--) {
-            insertion_sort_buckets(buckets[i]);
-            numbers.insert(numbers.end(), buckets[i].begin(), buckets[i].end());
-        }
+        descending.sort(numbers, num_buckets);
     } else {
-        for (auto& bucket : buckets) {
-            insertion_sort_buckets(bucket);
-            numbers.insert(numbers.end(), bucket.begin(), bucket.end());
-        }
+        ascending.sort(numbers, num_buckets);
     }
-}
\ No newline at end of file
+}
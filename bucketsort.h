@@ -1,9 +1,225 @@
+#ifndef BUCKETSORT_H
+#define BUCKETSORT_H
+
 #include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+#include "threadpool.h"
+#include "metrics.h"
+
+// SIMD min / max pre-pass for the most common key types, defined in bucketsort.cpp
+void findMinMax(const int* values, size_t count, int& min, int& max);
+void findMinMax(const float* values, size_t count, float& min, float& max);
+
+/**
+ * Scalar min / max pre-pass for every other key type
+ */
+template <typename T>
+void findMinMax(const T* values, size_t count, T& min, T& max) {
+    min = values[0];
+    max = values[0];
+    for (size_t i = 1; i < count; i++) {
+        if (values[i] < min) {
+            min = values[i];
+        }
+        if (max < values[i]) {
+            max = values[i];
+        }
+    }
+}
+
+/*
+ * Generic bucket sort for numeric keys. Compare picks the order (std::less for lowest to highest, std::greater for
+ * highest to lowest) at compile time so it never has to be checked inside a loop.
+ * Values are spread over one flat bucket array with a count then scatter pass instead of a vector per bucket, the
+ * arrays are kept between calls, and on large inputs the counting, scattering and bucket sorting run on a thread pool
+ */
+template <typename T, typename Compare = std::less<T>>
+class BucketSort {
+public:
+    explicit BucketSort(int threads = 0, Compare compare = Compare()) : threads(threads), compare(compare) {
+        static_assert(std::is_arithmetic<T>::value, "BucketSort needs numeric keys to place them in buckets");
+    }
+
+    /**
+     * Main bucket sort algorithm
+     * @param values the values to sort in place
+     * @param bucketCount how many buckets to use, 0 picks one bucket for every 16 values
+     */
+    void sort(std::vector<T>& values, int bucketCount = 0) {
+        METRICS_TIMER("bucket_sort.sort");
+        size_t count = values.size();
+        if (count <= 1) {
+            return;
+        }
+        if (bucketCount <= 0) {
+            bucketCount = std::max<size_t>(1, count / 16);
+        }
+
+        // Find the minimum and maximum values in the vector of values
+        T minValue;
+        T maxValue;
+        findMinMax(values.data(), count, minValue, maxValue);
+        if (!(minValue < maxValue)) {
+            return; // every value is the same
+        }
+
+        int workers = count < PARALLEL_THRESHOLD ? 1 : getPool().size();
+        size_t slice = (count + workers - 1) / workers;
+        scratch.resize(count);
+        counts.assign((size_t)workers * bucketCount, 0);
+
+        // count how many values of every slice land in every bucket
+        runOnWorkers(workers, [&](int worker) {
+            size_t* workerCounts = &counts[(size_t)worker * bucketCount];
+            size_t end = std::min(count, (worker + 1) * slice);
+            for (size_t i = worker * slice; i < end; i++) {
+                workerCounts[bucketIndex(values[i], minValue, maxValue, bucketCount)]++;
+            }
+        });
+
+        // turn the counts into where every slice starts writing inside every bucket, buckets are laid out in sorted
+        // order so when Compare puts high values first the last bucket comes first
+        bool ascending = compare(minValue, maxValue);
+        starts.assign(bucketCount + 1, 0);
+        size_t offset = 0;
+        for (int i = 0; i < bucketCount; i++) {
+            int bucket = ascending ? i : bucketCount - 1 - i;
+            starts[bucket] = offset;
+            for (int worker = 0; worker < workers; worker++) {
+                size_t& slot = counts[(size_t)worker * bucketCount + bucket];
+                size_t amount = slot;
+                slot = offset;
+                offset += amount;
+            }
+        }
+
+        // scatter every value straight into its place in the flat bucket array
+        runOnWorkers(workers, [&](int worker) {
+            size_t* workerOffsets = &counts[(size_t)worker * bucketCount];
+            size_t end = std::min(count, (worker + 1) * slice);
+            for (size_t i = worker * slice; i < end; i++) {
+                scratch[workerOffsets[bucketIndex(values[i], minValue, maxValue, bucketCount)]++] = values[i];
+            }
+        });
+
+        // sort the buckets, every worker takes every workers'th bucket so large and small buckets mix evenly
+        runOnWorkers(workers, [&](int worker) {
+            for (int bucket = worker; bucket < bucketCount; bucket += workers) {
+                size_t begin = starts[bucket];
+                size_t end = begin + bucketSize(bucket, bucketCount, workers);
+                sortBucket(scratch.data() + begin, scratch.data() + end);
+            }
+        });
+        values.swap(scratch);
+    }
+
+    /**
+     * Insertion sort for a single bucket, fast on the handful of values a bucket usually holds
+     */
+    static void insertionSort(T* first, T* last, Compare compare) {
+        for (T* i = first + 1; i < last; i++) {
+            T item = *i;
+            T* j = i;
+            while (j > first && compare(item, *(j - 1))) {
+                *j = *(j - 1);
+                j--;
+            }
+            *j = item;
+        }
+    }
+
+private:
+    // below this many values the thread pool costs more than it saves
+    static const size_t PARALLEL_THRESHOLD = 1 << 16;
+    // buckets bigger than this are sorted with std::sort instead of insertion sort
+    static const size_t INSERTION_SORT_LIMIT = 32;
+
+    int threads;
+    Compare compare;
+    std::unique_ptr<ThreadPool> pool;
+    std::vector<T> scratch;
+    std::vector<size_t> counts;
+    std::vector<size_t> starts;
+
+    ThreadPool& getPool() {
+        if (!pool) {
+            pool.reset(new ThreadPool(threads));
+        }
+        return *pool;
+    }
+
+    /**
+     * How far an integer is above the minimum, as an unsigned number so it can hold the full range of any type
+     */
+    static uint64_t distance(T value, T minValue) {
+        if (std::is_signed<T>::value) {
+            return (uint64_t)(int64_t)value - (uint64_t)(int64_t)minValue;
+        }
+        return (uint64_t)value - (uint64_t)minValue;
+    }
+
+    /**
+     * Which bucket a value goes in. Integers work on the unsigned distance from the minimum and divide it by the
+     * bucket width, so a key range as wide as the whole type never overflows
+     */
+    static int bucketIndex(T value, T minValue, T maxValue, int bucketCount) {
+        if (bucketCount == 1) {
+            return 0;
+        }
+        if (std::is_integral<T>::value) {
+            uint64_t width = distance(maxValue, minValue) / bucketCount + 1;
+            return (int)(distance(value, minValue) / width);
+        }
+        double position = ((double)value - (double)minValue) / ((double)maxValue - (double)minValue);
+        return std::min(bucketCount - 1, (int)(position * bucketCount));
+    }
+
+    /**
+     * After the scatter the counts of the last worker hold where each bucket ends
+     */
+    size_t bucketSize(int bucket, int bucketCount, int workers) const {
+        return counts[(size_t)(workers - 1) * bucketCount + bucket] - starts[bucket];
+    }
+
+    void sortBucket(T* first, T* last) {
+        if ((size_t)(last - first) <= INSERTION_SORT_LIMIT) {
+            insertionSort(first, last, compare);
+        } else {
+            std::sort(first, last, compare);
+        }
+    }
+
+    /**
+     * Run task(worker) for every worker, on the thread pool when there is more than one
+     */
+    template <typename Task>
+    void runOnWorkers(int workers, Task task) {
+        if (workers == 1) {
+            task(0);
+            return;
+        }
+        std::vector<std::future<void>> results;
+        for (int worker = 0; worker < workers; worker++) {
+            results.push_back(getPool().submit([&task, worker]() { task(worker); }));
+        }
+        for (auto& result : results) {
+            result.get();
+        }
+    }
+};
 
 class BucketSortInt {
 
 private:
     int mode;
+    BucketSort<int, std::greater<int>> descending;
+    BucketSort<int, std::less<int>> ascending;
 
 public:
     BucketSortInt(int mode);
@@ -11,4 +227,6 @@ public:
     void insertion_sort_buckets(std::vector<int>& bucket);
     void print_buckets(std::vector<int> buckets[], int num_buckets);
     void bucket_sort(std::vector<int>& numbers, int num_buckets);
-};
\ No newline at end of file
+};
+
+#endif
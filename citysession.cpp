@@ -0,0 +1,205 @@
+#include "citysession.h"
+#include "directions.h"
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Build a snapshot from a map and hand it back, lets the constructor prepare its own snapshot before anything reads it
+ */
+static const Snapshot& buildSnapshot(Snapshot& snapshot, const MapReader& map) {
+    snapshot.build(map);
+    return snapshot;
+}
+
+/**
+ * Constructor for a session from a parsed map, prepares everything straight away
+ * @param map the parsed map file
+ */
+CitySession::CitySession(const MapReader& map)
+    : snapshot(buildSnapshot(ownedSnapshot, map)), width(snapshot.getWidth()), height(snapshot.getHeight()),
+      passable(snapshot.getPassable()), router(height, width, passable) {
+    findSections();
+}
+
+/**
+ * Constructor for a session on top of a loaded snapshot, nothing is rebuilt
+ * @param snapshot an opened snapshot, it has to stay alive for as long as the session
+ */
+CitySession::CitySession(const Snapshot& snapshot)
+    : snapshot(snapshot), width(snapshot.getWidth()), height(snapshot.getHeight()), passable(snapshot.getPassable()),
+      router(height, width, passable) {
+    findSections();
+}
+
+void CitySession::findSections() {
+    size_t count;
+    cells = snapshot.getCells();
+    quadtreeNodes = snapshot.getQuadtreeNodes(count);
+    quadtreePoints = snapshot.getQuadtreePoints(count);
+    snapshot.getHouses(houseCount);
+    hubs = snapshot.getHubs();
+}
+
+int CitySession::getWidth() const {
+    return width;
+}
+
+int CitySession::getHeight() const {
+    return height;
+}
+
+/**
+ * The grid for the dijkstra algorithm
+ * @return grid[row][col], 1 for anything that can be driven on and 0 for empty land
+ */
+const std::vector<std::vector<int>>& CitySession::getGrid() {
+    if (grid.empty()) {
+        grid = std::vector<std::vector<int>>(height, std::vector<int>(width, 0));
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                grid[y][x] = isPassable(x, y) ? 1 : 0;
+            }
+        }
+    }
+    return grid;
+}
+
+/**
+ * Every house with x as the column, y as the row and c as its house number
+ */
+const std::vector<Point>& CitySession::getHouses() {
+    if (houses.empty() && houseCount > 0) {
+        size_t count;
+        const FlatPoint* records = snapshot.getHouses(count);
+        for (size_t i = 0; i < count; i++) {
+            houses.push_back(Point{(float)records[i].x, (float)records[i].y, std::to_string(records[i].value)});
+        }
+    }
+    return houses;
+}
+
+const std::vector<std::pair<int,int>>& CitySession::getHubs() const {
+    return hubs;
+}
+
+const Snapshot& CitySession::getSnapshot() const {
+    return snapshot;
+}
+
+Dijkstra& CitySession::getRouter() {
+    return router;
+}
+
+/**
+ * Check a cell is on the map and can be driven on
+ * @param x the column
+ * @param y the row
+ */
+bool CitySession::isPassable(int x, int y) const {
+    if (x < 0 || x >= width || y < 0 || y >= height) {
+        return false;
+    }
+    int index = y * width + x;
+    return (passable[index >> 6] >> (index & 63)) & 1;
+}
+
+/**
+ * Find the houses closest to a cell by manhattan distance. The quadtree is searched with a square window that doubles
+ * in size until it holds enough houses that are no further away than the window reaches, anything outside the window
+ * is further away than that so the answer is exact
+ * @param x the column to search from
+ * @param y the row to search from
+ * @param count how many houses to find
+ * @return up to count houses, closest first
+ */
+std::vector<FlatPoint> CitySession::findNearestHouses(int x, int y, int count) const {
+    count = std::min(count, (int)houseCount);
+    auto distance = [x, y](const FlatPoint& p) {
+        return std::abs(p.x - x) + std::abs(p.y - y);
+    };
+
+    std::vector<FlatPoint> found;
+    std::vector<FlatPoint> window;
+    int radius = 4;
+    while (count > 0) {
+        Rectangle range = {(float)(x - radius), (float)(y - radius), (float)(2 * radius), (float)(2 * radius)};
+        window.clear();
+        Quadtree::query(quadtreeNodes, quadtreePoints, range, window);
+        found.clear();
+        for (const FlatPoint& p : window) {
+            // the quadtree holds every road too, houses are the positive numbers
+            if (p.value > 0 && distance(p) <= radius) {
+                found.push_back(p);
+            }
+        }
+        if (found.size() >= count || radius >= width + height) {
+            break;
+        }
+        radius *= 2;
+    }
+
+    std::sort(found.begin(), found.end(), [&distance](const FlatPoint& a, const FlatPoint& b) {
+        if (distance(a) != distance(b)) {
+            return distance(a) < distance(b);
+        }
+        return a.y != b.y ? a.y < b.y : a.x < b.x;
+    });
+    if (found.size() > count) {
+        found.resize(count);
+    }
+    return found;
+}
+
+/**
+ * Isochrone query, every house that can be driven to within a number of steps. One breadth first search is run that
+ * stops at the budget, and every cell it reaches is looked up in the map to see if it is a house, so the time
+ * depends on how much of the map is reached and not on how many houses there are
+ * @param x the column to search from (the hub or a driver)
+ * @param y the row to search from
+ * @param maxSteps the most steps a house can be away
+ * @param isOpen optional check on top of the map, for roads that are closed right now (for example by the server)
+ * @return (house, steps) for every house reached, closest first, empty if the start isnt a road
+ */
+std::vector<std::pair<FlatPoint, int>> CitySession::findReachableHouses(int x, int y, int maxSteps,
+                                                                        const std::function<bool(int, int)>& isOpen) {
+    std::vector<std::pair<FlatPoint, int>> reached;
+    auto canDrive = [&](int x, int y) {
+        return isPassable(x, y) && (!isOpen || isOpen(x, y));
+    };
+    if (!canDrive(x, y) || maxSteps < 0) {
+        return reached;
+    }
+    if (reachSteps.empty()) {
+        reachSteps = std::vector<int>(width * height, -1);
+    }
+    // the queue holds every cell the search reached, so it is also the list of cells to reset afterwards.
+    // cells come out of the queue in order of their steps, which keeps the houses sorted without sorting them
+    reachQueue.clear();
+    reachQueue.push_back(y * width + x);
+    reachSteps[y * width + x] = 0;
+    for (int head = 0; head < reachQueue.size(); head++) {
+        int index = reachQueue[head];
+        int steps = reachSteps[index];
+        if (cells[index] > 0) {
+            reached.push_back(std::make_pair(FlatPoint{index % width, index / width, cells[index]}, steps));
+        }
+        if (steps == maxSteps) {
+            continue;
+        }
+        for (int direction = 0; direction < 4; direction++) {
+            int newX = index % width + DIRECTION_X[direction];
+            int newY = index / width + DIRECTION_Y[direction];
+            if (canDrive(newX, newY) && reachSteps[newY * width + newX] == -1) {
+                reachSteps[newY * width + newX] = steps + 1;
+                reachQueue.push_back(newY * width + newX);
+            }
+        }
+    }
+    for (int index : reachQueue) {
+        reachSteps[index] = -1;
+    }
+    return reached;
+}
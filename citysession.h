@@ -0,0 +1,62 @@
+#ifndef CITYSESSION_H
+#define CITYSESSION_H
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "quadtree.h"
+#include "dijkstra.h"
+#include "mapreader.h"
+#include "snapshot.h"
+
+/*
+ * Everything built from a map that is worth keeping around between queries, the dijkstra grid, the houses, the hubs,
+ * the quadtree and a router with its search state already allocated. Built once, then reused by every query.
+ * The prepared data lives in a Snapshot, either built from a map file or mapped in from a saved snapshot, so a saved
+ * session starts without parsing or rebuilding anything
+ */
+class CitySession {
+public:
+    explicit CitySession(const MapReader& map);
+    explicit CitySession(const Snapshot& snapshot);
+
+    int getWidth() const;
+    int getHeight() const;
+    const std::vector<std::vector<int>>& getGrid();
+    const std::vector<Point>& getHouses();
+    const std::vector<std::pair<int,int>>& getHubs() const;
+    const Snapshot& getSnapshot() const;
+    Dijkstra& getRouter();
+
+    bool isPassable(int x, int y) const;
+    std::vector<FlatPoint> findNearestHouses(int x, int y, int count) const;
+    std::vector<std::pair<FlatPoint, int>> findReachableHouses(int x, int y, int maxSteps,
+                                                               const std::function<bool(int, int)>& isOpen = nullptr);
+
+private:
+    // only used when the session builds its own snapshot, otherwise the caller keeps the snapshot alive
+    Snapshot ownedSnapshot;
+    const Snapshot& snapshot;
+    int width;
+    int height;
+    const uint64_t* passable;
+    const int32_t* cells;
+    const FlatQuadtreeNode* quadtreeNodes;
+    const FlatPoint* quadtreePoints;
+    size_t houseCount;
+    // (row, col) like City, in the order they appear in the map
+    std::vector<std::pair<int,int>> hubs;
+    Dijkstra router;
+
+    // the batch planner works on these, they are only built the first time they are asked for
+    std::vector<std::vector<int>> grid;
+    std::vector<Point> houses;
+    // scratch for findReachableHouses, the steps to every cell (-1 if not reached yet) and the search queue
+    std::vector<int> reachSteps;
+    std::vector<int> reachQueue;
+
+    void findSections();
+};
+
+#endif
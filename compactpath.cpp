@@ -0,0 +1,167 @@
+#include "compactpath.h"
+#include "directions.h"
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static const char DIRECTION_NAMES[4] = {'L', 'R', 'U', 'D'};
+
+// the longest run that fits in the 30 length bits
+static const uint32_t MAX_RUN = (1u << 30) - 1;
+
+CompactPath::CompactPath() : CompactPath(0, 0) {
+}
+
+/**
+ * Constructor for a path that is just its start cell, steps are added with append
+ */
+CompactPath::CompactPath(int startX, int startY) {
+    this->startX = startX;
+    this->startY = startY;
+    endX = startX;
+    endY = startY;
+    steps = 0;
+}
+
+/**
+ * Compress a path given cell by cell, every cell has to be next to the one before it
+ * @param cells the path as (x, y) pairs, can not be empty
+ */
+CompactPath CompactPath::fromCells(const std::vector<std::pair<int, int>>& cells) {
+    CompactPath path(cells[0].first, cells[0].second);
+    for (size_t i = 1; i < cells.size(); i++) {
+        int dx = cells[i].first - cells[i - 1].first;
+        int dy = cells[i].second - cells[i - 1].second;
+        path.append(dx < 0 ? 0 : (dx > 0 ? 1 : (dy < 0 ? 2 : 3)));
+    }
+    return path;
+}
+
+/**
+ * Add steps in one direction to the end of the path, merged into the last run if it goes the same way
+ * @param direction the direction code 0 - 3
+ * @param steps how many cells to move
+ */
+void CompactPath::append(int direction, uint32_t steps) {
+    endX += DIRECTION_X[direction] * (int)steps;
+    endY += DIRECTION_Y[direction] * (int)steps;
+    this->steps += steps;
+    while (steps > 0) {
+        if (!runs.empty() && (runs.back() & 3) == direction && (runs.back() >> 2) < MAX_RUN) {
+            uint32_t added = std::min(steps, MAX_RUN - (runs.back() >> 2));
+            runs.back() += added << 2;
+            steps -= added;
+        } else {
+            uint32_t added = std::min(steps, MAX_RUN);
+            runs.push_back(added << 2 | direction);
+            steps -= added;
+        }
+    }
+}
+
+/**
+ * @return the amount of cells on the path, start and end included (what a cell by cell path.size() would be)
+ */
+size_t CompactPath::size() const {
+    return steps + 1;
+}
+
+/**
+ * @return the amount of steps from start to end, one less than the amount of cells
+ */
+int CompactPath::getSteps() const {
+    return steps;
+}
+
+size_t CompactPath::getRunCount() const {
+    return runs.size();
+}
+
+int CompactPath::getRunDirection(size_t run) const {
+    return runs[run] & 3;
+}
+
+uint32_t CompactPath::getRunLength(size_t run) const {
+    return runs[run] >> 2;
+}
+
+std::pair<int, int> CompactPath::front() const {
+    return std::make_pair(startX, startY);
+}
+
+std::pair<int, int> CompactPath::back() const {
+    return std::make_pair(endX, endY);
+}
+
+CompactPath::Iterator CompactPath::begin() const {
+    return Iterator(this, 0);
+}
+
+CompactPath::Iterator CompactPath::end() const {
+    return Iterator(this, size());
+}
+
+/**
+ * Expand the path into one (x, y) pair per cell, only for callers that really need them all at once
+ */
+std::vector<std::pair<int, int>> CompactPath::toCells() const {
+    std::vector<std::pair<int, int>> cells;
+    cells.reserve(size());
+    for (const std::pair<int, int>& cell : *this) {
+        cells.push_back(cell);
+    }
+    return cells;
+}
+
+/**
+ * @return the runs as text, "R 12 D 3 L 1" is 12 cells right, 3 down and 1 left
+ */
+std::string CompactPath::toRunString() const {
+    std::ostringstream text;
+    for (size_t run = 0; run < runs.size(); run++) {
+        text << (run > 0 ? " " : "") << DIRECTION_NAMES[runs[run] & 3] << " " << (runs[run] >> 2);
+    }
+    return text.str();
+}
+
+/**
+ * Iterator at a cell of the path, only the start (0) and one past the end (size()) are used
+ */
+CompactPath::Iterator::Iterator(const CompactPath* path, size_t index) : path(path), index(index), run(0), step(0) {
+    cell = index == 0 ? path->front() : path->back();
+}
+
+CompactPath::Iterator::reference CompactPath::Iterator::operator*() const {
+    return cell;
+}
+
+CompactPath::Iterator::pointer CompactPath::Iterator::operator->() const {
+    return &cell;
+}
+
+/**
+ * Move one cell along the current run, on to the next run once this one is used up
+ */
+CompactPath::Iterator& CompactPath::Iterator::operator++() {
+    index++;
+    if (run < path->runs.size()) {
+        int direction = path->runs[run] & 3;
+        cell.first += DIRECTION_X[direction];
+        cell.second += DIRECTION_Y[direction];
+        if (++step == (path->runs[run] >> 2)) {
+            run++;
+            step = 0;
+        }
+    }
+    return *this;
+}
+
+bool CompactPath::Iterator::operator==(const Iterator& other) const {
+    return path == other.path && index == other.index;
+}
+
+bool CompactPath::Iterator::operator!=(const Iterator& other) const {
+    return !(*this == other);
+}
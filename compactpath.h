@@ -0,0 +1,74 @@
+#ifndef COMPACTPATH_H
+#define COMPACTPATH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * A grid path stored as its start cell and runs of steps in the same direction, so a path that drives 40 cells down
+ * one road is a single 4 byte run instead of 40 coordinate pairs. Cells are only worked out when something iterates
+ * over the path, and the length is known without doing that.
+ * Directions use the same codes as Dijkstra: 0 left (-x), 1 right (+x), 2 up (-y), 3 down (+y).
+ * Coordinates are (x, y) like Dijkstra
+ */
+class CompactPath {
+public:
+    // walks the cells of the path from start to end without storing them
+    class Iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<int, int> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const std::pair<int, int>* pointer;
+        typedef const std::pair<int, int>& reference;
+
+        Iterator(const CompactPath* path, size_t index);
+        reference operator*() const;
+        pointer operator->() const;
+        Iterator& operator++();
+        bool operator==(const Iterator& other) const;
+        bool operator!=(const Iterator& other) const;
+
+    private:
+        const CompactPath* path;
+        size_t index;  // how many cells from the start
+        size_t run;    // the run the next step is taken from
+        uint32_t step; // how many steps of that run have been taken
+        std::pair<int, int> cell;
+    };
+
+    CompactPath();
+    CompactPath(int startX, int startY);
+
+    static CompactPath fromCells(const std::vector<std::pair<int, int>>& cells);
+
+    void append(int direction, uint32_t steps = 1);
+
+    size_t size() const;
+    int getSteps() const;
+    size_t getRunCount() const;
+    int getRunDirection(size_t run) const;
+    uint32_t getRunLength(size_t run) const;
+    std::pair<int, int> front() const;
+    std::pair<int, int> back() const;
+
+    Iterator begin() const;
+    Iterator end() const;
+    std::vector<std::pair<int, int>> toCells() const;
+    std::string toRunString() const;
+
+private:
+    int startX;
+    int startY;
+    int endX;
+    int endY;
+    size_t steps;
+    // direction in the low 2 bits, length in the other 30
+    std::vector<uint32_t> runs;
+};
+
+#endif
@@ -1,22 +1,51 @@
-#include "dijkstra.h" 
+#include "dijkstra.h"
+#include "metrics.h"
+#include "directions.h"
 #include <queue>
 #include <limits>
 #include <iostream>
 #include <vector>
 #include <algorithm>
 
-Dijkstra::Dijkstra(const std::vector<std::vector<int>>& grid) : grid(grid) {
+const int Dijkstra::UNREACHABLE;
+
+Dijkstra::Dijkstra(const std::vector<std::vector<int>>& grid) {
     // rows and collumns are set to the grid size.
     rows = grid.size();
     cols = grid[0].size();
+    int cells = rows * cols;
+
+    // instead of copying the grid we only keep a single bit for every cell that isnt an obsticle (0)
+    passable = std::vector<uint64_t>((cells + 63) / 64, 0);
+    for (int y = 0; y < rows; y++) {
+        for (int x = 0; x < cols; x++) {
+            if (grid[y][x] != 0) {
+                int index = y * cols + x;
+                passable[index >> 6] |= (uint64_t)1 << (index & 63);
+            }
+        }
+    }
 
-    // vectors are created for the visited squares, distances, and previous squares.
-    visited = std::vector<std::vector<bool>>(rows, std::vector<bool>(cols, false));
-    // distances are set to the max value of an int, as this is how dijkstras works
-    distances = std::vector<std::vector<int>>(rows, std::vector<int>(cols, std::numeric_limits<int>::max()));
-    previous = std::vector<std::vector<std::pair<int, int>>>(rows, std::vector<std::pair<int, int>>(cols, std::make_pair(-1, -1)));
+    // bitsets are created for the visited squares and 2 bit direction codes for the previous squares.
+    visited = std::vector<uint64_t>((cells + 63) / 64, 0);
+    parents = std::vector<uint8_t>((cells + 3) / 4, 0);
+}
+/**
+ * Constructor that takes the road mask already packed, one bit per cell in row order, for example from a snapshot
+ * @param rows the amount of rows in the grid
+ * @param cols the amount of collumns in the grid
+ * @param passable (rows * cols + 63) / 64 words, bit i is set if cell i can be driven on
+ */
+Dijkstra::Dijkstra(int rows, int cols, const uint64_t* passable) {
+    this->rows = rows;
+    this->cols = cols;
+    int cells = rows * cols;
+    this->passable = std::vector<uint64_t>(passable, passable + (cells + 63) / 64);
+    visited = std::vector<uint64_t>((cells + 63) / 64, 0);
+    parents = std::vector<uint8_t>((cells + 3) / 4, 0);
 }
-Dijkstra::~Dijkstra() {   
+
+Dijkstra::~Dijkstra() {
     // no dynamic memory currently so no need to delete anything
 }
 
@@ -25,88 +54,212 @@ bool Dijkstra::isValid(int x, int y) {
     return x >= 0 && x < cols && y >= 0 && y < rows;
 }
 
-std::vector<std::pair<int, int>> Dijkstra::getNeighbors(int x, int y) {
-    // uses pairs to find grid cords of neighbors
-    std::vector<std::pair<int, int>> neighbors;
+bool Dijkstra::isPassable(int index) const {
+    return (passable[index >> 6] >> (index & 63)) & 1;
+}
 
-    // checks in 4 directs to find a neighbor
-    std::vector<std::pair<int, int>> directions = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
-    for (const auto& dir : directions) {
-        int newX = x + dir.first;
-        int newY = y + dir.second;
-        // if it is in the bounds of the grid and isnt = 0, which is our current value for an obisticle, add it to the neighbors vector
-        if (isValid(newX, newY) && grid[newY][newX] != 0) {
-            neighbors.push_back(std::make_pair(newX, newY));
-        }
-    }
-    // return the neighbors
-    return neighbors;
+bool Dijkstra::isVisited(int index) const {
+    return (visited[index >> 6] >> (index & 63)) & 1;
 }
 
-// finds the shortest path from two points on the grid, returns this in a vector of pair cords
-std::vector<std::pair<int, int>> Dijkstra::findShortestPath(int startX, int startY, int endX, int endY) {
-    // ceates a priority queue that stores distances and cords of the grid from smallest to largest
-    std::priority_queue<std::pair<int, std::pair<int, int>>, std::vector<std::pair<int, std::pair<int, int>>>, std::greater<std::pair<int, std::pair<int, int>>>> pq;
+void Dijkstra::markVisited(int index) {
+    visited[index >> 6] |= (uint64_t)1 << (index & 63);
+}
+
+/**
+ * Get the direction that was taken to reach a cell from its parent
+ * @param index the cell index (y * cols + x)
+ * @return the direction code 0 - 3 as an index into DIRECTION_X / DIRECTION_Y
+ */
+int Dijkstra::getParent(int index) const {
+    return (parents[index >> 2] >> ((index & 3) * 2)) & 3;
+}
+
+void Dijkstra::setParent(int index, int direction) {
+    int shift = (index & 3) * 2;
+    parents[index >> 2] = (uint8_t)((parents[index >> 2] & ~(3 << shift)) | (direction << shift));
+}
+
+/**
+ * Clear the search state so the same object can answer more than one query
+ */
+void Dijkstra::reset() {
+    std::fill(visited.begin(), visited.end(), 0);
+}
+
+/**
+ * Point to point search, stops as soon as the end is reached. Leaves the parent directions behind for the caller to
+ * walk back along if it wants the path
+ * @param startIndex the start cell (y * cols + x)
+ * @param endIndex the end cell
+ * @return the distance in steps, UNREACHABLE if the end cant be reached
+ */
+int Dijkstra::search(int startIndex, int endIndex) {
+    reset();
+    // per query search counters, only recorded once the search is done. cells are closed as they are pushed so
+    // there are never stale entries left in the queue to pop
+    long long popped = 0;
+    long long pushes = 1;
+
+    // ceates a priority queue that stores distances and cell indexes of the grid from smallest to largest
+    std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>, std::greater<std::pair<int, int>>> pq;
 
     // sets the distance of the start point to 0
-    pq.push(std::make_pair(0, std::make_pair(startX, startY)));
-    distances[startY][startX] = 0;
+    pq.push(std::make_pair(0, startIndex));
+    markVisited(startIndex);
+    int result = startIndex == endIndex ? 0 : UNREACHABLE;
 
    // loops until the priority queue is empty
-    while (!pq.empty()) {
-        // gets the distance of the current node
+    while (!pq.empty() && result == UNREACHABLE) {
+        // gets the distance and cell of the current node
         int dist = pq.top().first;
+        int index = pq.top().second;
+        int x = index % cols;
+        int y = index / cols;
 
-        // x and y values of the current node
-        int x = pq.top().second.first;
-        int y = pq.top().second.second;
-        
         // pop the node of the smallest distance from the priority queue
         pq.pop();
-        
-        if (x == endX && y == endY) {
-            // if the current node is the end node then break the loop
-            break;
-        }
-        
-        // if the current node has not been visited before, mark it as visited
-        if (!visited[y][x]) {
-            visited[y][x] = true;
-            // for each unvisited neighbor of the current node, calculate the new distance to reach that neighbor through the current node
-            for (const auto& neighbor : getNeighbors(x, y)) {
-                int newX = neighbor.first;
-                int newY = neighbor.second;
-                int newDist = dist + 1; // due to our current sturcture weights are all 1, which is not a great use of dijkstras
-
-                // if the new distance is smaller than the previously recorded distance for that neighbor, update the distance and add the neighbor to the priority queue
-                if (newDist < distances[newY][newX]) {
-                    distances[newY][newX] = newDist;
-                    previous[newY][newX] = std::make_pair(x, y);
-                    pq.push(std::make_pair(newDist, std::make_pair(newX, newY)));
+        popped++;
+
+        // every weight is 1, so the first time a cell is reached is always through the shortest distance.
+        // this lets us mark cells visited as they are pushed and never store a distance outside the queue
+        for (int direction = 0; direction < 4; direction++) {
+            int newX = x + DIRECTION_X[direction];
+            int newY = y + DIRECTION_Y[direction];
+            if (!isValid(newX, newY)) {
+                continue;
+            }
+            int newIndex = newY * cols + newX;
+            // if it is passable and hasnt been reached yet record how we got there and add it to the queue
+            if (isPassable(newIndex) && !isVisited(newIndex)) {
+                markVisited(newIndex);
+                setParent(newIndex, direction);
+                pq.push(std::make_pair(dist + 1, newIndex));
+                pushes++;
+                if (newIndex == endIndex) {
+                    result = dist + 1;
                 }
             }
         }
     }
-    // creates a vector of pairs to store the path
-    std::vector<std::pair<int, int>> path;
-    int x = endX;
-    int y = endY;
-
-    // while the x and y values are not -1, add the cords to the path vector
-    while (x != -1 && y != -1) {
-        // add the cords to the path vector
-        path.push_back(std::make_pair(x, y));
-
-        // get the previous cords
-        // uses auto to get the type of the previous cords
-        auto prev = previous[y][x];
-        x = prev.first;
-        y = prev.second;
+    METRICS_COUNT("dijkstra.nodes_popped", popped);
+    METRICS_COUNT("dijkstra.pushes", pushes);
+    return result;
+}
+
+// finds the shortest path from two points on the grid, returns this in a vector of pair cords
+std::vector<std::pair<int, int>> Dijkstra::findShortestPath(int startX, int startY, int endX, int endY) {
+    return findCompactPath(startX, startY, endX, endY).toCells();
+}
+
+/**
+ * Shortest path between two cells as runs of steps in the same direction, the cells are only worked out if the
+ * caller iterates over it
+ * @return the path from start to end, just the end cell if it cant be reached (like findShortestPath)
+ */
+CompactPath Dijkstra::findCompactPath(int startX, int startY, int endX, int endY) {
+    METRICS_TIMER("dijkstra.find_shortest_path");
+    int startIndex = startY * cols + startX;
+    if (search(startIndex, endY * cols + endX) == UNREACHABLE) {
+        return CompactPath(endX, endY);
     }
 
-    // reverse the path vector and return it
-    std::reverse(path.begin(), path.end());
+    CompactPath path = SearchTree::buildPath(parents, cols, startX, startY, endX, endY);
+    METRICS_COUNT("dijkstra.path_length", path.size());
     return path;
 }
 
+/**
+ * Length of the shortest path between two cells without building the path
+ * @return the amount of steps, UNREACHABLE if the end cant be reached
+ */
+int Dijkstra::findDistance(int startX, int startY, int endX, int endY) {
+    METRICS_TIMER("dijkstra.find_distance");
+    return search(startY * cols + startX, endY * cols + endX);
+}
+
+/**
+ * One to many search, finds the distance (amount of steps) from the start to every target in a single search
+ * the search stops as soon as every target has been reached
+ * @param startX the x of the start
+ * @param startY the y of the start
+ * @param targets the targets as (x, y) pairs
+ * @return the distance to each target in the same order as targets, UNREACHABLE if there is no path
+ */
+std::vector<int> Dijkstra::findDistances(int startX, int startY, const std::vector<std::pair<int, int>>& targets) {
+    METRICS_TIMER("dijkstra.find_distances");
+    reset();
+    long long popped = 0;
+    long long pushes = 1;
+    std::vector<int> result(targets.size(), UNREACHABLE);
+
+    // sort the targets by cell index so a reached cell can be matched to every target on it with a binary search
+    // a bitset of target cells lets every other cell skip the search
+    std::vector<std::pair<int, int>> targetCells;
+    std::vector<uint64_t> targetMask(visited.size(), 0);
+    for (int i = 0; i < targets.size(); i++) {
+        int index = targets[i].second * cols + targets[i].first;
+        targetCells.push_back(std::make_pair(index, i));
+        targetMask[index >> 6] |= (uint64_t)1 << (index & 63);
+    }
+    std::sort(targetCells.begin(), targetCells.end());
+    int remaining = targetCells.size();
+
+    // records the distance of a cell if it is a target and returns how many targets were on it
+    auto reachTarget = [&](int index, int dist) {
+        if (!((targetMask[index >> 6] >> (index & 63)) & 1)) {
+            return 0;
+        }
+        auto it = std::lower_bound(targetCells.begin(), targetCells.end(), std::make_pair(index, -1));
+        int found = 0;
+        for (; it != targetCells.end() && it->first == index; ++it) {
+            result[it->second] = dist;
+            found++;
+        }
+        return found;
+    };
+
+    std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>, std::greater<std::pair<int, int>>> pq;
+    int startIndex = startY * cols + startX;
+    pq.push(std::make_pair(0, startIndex));
+    markVisited(startIndex);
+    remaining -= reachTarget(startIndex, 0);
+
+    while (!pq.empty() && remaining > 0) {
+        int dist = pq.top().first;
+        int index = pq.top().second;
+        int x = index % cols;
+        int y = index / cols;
+        pq.pop();
+        popped++;
+
+        for (int direction = 0; direction < 4; direction++) {
+            int newX = x + DIRECTION_X[direction];
+            int newY = y + DIRECTION_Y[direction];
+            if (!isValid(newX, newY)) {
+                continue;
+            }
+            int newIndex = newY * cols + newX;
+            if (isPassable(newIndex) && !isVisited(newIndex)) {
+                markVisited(newIndex);
+                setParent(newIndex, direction);
+                remaining -= reachTarget(newIndex, dist + 1);
+                pq.push(std::make_pair(dist + 1, newIndex));
+                pushes++;
+            }
+        }
+    }
+    METRICS_COUNT("dijkstra.one_to_many.nodes_popped", popped);
+    METRICS_COUNT("dijkstra.one_to_many.pushes", pushes);
+    return result;
+}
 
+/**
+ * One to many search like findDistances that also keeps the tree it grew, so the paths to the targets can be
+ * taken out of it afterwards without searching again
+ * @return the distances to the targets and the tree to walk the paths out of
+ */
+SearchTree Dijkstra::findSearchTree(int startX, int startY, const std::vector<std::pair<int, int>>& targets) {
+    std::vector<int> distances = findDistances(startX, startY, targets);
+    return SearchTree(cols, startX, startY, visited, parents, distances);
+}
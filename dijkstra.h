@@ -4,23 +4,43 @@
 #include <vector>
 #include <utility>
 #include <queue>
+#include <cstdint>
+#include <limits>
+#include "compactpath.h"
+#include "searchtree.h"
 
 class Dijkstra {
 public:
+    // distance reported for targets that cant be reached, small enough that a few of them can be summed safely
+    static const int UNREACHABLE = std::numeric_limits<int>::max() / 4;
+
     Dijkstra(const std::vector<std::vector<int>>& grid);
+    Dijkstra(int rows, int cols, const uint64_t* passable);
     ~Dijkstra();
     std::vector<std::pair<int, int>> findShortestPath(int startX, int startY, int endX, int endY);
+    CompactPath findCompactPath(int startX, int startY, int endX, int endY);
+    int findDistance(int startX, int startY, int endX, int endY);
+    std::vector<int> findDistances(int startX, int startY, const std::vector<std::pair<int, int>>& targets);
+    SearchTree findSearchTree(int startX, int startY, const std::vector<std::pair<int, int>>& targets);
 
 private:
-    std::vector<std::vector<int>> grid;
-    std::vector<std::vector<bool>> visited;
-    std::vector<std::vector<int>> distances;
-    std::vector<std::vector<std::pair<int, int>>> previous;
+    // the search state is bit packed so large maps stay small in memory:
+    // 1 bit per cell for the road mask, 1 bit per cell for visited and 2 bits per cell for the parent direction.
+    // distances are only kept for the cells on the frontier (inside the priority queue)
+    std::vector<uint64_t> passable;
+    std::vector<uint64_t> visited;
+    std::vector<uint8_t> parents;
     int rows;
     int cols;
 
     bool isValid(int x, int y);
-    std::vector<std::pair<int, int>> getNeighbors(int x, int y);
+    bool isPassable(int index) const;
+    bool isVisited(int index) const;
+    void markVisited(int index);
+    int getParent(int index) const;
+    void setParent(int index, int direction);
+    void reset();
+    int search(int startIndex, int endIndex);
 };
 
-#endif
\ No newline at end of file
+#endif
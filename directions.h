@@ -0,0 +1,9 @@
+#ifndef DIRECTIONS_H
+#define DIRECTIONS_H
+
+// the 4 directions we can move in stored as x and y offsets (left, right, up, down). the index of a direction is the
+// 2 bit parent code every search keeps and the direction of a CompactPath run
+static const int DIRECTION_X[4] = {-1, 1, 0, 0};
+static const int DIRECTION_Y[4] = {0, 0, -1, 1};
+
+#endif
@@ -0,0 +1,189 @@
+#include "dispatchqueue.h"
+#include <cmath>
+
+/**
+ * Constructor for an empty dispatch queue
+ * @param capacity how many different orders can be in the queue, orders are numbered 0 -> capacity - 1
+ */
+DispatchQueue::DispatchQueue(int capacity) {
+    position = std::vector<int>(capacity, -1);
+    keys = std::vector<int>(capacity, 0);
+    heap.reserve(capacity);
+}
+
+bool DispatchQueue::empty() const {
+    return heap.empty();
+}
+
+int DispatchQueue::size() const {
+    return heap.size();
+}
+
+bool DispatchQueue::contains(int order) const {
+    return position[order] != -1;
+}
+
+int DispatchQueue::getKey(int order) const {
+    return keys[order];
+}
+
+/**
+ * Add an order to the queue, O(log n)
+ * @param order the order number, must not already be in the queue
+ * @param key the distance to the order
+ */
+void DispatchQueue::push(int order, int key) {
+    keys[order] = key;
+    position[order] = heap.size();
+    heap.push_back(order);
+    siftUp(heap.size() - 1);
+}
+
+/**
+ * @return the closest order without removing it, the queue must not be empty
+ */
+int DispatchQueue::top() const {
+    return heap[0];
+}
+
+/**
+ * Remove and return the closest order, O(log n)
+ * @return the order number, the queue must not be empty
+ */
+int DispatchQueue::extractMin() {
+    int order = heap[0];
+    remove(order);
+    return order;
+}
+
+/**
+ * Remove an order that was served some other way, O(log n). Orders not in the queue are ignored
+ * @param order the order number
+ */
+void DispatchQueue::remove(int order) {
+    int node = position[order];
+    if (node == -1) {
+        return;
+    }
+    int last = heap.size() - 1;
+    swapNodes(node, last);
+    heap.pop_back();
+    position[order] = -1;
+
+    // the order moved into the hole can belong either higher or lower in the heap
+    if (node < heap.size()) {
+        int moved = heap[node];
+        siftUp(node);
+        siftDown(position[moved]);
+    }
+}
+
+/**
+ * Change the distance to a single order, O(log n)
+ * @param order the order number, must be in the queue
+ * @param key the new distance
+ */
+void DispatchQueue::update(int order, int key) {
+    int oldKey = keys[order];
+    keys[order] = key;
+    if (key < oldKey) {
+        siftUp(position[order]);
+    } else {
+        siftDown(position[order]);
+    }
+}
+
+/**
+ * Change the distance to several orders at once. Small batches are sifted one by one in O(k log n), large batches
+ * rebuild the heap bottom up in O(n), whichever is cheaper
+ * @param orders the order numbers, orders not in the queue are ignored
+ * @param newKeys the new distance of each order
+ */
+void DispatchQueue::updateBatch(const std::vector<int>& orders, const std::vector<int>& newKeys) {
+    double logSize = std::log2(heap.size() + 2.0);
+    if (orders.size() * logSize < heap.size()) {
+        for (int i = 0; i < orders.size(); i++) {
+            if (contains(orders[i])) {
+                update(orders[i], newKeys[i]);
+            }
+        }
+        return;
+    }
+    for (int i = 0; i < orders.size(); i++) {
+        if (contains(orders[i])) {
+            keys[orders[i]] = newKeys[i];
+        }
+    }
+    heapify();
+}
+
+/**
+ * Refresh the distance to every order, used when the current position moves, O(n)
+ * @param newKeys the new distance of every order by order number, entries for orders not in the queue are ignored
+ */
+void DispatchQueue::updateAll(const std::vector<int>& newKeys) {
+    for (int order : heap) {
+        keys[order] = newKeys[order];
+    }
+    heapify();
+}
+
+/**
+ * Ties are broken by order number so the result doesnt depend on the shape of the heap
+ */
+bool DispatchQueue::less(int a, int b) const {
+    int orderA = heap[a];
+    int orderB = heap[b];
+    if (keys[orderA] != keys[orderB]) {
+        return keys[orderA] < keys[orderB];
+    }
+    return orderA < orderB;
+}
+
+void DispatchQueue::swapNodes(int a, int b) {
+    int orderA = heap[a];
+    heap[a] = heap[b];
+    heap[b] = orderA;
+    position[heap[a]] = a;
+    position[heap[b]] = b;
+}
+
+void DispatchQueue::siftUp(int node) {
+    while (node > 0) {
+        int parent = (node - 1) / 2;
+        if (!less(node, parent)) {
+            return;
+        }
+        swapNodes(node, parent);
+        node = parent;
+    }
+}
+
+void DispatchQueue::siftDown(int node) {
+    int size = heap.size();
+    while (true) {
+        int smallest = node;
+        int left = node * 2 + 1;
+        int right = left + 1;
+        if (left < size && less(left, smallest)) {
+            smallest = left;
+        }
+        if (right < size && less(right, smallest)) {
+            smallest = right;
+        }
+        if (smallest == node) {
+            return;
+        }
+        swapNodes(node, smallest);
+        node = smallest;
+    }
+}
+
+/**
+ * Rebuild the heap bottom up after many keys changed, O(n)
+ */
+void DispatchQueue::heapify() {
+    for (int node = heap.size() / 2 - 1; node >= 0; node--) {
+        siftDown(node);
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef DISPATCHQUEUE_H
+#define DISPATCHQUEUE_H
+
+#include <vector>
+
+/*
+ * Dispatch queue, an indexed binary min heap of pending orders keyed by their distance from the current position
+ * orders are numbered 0 -> capacity - 1. Extracting the closest order, removing a served order and changing a single
+ * distance are O(log n), and a batch of new distances is applied in O(n) when the position moves
+ */
+class DispatchQueue {
+public:
+    explicit DispatchQueue(int capacity);
+
+    bool empty() const;
+    int size() const;
+    bool contains(int order) const;
+    int getKey(int order) const;
+
+    void push(int order, int key);
+    int top() const;
+    int extractMin();
+    void remove(int order);
+    void update(int order, int key);
+    void updateBatch(const std::vector<int>& orders, const std::vector<int>& keys);
+    void updateAll(const std::vector<int>& keys);
+
+private:
+    // heap of order numbers, and where every order sits in the heap (-1 when it isnt in it)
+    std::vector<int> heap;
+    std::vector<int> position;
+    std::vector<int> keys;
+
+    bool less(int a, int b) const;
+    void swapNodes(int a, int b);
+    void siftUp(int node);
+    void siftDown(int node);
+    void heapify();
+};
+
+#endif
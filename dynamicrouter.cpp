@@ -0,0 +1,337 @@
+#include "dynamicrouter.h"
+#include "metrics.h"
+#include "directions.h"
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+const int DynamicRouter::UNREACHABLE;
+const int DynamicRouter::BLOCKED;
+
+/**
+ * Constructor for the router, every passable cell starts with a cost of 1
+ * @param rows the amount of rows in the grid
+ * @param cols the amount of collumns in the grid
+ * @param passable (rows * cols + 63) / 64 words, bit i is set if cell i can be driven on
+ */
+DynamicRouter::DynamicRouter(int rows, int cols, const uint64_t* passable) {
+    this->rows = rows;
+    this->cols = cols;
+    costs = std::vector<uint16_t>(rows * cols, BLOCKED);
+    changedCells = 0;
+    for (int cell = 0; cell < rows * cols; cell++) {
+        if ((passable[cell >> 6] >> (cell & 63)) & 1) {
+            costs[cell] = 1;
+        }
+    }
+    originalCosts = costs;
+}
+
+bool DynamicRouter::isValid(int x, int y) const {
+    return x >= 0 && x < cols && y >= 0 && y < rows;
+}
+
+/**
+ * @return true if any cell has a different cost than it started with
+ */
+bool DynamicRouter::isModified() const {
+    return changedCells > 0;
+}
+
+/**
+ * @return the cost of driving into a cell, BLOCKED (0) if it cant be driven on
+ */
+int DynamicRouter::getCost(int x, int y) const {
+    return costs[y * cols + x];
+}
+
+/**
+ * Change how expensive it is to drive into a cell
+ * @param x the column
+ * @param y the row
+ * @param cost the new cost from 1 to 65535, or BLOCKED to close the cell
+ */
+void DynamicRouter::setCost(int x, int y, int cost) {
+    int cell = y * cols + x;
+    cost = std::max(BLOCKED, std::min(cost, 65535));
+    int oldCost = costs[cell];
+    if (cost == oldCost) {
+        return;
+    }
+    if (oldCost == originalCosts[cell]) {
+        changedCells++;
+    } else if (cost == originalCosts[cell]) {
+        changedCells--;
+    }
+    costs[cell] = cost;
+    cellChanged(cell, oldCost, cost);
+}
+
+void DynamicRouter::block(int x, int y) {
+    setCost(x, y, BLOCKED);
+}
+
+/**
+ * Open a blocked cell again with its normal cost of 1, cells that were never roads can be opened too (a new road)
+ */
+void DynamicRouter::unblock(int x, int y) {
+    if (getCost(x, y) == BLOCKED) {
+        setCost(x, y, 1);
+    }
+}
+
+/**
+ * Start watching a route, its search state is kept so it can be repaired cheaply after every change
+ * @return the id of the route
+ */
+int DynamicRouter::watch(int startX, int startY, int endX, int endY) {
+    int id = nextRoute++;
+    initialize(routes[id], startY * cols + startX, endY * cols + endX);
+    return id;
+}
+
+void DynamicRouter::unwatch(int route) {
+    routes.erase(route);
+}
+
+bool DynamicRouter::isWatched(int route) const {
+    return routes.count(route) > 0;
+}
+
+/**
+ * The current shortest path of a watched route, repaired first if anything changed since it was last asked for
+ * @param route the id from watch
+ * @return the path as (x, y) pairs from start to end, empty if the end cant be reached
+ */
+std::vector<std::pair<int, int>> DynamicRouter::getPath(int route) {
+    Route& state = routes.at(route);
+    computeShortestPath(state);
+    std::vector<std::pair<int, int>> path;
+    for (int cell : extractPath(state)) {
+        path.push_back(std::make_pair(cell % cols, cell / cols));
+    }
+    return path;
+}
+
+/**
+ * The current cost of a watched route, repaired first if anything changed since it was last asked for
+ */
+int DynamicRouter::getDistance(int route) {
+    Route& state = routes.at(route);
+    computeShortestPath(state);
+    return std::min(state.g[state.end], (int)UNREACHABLE);
+}
+
+/**
+ * One off shortest path with the current costs
+ * @return the path as (x, y) pairs from start to end, empty if the end cant be reached
+ */
+std::vector<std::pair<int, int>> DynamicRouter::findShortestPath(int startX, int startY, int endX, int endY) {
+    initialize(scratch, startY * cols + startX, endY * cols + endX);
+    computeShortestPath(scratch);
+    std::vector<std::pair<int, int>> path;
+    for (int cell : extractPath(scratch)) {
+        path.push_back(std::make_pair(cell % cols, cell / cols));
+    }
+    return path;
+}
+
+/**
+ * Cost of the shortest path with the current costs, answered from the cache when nothing on it has changed
+ * @return the cost, UNREACHABLE if there is no path
+ */
+int DynamicRouter::findDistance(int startX, int startY, int endX, int endY) {
+    int start = startY * cols + startX;
+    int end = endY * cols + endX;
+    uint64_t key = (uint64_t)start << 32 | (uint32_t)end;
+    auto cached = cache.find(key);
+    if (cached != cache.end()) {
+        METRICS_COUNT("dynamic_router.cache_hits", 1);
+        return cached->second.distance;
+    }
+
+    initialize(scratch, start, end);
+    computeShortestPath(scratch);
+    CachedDistance entry;
+    entry.distance = std::min(scratch.g[end], (int)UNREACHABLE);
+    entry.cells = extractPath(scratch);
+    std::sort(entry.cells.begin(), entry.cells.end());
+    cache[key] = entry;
+    return entry.distance;
+}
+
+/**
+ * Cost of driving into a cell, UNREACHABLE if it is blocked
+ */
+int DynamicRouter::cost(int cell) const {
+    return costs[cell] == BLOCKED ? UNREACHABLE : costs[cell];
+}
+
+/**
+ * Manhattan distance to the end of the route, every step costs at least 1 so it never overestimates
+ */
+int DynamicRouter::heuristic(const Route& route, int cell) const {
+    return std::abs(cell % cols - route.end % cols) + std::abs(cell / cols - route.end / cols);
+}
+
+std::pair<int, int> DynamicRouter::calculateKey(const Route& route, int cell) const {
+    int best = std::min(route.g[cell], route.rhs[cell]);
+    return std::make_pair(std::min(best + heuristic(route, cell), (int)UNREACHABLE), best);
+}
+
+/**
+ * Reset a route to nothing searched yet, only the start is known (rhs = 0)
+ */
+void DynamicRouter::initialize(Route& route, int start, int end) {
+    route.start = start;
+    route.end = end;
+    route.g.assign(rows * cols, UNREACHABLE);
+    route.rhs.assign(rows * cols, UNREACHABLE);
+    route.queue.clear();
+    route.rhs[start] = 0;
+    route.queue.push_back(std::make_pair(calculateKey(route, start), start));
+    route.dirty = true;
+}
+
+/**
+ * Recalculate the one step lookahead of a cell from its neighbours and queue it if it is now inconsistent
+ */
+void DynamicRouter::updateVertex(Route& route, int cell) {
+    if (cell != route.start) {
+        int best = UNREACHABLE;
+        if (costs[cell] != BLOCKED) {
+            int x = cell % cols;
+            int y = cell / cols;
+            for (int direction = 0; direction < 4; direction++) {
+                int newX = x + DIRECTION_X[direction];
+                int newY = y + DIRECTION_Y[direction];
+                if (isValid(newX, newY)) {
+                    best = std::min(best, route.g[newY * cols + newX]);
+                }
+            }
+            best = std::min(best + cost(cell), (int)UNREACHABLE);
+        }
+        route.rhs[cell] = best;
+    }
+    if (route.g[cell] != route.rhs[cell]) {
+        route.queue.push_back(std::make_pair(calculateKey(route, cell), cell));
+        std::push_heap(route.queue.begin(), route.queue.end(), std::greater<std::pair<std::pair<int, int>, int>>());
+        route.dirty = true;
+    }
+}
+
+/**
+ * Expand inconsistent cells until the end of the route is consistent and nothing in the queue could still improve it
+ * right after a change this only touches the cells whose distance the change affected
+ */
+void DynamicRouter::computeShortestPath(Route& route) {
+    if (!route.dirty) {
+        return;
+    }
+    METRICS_TIMER("dynamic_router.repair");
+    std::greater<std::pair<std::pair<int, int>, int>> later;
+    long long popped = 0;
+    long long stale = 0;
+    while (!route.queue.empty()) {
+        std::pair<std::pair<int, int>, int> top = route.queue.front();
+        int cell = top.second;
+        // an entry is stale if the cell became consistent or was queued again with a newer key since
+        if (route.g[cell] == route.rhs[cell] || top.first != calculateKey(route, cell)) {
+            std::pop_heap(route.queue.begin(), route.queue.end(), later);
+            route.queue.pop_back();
+            stale++;
+            continue;
+        }
+        if (!(top.first < calculateKey(route, route.end)) && route.g[route.end] == route.rhs[route.end]) {
+            break;
+        }
+        std::pop_heap(route.queue.begin(), route.queue.end(), later);
+        route.queue.pop_back();
+        popped++;
+
+        if (route.g[cell] > route.rhs[cell]) {
+            route.g[cell] = route.rhs[cell];
+        } else {
+            route.g[cell] = UNREACHABLE;
+            updateVertex(route, cell);
+        }
+        int x = cell % cols;
+        int y = cell / cols;
+        for (int direction = 0; direction < 4; direction++) {
+            int newX = x + DIRECTION_X[direction];
+            int newY = y + DIRECTION_Y[direction];
+            if (isValid(newX, newY)) {
+                updateVertex(route, newY * cols + newX);
+            }
+        }
+    }
+    route.dirty = false;
+    METRICS_COUNT("dynamic_router.nodes_popped", popped);
+    METRICS_COUNT("dynamic_router.stale_pops", stale);
+}
+
+/**
+ * Walk back from the end of a searched route, always to the neighbour with the smallest distance
+ * @return the cells of the path from start to end, empty if the end cant be reached
+ */
+std::vector<int> DynamicRouter::extractPath(const Route& route) const {
+    std::vector<int> path;
+    if (route.g[route.end] >= UNREACHABLE) {
+        return path;
+    }
+    int cell = route.end;
+    path.push_back(cell);
+    while (cell != route.start) {
+        int x = cell % cols;
+        int y = cell / cols;
+        int next = -1;
+        for (int direction = 0; direction < 4; direction++) {
+            int newX = x + DIRECTION_X[direction];
+            int newY = y + DIRECTION_Y[direction];
+            int neighbour = newY * cols + newX;
+            // a blocked cell cant be driven through, only the start is allowed to be blocked (we are already there)
+            if (!isValid(newX, newY) || (costs[neighbour] == BLOCKED && neighbour != route.start)) {
+                continue;
+            }
+            if (next == -1 || route.g[neighbour] < route.g[next]) {
+                next = neighbour;
+            }
+        }
+        cell = next;
+        path.push_back(cell);
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+/**
+ * A cell changed cost, let every watched route know and drop the cached distances it could have changed.
+ * A cell getting more expensive can only change paths that go through it. A cell getting cheaper can only help a
+ * path if going through it could beat the cached distance, which every step costing at least 1 lets us bound
+ */
+void DynamicRouter::cellChanged(int cell, int oldCost, int newCost) {
+    for (auto& route : routes) {
+        updateVertex(route.second, cell);
+    }
+
+    bool cheaper = newCost != BLOCKED && (oldCost == BLOCKED || newCost < oldCost);
+    int x = cell % cols;
+    int y = cell / cols;
+    for (auto it = cache.begin(); it != cache.end();) {
+        bool affected;
+        if (cheaper) {
+            int start = it->first >> 32;
+            int end = (int)(it->first & 0xffffffff);
+            int through = std::abs(x - start % cols) + std::abs(y - start / cols) + std::abs(x - end % cols) + std::abs(y - end / cols);
+            affected = through < it->second.distance;
+        } else {
+            affected = std::binary_search(it->second.cells.begin(), it->second.cells.end(), cell);
+        }
+        if (affected) {
+            it = cache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
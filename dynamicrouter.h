@@ -0,0 +1,81 @@
+#ifndef DYNAMICROUTER_H
+#define DYNAMICROUTER_H
+
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+ * Router for a road grid that changes while it is being used. Road cells can be blocked, unblocked or given a cost
+ * (how expensive it is to drive into them, 1 by default), and routes that are being watched are repaired with
+ * Lifelong Planning A* (LPA*). LPA* keeps the search state of every watched route, so after a change only the cells
+ * whose distance actually changed are expanded again instead of searching the whole route from scratch.
+ * Distances that were asked for before are cached and a change only throws away the ones it could affect.
+ * Coordinates are (x, y) like Dijkstra
+ */
+class DynamicRouter {
+public:
+    // distance reported for cells that cant be reached
+    static const int UNREACHABLE = INT32_MAX / 4;
+    // cost of a cell that is blocked
+    static const int BLOCKED = 0;
+
+    DynamicRouter(int rows, int cols, const uint64_t* passable);
+
+    bool isValid(int x, int y) const;
+    bool isModified() const;
+    int getCost(int x, int y) const;
+    void setCost(int x, int y, int cost);
+    void block(int x, int y);
+    void unblock(int x, int y);
+
+    int watch(int startX, int startY, int endX, int endY);
+    void unwatch(int route);
+    bool isWatched(int route) const;
+    std::vector<std::pair<int, int>> getPath(int route);
+    int getDistance(int route);
+
+    std::vector<std::pair<int, int>> findShortestPath(int startX, int startY, int endX, int endY);
+    int findDistance(int startX, int startY, int endX, int endY);
+
+private:
+    // the LPA* state of one route, g is the distance found so far and rhs the one step lookahead,
+    // cells where they differ are in the queue waiting to be expanded
+    struct Route {
+        int start;
+        int end;
+        std::vector<int> g;
+        std::vector<int> rhs;
+        // min heap of (key, cell), entries whose key is out of date are skipped when popped
+        std::vector<std::pair<std::pair<int, int>, int>> queue;
+        bool dirty;
+    };
+    // a cached distance and the cells of the path it was measured along, sorted so they can be binary searched
+    struct CachedDistance {
+        int distance;
+        std::vector<int> cells;
+    };
+
+    int rows;
+    int cols;
+    int changedCells; // how many cells have a cost other than their original one
+    std::vector<uint16_t> costs;
+    std::vector<uint16_t> originalCosts;
+    std::map<int, Route> routes;
+    int nextRoute = 0;
+    Route scratch;
+    std::unordered_map<uint64_t, CachedDistance> cache;
+
+    int cost(int cell) const;
+    int heuristic(const Route& route, int cell) const;
+    std::pair<int, int> calculateKey(const Route& route, int cell) const;
+    void initialize(Route& route, int start, int end);
+    void updateVertex(Route& route, int cell);
+    void computeShortestPath(Route& route);
+    std::vector<int> extractPath(const Route& route) const;
+    void cellChanged(int cell, int oldCost, int newCost);
+};
+
+#endif
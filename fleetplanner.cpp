@@ -0,0 +1,314 @@
+#include "fleetplanner.h"
+#include "routeoptimizer.h"
+#include "radixsort.h"
+#include "metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * Constructor for a fleet planner
+ * @param distances square matrix where distances[i][j] is the distance from stop i to stop j, stop 0 is the hub
+ * @param vehicles how many vehicles leave the hub
+ * @param capacity the most orders a single vehicle can carry
+ * @param timeBudgetMs how long planning is allowed to take
+ * @param threads worker threads used for local search, 0 uses one per hardware thread
+ * @param maxPasses 0 to plan until the time budget runs out, otherwise the most rounds of moving stops between routes
+ *                  (and passes of every RouteOptimizer) and the time budget is ignored, so the plan is the same on
+ *                  every run however busy the machine is
+ */
+FleetPlanner::FleetPlanner(const std::vector<std::vector<int>>& distances, int vehicles, int capacity, int timeBudgetMs, int threads,
+                           int maxPasses)
+    : distances(distances), pool(threads) {
+    this->stops = distances.size();
+    this->vehicles = vehicles;
+    this->capacity = capacity;
+    this->timeBudgetMs = timeBudgetMs;
+    this->maxPasses = maxPasses;
+
+    if (vehicles <= 0 || capacity <= 0 || (long long)vehicles * capacity < stops - 1) {
+        throw std::invalid_argument("the fleet does not have enough capacity for every order");
+    }
+}
+
+/**
+ * Distance between two stops, routes are open so going to the "stop" after the last one (-1) costs nothing
+ */
+int FleetPlanner::distance(int from, int to) const {
+    if (from < 0 || to < 0) {
+        return 0;
+    }
+    return distances[from][to];
+}
+
+/**
+ * Total length of a single vehicles route
+ * @param route the stops in the order they are visited, starting with 0 (the hub)
+ */
+int FleetPlanner::routeLength(const std::vector<int>& route) const {
+    int length = 0;
+    for (int i = 1; i < route.size(); i++) {
+        length += distance(route[i - 1], route[i]);
+    }
+    return length;
+}
+
+/**
+ * Plan a route for every vehicle
+ * @return one route per vehicle, each starting with 0 (the hub). Vehicles without orders get a route of just the hub
+ */
+std::vector<std::vector<int>> FleetPlanner::plan() {
+    METRICS_TIMER("fleet_planner.plan");
+    auto startTime = std::chrono::steady_clock::now();
+    auto deadline = startTime + std::chrono::milliseconds(timeBudgetMs);
+
+    std::vector<std::vector<int>> routes = savings();
+    reduceRoutes(routes);
+
+    // optimize every route once, then keep moving stops between routes and reoptimizing the ones that changed
+    std::vector<bool> changed(routes.size(), true);
+    optimizeRoutes(routes, changed, timeBudgetMs / 4);
+    for (int pass = 0; maxPasses > 0 ? pass < maxPasses : std::chrono::steady_clock::now() < deadline; pass++) {
+        std::fill(changed.begin(), changed.end(), false);
+        if (!relocate(routes, changed)) {
+            break;
+        }
+        int remainingMs = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        optimizeRoutes(routes, changed, std::max(remainingMs / 4, 1));
+    }
+
+    while (routes.size() < vehicles) {
+        routes.push_back(std::vector<int>(1, 0));
+    }
+    return routes;
+}
+
+/**
+ * Clarke-Wright savings heuristic for open routes. Every order starts on its own route and routes are joined end to
+ * start in order of how much distance joining them saves, as long as capacity allows. Routes never drive back to the
+ * hub, so putting j's route after i only saves the drive out to j: s(i, j) = d(0, j) - d(i, j). A route that has to
+ * be turned around to end at i starts from its other end, which is charged to the saving when the join is made
+ * @return the routes, each starting with 0 (the hub)
+ */
+std::vector<std::vector<int>> FleetPlanner::savings() {
+    std::vector<std::vector<int>> chains;
+    std::vector<int> chainOf(stops, -1);
+    for (int stop = 1; stop < stops; stop++) {
+        chainOf[stop] = chains.size();
+        chains.push_back(std::vector<int>(1, stop));
+    }
+
+    // every ordered pair (i before j) with a positive saving, largest saving first
+    std::vector<std::pair<int, std::pair<int, int>>> pairs;
+    for (int i = 1; i < stops; i++) {
+        for (int j = 1; j < stops; j++) {
+            int saving = i == j ? 0 : distance(0, j) - distance(i, j);
+            if (saving > 0) {
+                pairs.push_back(std::make_pair(saving, std::make_pair(i, j)));
+            }
+        }
+    }
+    {
+        METRICS_TIMER("fleet_planner.sort_savings");
+        RadixSort::sort(pairs, true);
+    }
+    METRICS_COUNT("fleet_planner.savings_pairs", pairs.size());
+
+    for (const auto& pair : pairs) {
+        int i = pair.second.first;
+        int j = pair.second.second;
+        int a = chainOf[i];
+        int b = chainOf[j];
+        if (a == b || chains[a].size() + chains[b].size() > capacity) {
+            continue;
+        }
+        // the orders have to be on the ends of their routes to be joined
+        bool iOnEnd = chains[a].front() == i || chains[a].back() == i;
+        bool jOnEnd = chains[b].front() == j || chains[b].back() == j;
+        if (!iOnEnd || !jOnEnd) {
+            continue;
+        }
+        // the joined route starts wherever a starts once it is turned to end at i, both old drives out are saved
+        int start = chains[a].back() == i ? chains[a].front() : chains[a].back();
+        int saving = distance(0, chains[a].front()) + distance(0, chains[b].front()) - distance(0, start) - distance(i, j);
+        if (saving <= 0) {
+            continue;
+        }
+
+        if (chains[a].back() != i) {
+            std::reverse(chains[a].begin(), chains[a].end());
+        }
+        if (chains[b].front() != j) {
+            std::reverse(chains[b].begin(), chains[b].end());
+        }
+        // keep the joined route where the longer chain was so fewer orders have to be moved
+        if (chains[a].size() < chains[b].size()) {
+            for (int stop : chains[a]) {
+                chainOf[stop] = b;
+            }
+            chains[b].insert(chains[b].begin(), chains[a].begin(), chains[a].end());
+            chains[a].clear();
+        } else {
+            for (int stop : chains[b]) {
+                chainOf[stop] = a;
+            }
+            chains[a].insert(chains[a].end(), chains[b].begin(), chains[b].end());
+            chains[b].clear();
+        }
+    }
+
+    std::vector<std::vector<int>> routes;
+    for (const std::vector<int>& chain : chains) {
+        if (!chain.empty()) {
+            std::vector<int> route(1, 0);
+            route.insert(route.end(), chain.begin(), chain.end());
+            routes.push_back(route);
+        }
+    }
+    return routes;
+}
+
+/**
+ * If savings left more routes than there are vehicles, break up the smallest routes and insert their orders
+ * wherever they are cheapest in the remaining routes that still have capacity
+ * @param routes the routes to reduce in place
+ */
+void FleetPlanner::reduceRoutes(std::vector<std::vector<int>>& routes) {
+    while (routes.size() > vehicles) {
+        auto smallest = std::min_element(routes.begin(), routes.end(),
+            [](const std::vector<int>& a, const std::vector<int>& b) { return a.size() < b.size(); });
+        std::vector<int> orphans(smallest->begin() + 1, smallest->end());
+        routes.erase(smallest);
+
+        for (int stop : orphans) {
+            int bestRoute = -1;
+            int bestPosition = -1;
+            int bestCost = 0;
+            for (int r = 0; r < routes.size(); r++) {
+                if (routes[r].size() - 1 >= capacity) {
+                    continue;
+                }
+                for (int q = 0; q < routes[r].size(); q++) {
+                    int next = q + 1 < routes[r].size() ? routes[r][q + 1] : -1;
+                    int cost = distance(routes[r][q], stop) + distance(stop, next) - distance(routes[r][q], next);
+                    if (bestRoute == -1 || cost < bestCost) {
+                        bestRoute = r;
+                        bestPosition = q;
+                        bestCost = cost;
+                    }
+                }
+            }
+            routes[bestRoute].insert(routes[bestRoute].begin() + bestPosition + 1, stop);
+        }
+    }
+}
+
+/**
+ * Reorder the stops inside every changed route in parallel, each route is an independent RouteOptimizer problem
+ * @param routes the routes to improve in place
+ * @param changed which routes need to be optimized
+ * @param timeBudgetMs the time budget given to each route
+ */
+void FleetPlanner::optimizeRoutes(std::vector<std::vector<int>>& routes, const std::vector<bool>& changed, int timeBudgetMs) {
+    std::vector<std::pair<int, std::future<std::vector<int>>>> results;
+    for (int r = 0; r < routes.size(); r++) {
+        if (!changed[r] || routes[r].size() <= 2) {
+            continue;
+        }
+        const std::vector<int>& route = routes[r];
+        results.push_back(std::make_pair(r, pool.submit([this, &route, timeBudgetMs]() {
+            // the distances between only the stops on this route, stop 0 stays the hub
+            std::vector<std::vector<int>> local(route.size(), std::vector<int>(route.size()));
+            for (int i = 0; i < route.size(); i++) {
+                for (int j = 0; j < route.size(); j++) {
+                    local[i][j] = distance(route[i], route[j]);
+                }
+            }
+            RouteOptimizer optimizer(local, timeBudgetMs, maxPasses);
+            std::vector<int> order = optimizer.solve();
+
+            std::vector<int> optimized;
+            for (int index : order) {
+                optimized.push_back(route[index]);
+            }
+            return optimized;
+        })));
+    }
+    // wait for every task before writing any route back, the tasks read the routes by reference
+    std::vector<std::pair<int, std::vector<int>>> optimized;
+    for (auto& result : results) {
+        optimized.push_back(std::make_pair(result.first, result.second.get()));
+    }
+    for (auto& route : optimized) {
+        routes[route.first] = route.second;
+    }
+}
+
+/**
+ * Find the single stop in a route that saves the most distance by moving to another route with spare capacity
+ * @param routes every route, only read
+ * @param fromRoute the route to take a stop out of
+ * @return the best move found, with a gain of 0 if nothing helps
+ */
+FleetPlanner::Move FleetPlanner::findBestRelocate(const std::vector<std::vector<int>>& routes, int fromRoute) {
+    Move best = {0, fromRoute, -1, -1, -1};
+    const std::vector<int>& from = routes[fromRoute];
+    for (int p = 1; p < from.size(); p++) {
+        int stop = from[p];
+        int next = p + 1 < from.size() ? from[p + 1] : -1;
+        int removeGain = distance(from[p - 1], stop) + distance(stop, next) - distance(from[p - 1], next);
+
+        for (int r = 0; r < routes.size(); r++) {
+            if (r == fromRoute || routes[r].size() - 1 >= capacity) {
+                continue;
+            }
+            const std::vector<int>& to = routes[r];
+            for (int q = 0; q < to.size(); q++) {
+                int after = q + 1 < to.size() ? to[q + 1] : -1;
+                int insertCost = distance(to[q], stop) + distance(stop, after) - distance(to[q], after);
+                if (removeGain - insertCost > best.gain) {
+                    best = {removeGain - insertCost, fromRoute, p, r, q};
+                }
+            }
+        }
+    }
+    return best;
+}
+
+/**
+ * One round of relocate moves. The best move out of every route is searched for in parallel, then the moves are
+ * applied largest gain first as long as no earlier move this round already touched either route
+ * @param routes the routes to improve in place
+ * @param changed set to true for every route that was changed
+ * @return true if any move was made
+ */
+bool FleetPlanner::relocate(std::vector<std::vector<int>>& routes, std::vector<bool>& changed) {
+    std::vector<std::future<Move>> results;
+    for (int r = 0; r < routes.size(); r++) {
+        results.push_back(pool.submit([this, &routes, r]() { return findBestRelocate(routes, r); }));
+    }
+    std::vector<Move> moves;
+    for (auto& result : results) {
+        Move move = result.get();
+        if (move.gain > 0) {
+            moves.push_back(move);
+        }
+    }
+    std::sort(moves.begin(), moves.end(), [](const Move& a, const Move& b) { return a.gain > b.gain; });
+
+    bool moved = false;
+    for (const Move& move : moves) {
+        if (changed[move.fromRoute] || changed[move.toRoute]) {
+            continue;
+        }
+        int stop = routes[move.fromRoute][move.fromPosition];
+        routes[move.fromRoute].erase(routes[move.fromRoute].begin() + move.fromPosition);
+        routes[move.toRoute].insert(routes[move.toRoute].begin() + move.toPosition + 1, stop);
+        changed[move.fromRoute] = true;
+        changed[move.toRoute] = true;
+        moved = true;
+    }
+    return moved;
+}
@@ -0,0 +1,47 @@
+#ifndef FLEETPLANNER_H
+#define FLEETPLANNER_H
+
+#include <vector>
+#include "threadpool.h"
+
+/*
+ * Fleet planner, splits the orders in a distance matrix across several vehicles that all leave from the hub (stop 0)
+ * Every vehicle can carry at most capacity orders. Routes are built with the Clarke-Wright savings heuristic and then
+ * improved with local search that runs on a thread pool, for a time budget or a fixed number of passes
+ */
+class FleetPlanner {
+public:
+    FleetPlanner(const std::vector<std::vector<int>>& distances, int vehicles, int capacity, int timeBudgetMs = 1000, int threads = 0,
+                 int maxPasses = 0);
+
+    std::vector<std::vector<int>> plan();
+    int routeLength(const std::vector<int>& route) const;
+
+private:
+    // a single stop being moved from one route to another by relocate
+    struct Move {
+        int gain;
+        int fromRoute;
+        int fromPosition;
+        int toRoute;
+        int toPosition;
+    };
+
+    std::vector<std::vector<int>> distances;
+    int stops;
+    int vehicles;
+    int capacity;
+    int timeBudgetMs;
+    int maxPasses;
+    ThreadPool pool;
+
+    int distance(int from, int to) const;
+
+    std::vector<std::vector<int>> savings();
+    void reduceRoutes(std::vector<std::vector<int>>& routes);
+    void optimizeRoutes(std::vector<std::vector<int>>& routes, const std::vector<bool>& changed, int timeBudgetMs);
+    Move findBestRelocate(const std::vector<std::vector<int>>& routes, int fromRoute);
+    bool relocate(std::vector<std::vector<int>>& routes, std::vector<bool>& changed);
+};
+
+#endif
@@ -0,0 +1,348 @@
+#include "hierarchicalrouter.h"
+#include "metrics.h"
+#include "directions.h"
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+#include <vector>
+
+// entrances at least this long get a crossing at both ends instead of one in the middle
+static const int LONG_ENTRANCE = 6;
+
+const int HierarchicalRouter::UNREACHABLE;
+
+/**
+ * Constructor, builds the abstract graph
+ * @param rows the amount of rows in the grid
+ * @param cols the amount of collumns in the grid
+ * @param passable (rows * cols + 63) / 64 words, bit i is set if cell i can be driven on
+ * @param clusterSize the width and height of a cluster in cells
+ */
+HierarchicalRouter::HierarchicalRouter(int rows, int cols, const uint64_t* passable, int clusterSize) {
+    METRICS_TIMER("hierarchical_router.build");
+    this->rows = rows;
+    this->cols = cols;
+    this->clusterSize = std::max(2, clusterSize);
+    clustersX = (cols + this->clusterSize - 1) / this->clusterSize;
+    clustersY = (rows + this->clusterSize - 1) / this->clusterSize;
+    this->passable = std::vector<uint64_t>(passable, passable + ((size_t)rows * cols + 63) / 64);
+    nodeOfCell = std::vector<int>(rows * cols, -1);
+    clusterNodes = std::vector<std::vector<int>>(clustersX * clustersY);
+    localDistances = std::vector<int>(this->clusterSize * this->clusterSize);
+    localParents = std::vector<uint8_t>(this->clusterSize * this->clusterSize);
+    std::vector<std::vector<std::pair<int, int>>> adjacency;
+
+    // entrances across every vertical border (left | right) and every horizontal border (above / below),
+    // one border piece per pair of neighbouring clusters
+    int size = this->clusterSize;
+    for (int x = size; x < cols; x += size) {
+        for (int y = 0; y < rows; y += size) {
+            addEntrances(y * cols + x - 1, y * cols + x, cols, std::min(size, rows - y), adjacency);
+        }
+    }
+    for (int y = size; y < rows; y += size) {
+        for (int x = 0; x < cols; x += size) {
+            addEntrances((y - 1) * cols + x, y * cols + x, 1, std::min(size, cols - x), adjacency);
+        }
+    }
+
+    // the distance between every two entrances of a cluster, searched without leaving the cluster
+    for (const std::vector<int>& nodes : clusterNodes) {
+        for (int node : nodes) {
+            searchCluster(nodeCells[node], -1);
+            for (int other : nodes) {
+                int cell = nodeCells[other];
+                int distance = localDistances[(cell / cols % size) * size + cell % cols % size];
+                if (other != node && distance < UNREACHABLE) {
+                    adjacency[node].push_back(std::make_pair(other, distance));
+                }
+            }
+        }
+    }
+
+    edgeStart.push_back(0);
+    for (const std::vector<std::pair<int, int>>& edges : adjacency) {
+        for (const std::pair<int, int>& edge : edges) {
+            edgeTargets.push_back(edge.first);
+            edgeCosts.push_back(edge.second);
+        }
+        edgeStart.push_back(edgeTargets.size());
+    }
+    abstractDistances = std::vector<int>(nodeCells.size() + 2, UNREACHABLE);
+    abstractParents = std::vector<int>(nodeCells.size() + 2, -1);
+    METRICS_COUNT("hierarchical_router.nodes", nodeCells.size());
+    METRICS_COUNT("hierarchical_router.edges", edgeTargets.size());
+}
+
+bool HierarchicalRouter::isPassable(int index) const {
+    return (passable[index >> 6] >> (index & 63)) & 1;
+}
+
+int HierarchicalRouter::clusterOf(int index) const {
+    return (index / cols / clusterSize) * clustersX + index % cols / clusterSize;
+}
+
+/**
+ * Find the entrances along one border piece, the runs where both sides of the border are road
+ * @param firstA the first cell on one side of the border
+ * @param firstB the cell across the border from it
+ * @param step how far apart two cells along the border are (1 along a row, cols along a collumn)
+ * @param length how many cells the border piece has
+ */
+void HierarchicalRouter::addEntrances(int firstA, int firstB, int step, int length, std::vector<std::vector<std::pair<int, int>>>& adjacency) {
+    int runStart = -1;
+    for (int i = 0; i <= length; i++) {
+        bool open = i < length && isPassable(firstA + i * step) && isPassable(firstB + i * step);
+        if (open && runStart == -1) {
+            runStart = i;
+        } else if (!open && runStart != -1) {
+            int runLength = i - runStart;
+            std::vector<int> crossings;
+            if (runLength >= LONG_ENTRANCE) {
+                crossings = {runStart, i - 1};
+            } else {
+                crossings = {runStart + runLength / 2};
+            }
+            for (int crossing : crossings) {
+                int a = addNode(firstA + crossing * step, adjacency);
+                int b = addNode(firstB + crossing * step, adjacency);
+                adjacency[a].push_back(std::make_pair(b, 1));
+                adjacency[b].push_back(std::make_pair(a, 1));
+            }
+            runStart = -1;
+        }
+    }
+}
+
+/**
+ * @return the node on a cell, made if the cell doesnt have one yet (corner cells can be on two borders)
+ */
+int HierarchicalRouter::addNode(int cell, std::vector<std::vector<std::pair<int, int>>>& adjacency) {
+    if (nodeOfCell[cell] == -1) {
+        nodeOfCell[cell] = nodeCells.size();
+        nodeCells.push_back(cell);
+        clusterNodes[clusterOf(cell)].push_back(nodeOfCell[cell]);
+        adjacency.emplace_back();
+    }
+    return nodeOfCell[cell];
+}
+
+/**
+ * Breadth first search that never leaves the cluster of the source, every step costs 1 so this is the shortest
+ * distance inside the cluster. The results are left in localDistances and localParents
+ * @param source the cell to search from
+ * @param target stop once this cell is reached, -1 to search the whole cluster
+ */
+void HierarchicalRouter::searchCluster(int source, int target) {
+    int size = clusterSize;
+    int originX = source % cols / size * size;
+    int originY = source / cols / size * size;
+    int width = std::min(size, cols - originX);
+    int height = std::min(size, rows - originY);
+    std::fill(localDistances.begin(), localDistances.end(), UNREACHABLE);
+
+    localQueue.clear();
+    localQueue.push_back(source);
+    localDistances[(source / cols - originY) * size + source % cols - originX] = 0;
+    for (int head = 0; head < localQueue.size(); head++) {
+        int index = localQueue[head];
+        if (index == target) {
+            return;
+        }
+        int x = index % cols;
+        int y = index / cols;
+        int distance = localDistances[(y - originY) * size + x - originX];
+        for (int direction = 0; direction < 4; direction++) {
+            int newX = x + DIRECTION_X[direction];
+            int newY = y + DIRECTION_Y[direction];
+            if (newX < originX || newX >= originX + width || newY < originY || newY >= originY + height) {
+                continue;
+            }
+            int local = (newY - originY) * size + newX - originX;
+            int newIndex = newY * cols + newX;
+            if (localDistances[local] == UNREACHABLE && isPassable(newIndex)) {
+                localDistances[local] = distance + 1;
+                localParents[local] = direction;
+                localQueue.push_back(newIndex);
+            }
+        }
+    }
+}
+
+/**
+ * A* on the abstract graph with the start and end linked to the entrances of their clusters
+ * @param start the start cell
+ * @param end the end cell
+ * @param distance set to the length of the route, UNREACHABLE if there is none
+ * @return the cells the route goes through in order, the start, the entrances used and the end
+ */
+std::vector<int> HierarchicalRouter::findAbstractPath(int start, int end, int& distance) {
+    int size = clusterSize;
+    int nodeCount = nodeCells.size();
+    int startId = nodeCount;
+    int endId = nodeCount + 1;
+    std::vector<int> cells;
+    distance = UNREACHABLE;
+    if (!isPassable(start) || !isPassable(end)) {
+        return cells;
+    }
+    for (int id : touched) {
+        abstractDistances[id] = UNREACHABLE;
+    }
+    touched.clear();
+    auto cellOf = [&](int id) {
+        return id == startId ? start : (id == endId ? end : nodeCells[id]);
+    };
+    auto heuristic = [&](int id) {
+        int cell = cellOf(id);
+        return std::abs(cell % cols - end % cols) + std::abs(cell / cols - end / cols);
+    };
+    std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>, std::greater<std::pair<int, int>>> pq;
+    auto relax = [&](int id, int newDistance, int parent) {
+        if (newDistance < abstractDistances[id]) {
+            if (abstractDistances[id] == UNREACHABLE) {
+                touched.push_back(id);
+            }
+            abstractDistances[id] = newDistance;
+            abstractParents[id] = parent;
+            pq.push(std::make_pair(newDistance + heuristic(id), id));
+        }
+    };
+
+    // links from the end to the entrances of its cluster, a route can only finish through one of them
+    int endCluster = clusterOf(end);
+    std::vector<std::pair<int, int>> endLinks;
+    searchCluster(end, -1);
+    for (int node : clusterNodes[endCluster]) {
+        int cell = nodeCells[node];
+        int local = localDistances[(cell / cols % size) * size + cell % cols % size];
+        if (local < UNREACHABLE) {
+            endLinks.push_back(std::make_pair(node, local));
+        }
+    }
+    // the start is linked to the entrances of its cluster, and straight to the end if they share a cluster
+    relax(startId, 0, -1);
+    searchCluster(start, -1);
+    if (clusterOf(start) == endCluster) {
+        int local = localDistances[(end / cols % size) * size + end % cols % size];
+        if (local < UNREACHABLE) {
+            relax(endId, local, startId);
+        }
+    }
+    for (int node : clusterNodes[clusterOf(start)]) {
+        int cell = nodeCells[node];
+        int local = localDistances[(cell / cols % size) * size + cell % cols % size];
+        if (local < UNREACHABLE) {
+            relax(node, local, startId);
+        }
+    }
+
+    long long popped = 0;
+    while (!pq.empty()) {
+        int estimate = pq.top().first;
+        int id = pq.top().second;
+        pq.pop();
+        if (estimate - heuristic(id) != abstractDistances[id]) {
+            continue;
+        }
+        popped++;
+        if (id == endId) {
+            break;
+        }
+        if (id == startId) {
+            continue;
+        }
+        for (int edge = edgeStart[id]; edge < edgeStart[id + 1]; edge++) {
+            relax(edgeTargets[edge], abstractDistances[id] + edgeCosts[edge], id);
+        }
+        if (clusterOf(nodeCells[id]) == endCluster) {
+            for (const std::pair<int, int>& link : endLinks) {
+                if (link.first == id) {
+                    relax(endId, abstractDistances[id] + link.second, id);
+                }
+            }
+        }
+    }
+    METRICS_COUNT("hierarchical_router.abstract_nodes_popped", popped);
+
+    distance = abstractDistances[endId];
+    if (distance >= UNREACHABLE) {
+        return cells;
+    }
+    for (int id = endId; id != -1; id = abstractParents[id]) {
+        cells.push_back(cellOf(id));
+    }
+    std::reverse(cells.begin(), cells.end());
+    return cells;
+}
+
+/**
+ * Length of the route between two cells, only the abstract graph is searched so no cells are reconstructed
+ * @return the length in steps, UNREACHABLE if there is no route
+ */
+int HierarchicalRouter::findDistance(int startX, int startY, int endX, int endY) {
+    METRICS_TIMER("hierarchical_router.find_distance");
+    int distance;
+    findAbstractPath(startY * cols + startX, endY * cols + endX, distance);
+    return distance;
+}
+
+/**
+ * Route between two cells, the abstract route refined into cells one cluster at a time
+ * @return the path as (x, y) pairs from start to end, empty if there is no route
+ */
+std::vector<std::pair<int, int>> HierarchicalRouter::findPath(int startX, int startY, int endX, int endY) {
+    METRICS_TIMER("hierarchical_router.find_path");
+    int distance;
+    std::vector<int> cells = findAbstractPath(startY * cols + startX, endY * cols + endX, distance);
+    std::vector<std::pair<int, int>> path;
+    if (cells.empty()) {
+        return path;
+    }
+    path.push_back(std::make_pair(startX, startY));
+    for (int i = 1; i < cells.size(); i++) {
+        appendClusterPath(cells[i - 1], cells[i], path);
+    }
+    return path;
+}
+
+/**
+ * Add the cells from one abstract step to the path, leaving out the first cell which is already on it.
+ * A step is either a crossing to the next cluster or a route inside a single cluster
+ */
+void HierarchicalRouter::appendClusterPath(int from, int to, std::vector<std::pair<int, int>>& path) {
+    if (from == to) {
+        return;
+    }
+    if (clusterOf(from) != clusterOf(to)) {
+        path.push_back(std::make_pair(to % cols, to / cols));
+        return;
+    }
+    int size = clusterSize;
+    int originX = from % cols / size * size;
+    int originY = from / cols / size * size;
+    searchCluster(from, to);
+    size_t first = path.size();
+    int x = to % cols;
+    int y = to / cols;
+    while (y * cols + x != from) {
+        path.push_back(std::make_pair(x, y));
+        int direction = localParents[(y - originY) * size + x - originX];
+        x -= DIRECTION_X[direction];
+        y -= DIRECTION_Y[direction];
+    }
+    std::reverse(path.begin() + first, path.end());
+}
+
+int HierarchicalRouter::getClusterCount() const {
+    return clustersX * clustersY;
+}
+
+int HierarchicalRouter::getNodeCount() const {
+    return nodeCells.size();
+}
+
+int HierarchicalRouter::getEdgeCount() const {
+    return edgeTargets.size();
+}
@@ -0,0 +1,66 @@
+#ifndef HIERARCHICALROUTER_H
+#define HIERARCHICALROUTER_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/*
+ * Hierarchical path finding (HPA*). The grid is cut into square blocks (clusters) and wherever a road crosses from
+ * one block into the next an entrance is made: a node on each side of the border. Inside every block the distances
+ * between its entrance nodes are searched once up front, which gives a small abstract graph of the whole city.
+ * A query connects the start and end to the entrances of their own blocks, runs A* on the abstract graph and then
+ * only searches inside the blocks the route actually passes through to turn it back into cells.
+ * Routes are close to the shortest but not always exactly it, only one or two crossings are kept per entrance.
+ * Coordinates are (x, y) like Dijkstra
+ */
+class HierarchicalRouter {
+public:
+    // distance reported for targets that cant be reached
+    static const int UNREACHABLE = INT32_MAX / 4;
+
+    HierarchicalRouter(int rows, int cols, const uint64_t* passable, int clusterSize = 16);
+
+    int findDistance(int startX, int startY, int endX, int endY);
+    std::vector<std::pair<int, int>> findPath(int startX, int startY, int endX, int endY);
+
+    int getClusterCount() const;
+    int getNodeCount() const;
+    int getEdgeCount() const;
+
+private:
+    int rows;
+    int cols;
+    int clusterSize;
+    int clustersX;
+    int clustersY;
+    std::vector<uint64_t> passable;
+
+    // the abstract graph: the cell of every entrance node, the nodes of every cluster and the edges in
+    // compressed rows (the edges of node i are edgeStart[i] up to edgeStart[i + 1])
+    std::vector<int> nodeCells;
+    std::vector<int> nodeOfCell;
+    std::vector<std::vector<int>> clusterNodes;
+    std::vector<int> edgeStart;
+    std::vector<int> edgeTargets;
+    std::vector<int> edgeCosts;
+
+    // scratch for the searches inside one cluster, indexed by the cell inside the cluster
+    std::vector<int> localDistances;
+    std::vector<uint8_t> localParents;
+    std::vector<int> localQueue;
+    // scratch for the abstract search, the start and end get the ids after the last node
+    std::vector<int> abstractDistances;
+    std::vector<int> abstractParents;
+    std::vector<int> touched;
+
+    bool isPassable(int index) const;
+    int clusterOf(int index) const;
+    void addEntrances(int firstA, int firstB, int step, int length, std::vector<std::vector<std::pair<int, int>>>& adjacency);
+    int addNode(int cell, std::vector<std::vector<std::pair<int, int>>>& adjacency);
+    void searchCluster(int source, int target);
+    std::vector<int> findAbstractPath(int start, int end, int& distance);
+    void appendClusterPath(int from, int to, std::vector<std::pair<int, int>>& path);
+};
+
+#endif
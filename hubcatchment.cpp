@@ -0,0 +1,110 @@
+#include "hubcatchment.h"
+#include <vector>
+
+/**
+ * Constructor for the catchment areas, runs the search from every hub at once so the whole grid is labeled in one
+ * linear pass. Ties go to whichever hub reached the cell first (the lower hub index on equal distances)
+ * @param grid the dijkstra grid, 0 is an obsticle and anything else can be driven on
+ * @param hubs the location of every hub
+ */
+HubCatchment::HubCatchment(const std::vector<std::vector<int>>& grid, const std::vector<std::pair<int,int>>& hubs) {
+    rows = grid.size();
+    cols = grid[0].size();
+    hubCount = hubs.size();
+    owner = std::vector<int>(rows * cols, -1);
+    distance = std::vector<int>(rows * cols, -1);
+
+    // the queue is a flat vector of cell indexes, every cell is pushed at most once so it never needs to grow
+    std::vector<int> queue;
+    queue.reserve(rows * cols);
+    for (int hub = 0; hub < hubs.size(); hub++) {
+        int index = hubs[hub].first * cols + hubs[hub].second;
+        if (owner[index] == -1) {
+            owner[index] = hub;
+            distance[index] = 0;
+            queue.push_back(index);
+        }
+    }
+
+    const int DIRECTION_ROW[4] = {-1, 1, 0, 0};
+    const int DIRECTION_COL[4] = {0, 0, 1, -1};
+    for (int head = 0; head < queue.size(); head++) {
+        int index = queue[head];
+        int row = index / cols;
+        int col = index % cols;
+        for (int direction = 0; direction < 4; direction++) {
+            int newRow = row + DIRECTION_ROW[direction];
+            int newCol = col + DIRECTION_COL[direction];
+            if (newRow < 0 || newRow >= rows || newCol < 0 || newCol >= cols || grid[newRow][newCol] == 0) {
+                continue;
+            }
+            int newIndex = newRow * cols + newCol;
+            // the first hub to reach a cell is the closest one, the whole frontier grows one step at a time
+            if (owner[newIndex] == -1) {
+                owner[newIndex] = owner[index];
+                distance[newIndex] = distance[index] + 1;
+                queue.push_back(newIndex);
+            }
+        }
+    }
+}
+
+/**
+ * @param coordinates the (row, col) of a cell
+ * @return the index of the closest hub, -1 if no hub can reach the cell
+ */
+int HubCatchment::getHub(std::pair<int,int> coordinates) const {
+    return owner[coordinates.first * cols + coordinates.second];
+}
+
+/**
+ * @param coordinates the (row, col) of a cell
+ * @return the amount of steps to the closest hub, -1 if no hub can reach the cell
+ */
+int HubCatchment::getDistance(std::pair<int,int> coordinates) const {
+    return distance[coordinates.first * cols + coordinates.second];
+}
+
+/**
+ * Find the closest hub for every house
+ * @param houses the house locations as (row, col) pairs
+ * @return the hub index of each house in the same order, -1 for houses no hub can reach
+ */
+std::vector<int> HubCatchment::assign(const std::vector<std::pair<int,int>>& houses) const {
+    std::vector<int> hubOfHouse;
+    for (std::pair<int,int> house : houses) {
+        hubOfHouse.push_back(getHub(house));
+    }
+    return hubOfHouse;
+}
+
+/**
+ * Group the houses by the hub they are closest to
+ * @param houses the house locations as (row, col) pairs
+ * @return one list of houses per hub, houses no hub can reach are left out
+ */
+std::vector<std::vector<std::pair<int,int>>> HubCatchment::partition(const std::vector<std::pair<int,int>>& houses) const {
+    std::vector<std::pair<int,int>> unassigned;
+    return partition(houses, unassigned);
+}
+
+/**
+ * Group the houses by the hub they are closest to
+ * @param houses the house locations as (row, col) pairs
+ * @param unassigned filled with the houses no hub can reach, so the caller can report them
+ * @return one list of houses per hub
+ */
+std::vector<std::vector<std::pair<int,int>>> HubCatchment::partition(const std::vector<std::pair<int,int>>& houses,
+                                                                     std::vector<std::pair<int,int>>& unassigned) const {
+    std::vector<std::vector<std::pair<int,int>>> groups(hubCount);
+    unassigned.clear();
+    for (std::pair<int,int> house : houses) {
+        int hub = getHub(house);
+        if (hub != -1) {
+            groups[hub].push_back(house);
+        } else {
+            unassigned.push_back(house);
+        }
+    }
+    return groups;
+}
@@ -0,0 +1,32 @@
+#ifndef HUBCATCHMENT_H
+#define HUBCATCHMENT_H
+
+#include <vector>
+#include <utility>
+
+/*
+ * Hub catchment areas, splits the road grid into one area per hub with a single multi source breadth first search
+ * every cell belongs to the hub it is the fewest steps away from (a voronoi diagram over the roads)
+ * coordinates are (row, col) pairs like the ones used by City and main
+ */
+class HubCatchment {
+public:
+    HubCatchment(const std::vector<std::vector<int>>& grid, const std::vector<std::pair<int,int>>& hubs);
+
+    int getHub(std::pair<int,int> coordinates) const;
+    int getDistance(std::pair<int,int> coordinates) const;
+    std::vector<int> assign(const std::vector<std::pair<int,int>>& houses) const;
+    std::vector<std::vector<std::pair<int,int>>> partition(const std::vector<std::pair<int,int>>& houses) const;
+    std::vector<std::vector<std::pair<int,int>>> partition(const std::vector<std::pair<int,int>>& houses,
+                                                           std::vector<std::pair<int,int>>& unassigned) const;
+
+private:
+    int rows;
+    int cols;
+    int hubCount;
+    // the index of the closest hub and the distance to it for every cell, -1 if no hub can reach the cell
+    std::vector<int> owner;
+    std::vector<int> distance;
+};
+
+#endif
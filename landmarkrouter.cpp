@@ -0,0 +1,251 @@
+#include "landmarkrouter.h"
+#include "metrics.h"
+#include "threadpool.h"
+#include "directions.h"
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <queue>
+#include <vector>
+
+const int LandmarkRouter::UNREACHABLE;
+const uint16_t LandmarkRouter::NO_PATH;
+
+/**
+ * Constructor, picks the landmarks and searches the distance tables from all of them at the same time
+ * @param rows the amount of rows in the grid
+ * @param cols the amount of collumns in the grid
+ * @param passable (rows * cols + 63) / 64 words, bit i is set if cell i can be driven on
+ * @param landmarkCount how many landmarks to use, more gives tighter bounds but 2 bytes more per cell each
+ * @param threads how many threads search the tables, 0 uses one per core
+ */
+LandmarkRouter::LandmarkRouter(int rows, int cols, const uint64_t* passable, int landmarkCount, int threads) {
+    METRICS_TIMER("landmark_router.build");
+    this->rows = rows;
+    this->cols = cols;
+    int cells = rows * cols;
+    this->passable = std::vector<uint64_t>(passable, passable + (cells + 63) / 64);
+    searchDistances = std::vector<int>(cells, UNREACHABLE);
+    parents = std::vector<uint8_t>(cells, 0);
+    closed = std::vector<uint64_t>((cells + 63) / 64, 0);
+
+    this->landmarkCount = std::max(1, landmarkCount);
+    selectLandmarks();
+    this->landmarkCount = landmarks.size();
+
+    // every search fills its own table so the threads never write to the same cache line, the tables are then
+    // interleaved so the landmarks of one cell sit together
+    std::vector<std::vector<uint16_t>> tables(landmarks.size());
+    {
+        ThreadPool pool(threads);
+        std::vector<std::future<void>> done;
+        for (int i = 0; i < landmarks.size(); i++) {
+            done.push_back(pool.submit([this, &tables, i]() { breadthFirstSearch(landmarks[i], tables[i]); }));
+        }
+        for (std::future<void>& search : done) {
+            search.get();
+        }
+    }
+    distances = std::vector<uint16_t>((size_t)cells * this->landmarkCount);
+    for (int cell = 0; cell < cells; cell++) {
+        for (int i = 0; i < this->landmarkCount; i++) {
+            distances[(size_t)cell * this->landmarkCount + i] = tables[i][cell];
+        }
+    }
+    METRICS_COUNT("landmark_router.table_bytes", distances.size() * sizeof(uint16_t));
+}
+
+bool LandmarkRouter::isPassable(int index) const {
+    return (passable[index >> 6] >> (index & 63)) & 1;
+}
+
+/**
+ * Farthest point selection: the first landmark is the road cell farthest from the middle of the map, every next
+ * one is the road cell farthest from all landmarks picked so far. Landmarks end up spread around the edge of the
+ * city, which is where they give the best bounds. Distances here are manhattan so the picks dont have to wait
+ * for the searches and those can all run at once
+ */
+void LandmarkRouter::selectLandmarks() {
+    std::vector<int> roads;
+    std::vector<int> nearest;
+    for (int cell = 0; cell < rows * cols; cell++) {
+        if (isPassable(cell)) {
+            roads.push_back(cell);
+            nearest.push_back(std::abs(cell % cols - cols / 2) + std::abs(cell / cols - rows / 2));
+        }
+    }
+    while (landmarks.size() < landmarkCount && !roads.empty()) {
+        int farthest = std::max_element(nearest.begin(), nearest.end()) - nearest.begin();
+        if (nearest[farthest] == 0 && !landmarks.empty()) {
+            break; // fewer road cells than landmarks
+        }
+        int landmark = roads[farthest];
+        landmarks.push_back(landmark);
+        for (int i = 0; i < roads.size(); i++) {
+            int distance = std::abs(roads[i] % cols - landmark % cols) + std::abs(roads[i] / cols - landmark / cols);
+            nearest[i] = landmarks.size() == 1 ? distance : std::min(nearest[i], distance);
+        }
+    }
+}
+
+/**
+ * Breadth first search from a landmark over the whole map, every step costs 1
+ * @param source the landmark cell
+ * @param table filled with the distance to every cell, NO_PATH where it cant be reached
+ */
+void LandmarkRouter::breadthFirstSearch(int source, std::vector<uint16_t>& table) const {
+    table.assign(rows * cols, NO_PATH);
+    std::vector<int> queue;
+    queue.reserve(rows * cols);
+    queue.push_back(source);
+    table[source] = 0;
+    for (int head = 0; head < queue.size(); head++) {
+        int index = queue[head];
+        int x = index % cols;
+        int y = index / cols;
+        // saturate instead of wrapping, a saturated distance still gives a valid (weaker) bound
+        uint16_t next = std::min(table[index] + 1, NO_PATH - 1);
+        for (int direction = 0; direction < 4; direction++) {
+            int newX = x + DIRECTION_X[direction];
+            int newY = y + DIRECTION_Y[direction];
+            if (newX < 0 || newX >= cols || newY < 0 || newY >= rows) {
+                continue;
+            }
+            int newIndex = newY * cols + newX;
+            if (table[newIndex] == NO_PATH && isPassable(newIndex)) {
+                table[newIndex] = next;
+                queue.push_back(newIndex);
+            }
+        }
+    }
+}
+
+/**
+ * The triangle inequality bound between two cells, the biggest |d(L, from) - d(L, to)| over all landmarks
+ * @return a distance that is never more than the real one, UNREACHABLE if a landmark proves they arent connected
+ */
+int LandmarkRouter::lowerBound(int from, int to) const {
+    const uint16_t* a = &distances[(size_t)from * landmarkCount];
+    const uint16_t* b = &distances[(size_t)to * landmarkCount];
+    int bound = 0;
+    for (int i = 0; i < landmarkCount; i++) {
+        if ((a[i] == NO_PATH) != (b[i] == NO_PATH)) {
+            return UNREACHABLE; // one is connected to the landmark and the other isnt
+        }
+        bound = std::max(bound, std::abs(a[i] - b[i]));
+    }
+    return bound;
+}
+
+/**
+ * A* from start to end with the landmark bound as the heuristic, leaves the result in searchDistances and parents
+ * @return true if the end was reached
+ */
+bool LandmarkRouter::search(int start, int end) {
+    for (int index : touched) {
+        searchDistances[index] = UNREACHABLE;
+        closed[index >> 6] &= ~((uint64_t)1 << (index & 63));
+    }
+    touched.clear();
+    if (!isPassable(start) || !isPassable(end) || lowerBound(start, end) >= UNREACHABLE) {
+        return false;
+    }
+    long long popped = 0;
+    long long pushes = 1;
+
+    // ((distance + bound, bound), cell), on equal estimates the cell closer to the end is expanded first
+    typedef std::pair<std::pair<int, int>, int> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> pq;
+    searchDistances[start] = 0;
+    touched.push_back(start);
+    int startBound = lowerBound(start, end);
+    pq.push(Entry(std::make_pair(startBound, startBound), start));
+
+    while (!pq.empty()) {
+        int index = pq.top().second;
+        pq.pop();
+        if ((closed[index >> 6] >> (index & 63)) & 1) {
+            continue;
+        }
+        closed[index >> 6] |= (uint64_t)1 << (index & 63);
+        popped++;
+        if (index == end) {
+            break;
+        }
+        int distance = searchDistances[index] + 1;
+        int x = index % cols;
+        int y = index / cols;
+        for (int direction = 0; direction < 4; direction++) {
+            int newX = x + DIRECTION_X[direction];
+            int newY = y + DIRECTION_Y[direction];
+            if (newX < 0 || newX >= cols || newY < 0 || newY >= rows) {
+                continue;
+            }
+            int newIndex = newY * cols + newX;
+            if (isPassable(newIndex) && distance < searchDistances[newIndex]) {
+                if (searchDistances[newIndex] == UNREACHABLE) {
+                    touched.push_back(newIndex);
+                }
+                searchDistances[newIndex] = distance;
+                parents[newIndex] = direction;
+                int bound = lowerBound(newIndex, end);
+                pq.push(Entry(std::make_pair(distance + bound, bound), newIndex));
+                pushes++;
+            }
+        }
+    }
+    METRICS_COUNT("landmark_router.nodes_popped", popped);
+    METRICS_COUNT("landmark_router.pushes", pushes);
+    return searchDistances[end] < UNREACHABLE;
+}
+
+/**
+ * Shortest path between two cells, the same length Dijkstra finds while expanding far fewer cells
+ * @return the path as (x, y) pairs from start to end, just the end if it cant be reached (like Dijkstra)
+ */
+std::vector<std::pair<int, int>> LandmarkRouter::findShortestPath(int startX, int startY, int endX, int endY) {
+    METRICS_TIMER("landmark_router.find_shortest_path");
+    int start = startY * cols + startX;
+    int end = endY * cols + endX;
+    std::vector<std::pair<int, int>> path;
+    path.push_back(std::make_pair(endX, endY));
+    if (!search(start, end)) {
+        return path;
+    }
+    int index = end;
+    while (index != start) {
+        int direction = parents[index];
+        index -= DIRECTION_Y[direction] * cols + DIRECTION_X[direction];
+        path.push_back(std::make_pair(index % cols, index / cols));
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+/**
+ * @return the length of the shortest path in steps, UNREACHABLE if there is none
+ */
+int LandmarkRouter::findDistance(int startX, int startY, int endX, int endY) {
+    METRICS_TIMER("landmark_router.find_distance");
+    int end = endY * cols + endX;
+    return search(startY * cols + startX, end) ? searchDistances[end] : UNREACHABLE;
+}
+
+/**
+ * The landmark lower bound between two cells without searching, useful to prune candidates before routing them
+ */
+int LandmarkRouter::getLowerBound(int startX, int startY, int endX, int endY) const {
+    return lowerBound(startY * cols + startX, endY * cols + endX);
+}
+
+/**
+ * @return the landmarks as (x, y) pairs
+ */
+std::vector<std::pair<int, int>> LandmarkRouter::getLandmarks() const {
+    std::vector<std::pair<int, int>> locations;
+    for (int landmark : landmarks) {
+        locations.push_back(std::make_pair(landmark % cols, landmark / cols));
+    }
+    return locations;
+}
@@ -0,0 +1,52 @@
+#ifndef LANDMARKROUTER_H
+#define LANDMARKROUTER_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/*
+ * Goal directed routing with ALT (A*, Landmarks and the Triangle inequality). A few landmarks are picked far apart
+ * on the road network and the distance from every landmark to every cell is found up front. For any two cells
+ * |d(L, a) - d(L, b)| can never be more than d(a, b), so the biggest of these over all landmarks is a lower bound
+ * that A* can use, and it is much tighter than the manhattan distance once roads wind around blocks.
+ * Distances are stored as 16 bits per cell per landmark, all landmarks of a cell next to each other so one bound
+ * reads a single cache line. Coordinates are (x, y) like Dijkstra
+ */
+class LandmarkRouter {
+public:
+    // distance reported for targets that cant be reached
+    static const int UNREACHABLE = INT32_MAX / 4;
+
+    LandmarkRouter(int rows, int cols, const uint64_t* passable, int landmarkCount = 8, int threads = 0);
+
+    std::vector<std::pair<int, int>> findShortestPath(int startX, int startY, int endX, int endY);
+    int findDistance(int startX, int startY, int endX, int endY);
+    int getLowerBound(int startX, int startY, int endX, int endY) const;
+    std::vector<std::pair<int, int>> getLandmarks() const;
+
+private:
+    // table value for a cell a landmark cant reach, distances too long to store are saturated just below it
+    static const uint16_t NO_PATH = 0xffff;
+
+    int rows;
+    int cols;
+    int landmarkCount;
+    std::vector<uint64_t> passable;
+    std::vector<int> landmarks;
+    // distances[cell * landmarkCount + landmark]
+    std::vector<uint16_t> distances;
+
+    std::vector<int> searchDistances;
+    std::vector<uint8_t> parents;
+    std::vector<uint64_t> closed;
+    std::vector<int> touched;
+
+    bool isPassable(int index) const;
+    void selectLandmarks();
+    void breadthFirstSearch(int source, std::vector<uint16_t>& table) const;
+    int lowerBound(int from, int to) const;
+    bool search(int start, int end);
+};
+
+#endif
@@ -8,205 +8,821 @@
 #include <string>
 #include <sstream>
 #include <algorithm>
-#include "bucketsort.h"
+#include <cmath>
+#include <future>
+#include <atomic>
+#include <map>
+#include <thread>
 #include "City.h"
 #include "quadtree.h"
 #include "dijkstra.h"
+#include "routeoptimizer.h"
+#include "fleetplanner.h"
+#include "threadpool.h"
+#include "boundedqueue.h"
+#include "hubcatchment.h"
+#include "orderclusterer.h"
+#include "ordersampler.h"
+#include "metrics.h"
+#include "mapreader.h"
+#include "citysession.h"
+#include "routingserver.h"
+#include "snapshot.h"
+#include "tiledgrid.h"
+#include "tiledrouter.h"
+#include "shardedrouter.h"
+#include "simulation.h"
 
 /**
- * Find the original index of the lowest value in numbers by comparing it to the unsorted vector
- * @param numbers
- * @return the lowest index
+ * Weight every house by how close it is to a handful of random hotspots, so orders bunch up the way they do around
+ * busy neighborhoods. A house right on a hotspot weighs 1 and the weight falls off exponentially with distance
+ * @param gen the random number generator
+ * @param cityMap the cityMap for its size
+ * @param houses a vector of every house on the cityMap and its coordinates
+ * @param hotspots how many hotspots to place
+ * @return one weight per house
  */
-int findLowestIndex(std::vector<int> sortedNumbers, std::vector<int> unsortedNumbers) {
-    int min = sortedNumbers[0];
-    for (int index = 0; index < unsortedNumbers.size(); index++) {
-        if (unsortedNumbers[index] == min) {
-            return index;
+std::vector<double> generateHotspotWeights(std::mt19937& gen, City& cityMap, std::vector<Point>& houses, int hotspots) {
+    OrderSampler sampler(houses.size());
+    std::vector<int> centers = sampler.sample(gen, hotspots);
+    double spread = std::max(cityMap.getMaxRows(), cityMap.getMaxCols()) / 16.0 + 1.0;
+
+    std::vector<double> weights;
+    for (const Point& house : houses) {
+        float closest = cityMap.getMaxRows() + cityMap.getMaxCols();
+        for (int center : centers) {
+            closest = std::min(closest, std::abs(house.x - houses[center].x) + std::abs(house.y - houses[center].y));
         }
+        weights.push_back(std::exp(-closest / spread));
+    }
+    return weights;
+}
+
+/**
+ * Generate deliveries (house locations) to deliver to given a rng, citymap, and all houses
+ * houses are picked without replacement so every delivery goes to a different house
+ * @param gen the random number generator
+ * @param cityMap the cityMap for random number generation
+ * @param houses a vector of every house on the cityMap and its coordinates
+ * @param orders how many deliveries to make, 0 picks a random amount from 2 - 7
+ * @param hotspots how many hotspots orders cluster around, 0 picks houses uniformly
+ * @return the locations of the houses to deliver to
+ */
+std::vector<std::pair<int,int>> generateDeliveries(std::mt19937& gen, City& cityMap, std::vector<Point>& houses, int orders, int hotspots) {
+    int MAX_ORDERS = 7;
+    int MIN_ORDERS = 2;
+
+    // generate a random number of deliveries from 2 - 7 if no amount was asked for
+    int deliveries = orders;
+    if (deliveries == 0) {
+        deliveries = cityMap.generateRandomNumber(gen,MIN_ORDERS,MAX_ORDERS);
+    }
+
+    OrderSampler sampler(houses.size());
+    std::vector<int> picked;
+    if (hotspots > 0) {
+        picked = sampler.sampleWeighted(gen, deliveries, generateHotspotWeights(gen, cityMap, houses, hotspots));
+    } else {
+        picked = sampler.sample(gen, deliveries);
+    }
+
+    // push the coordinates of every picked house to the list (the coordinates are flipped to be usable)
+    std::vector<std::pair<int,int>> houseCoordinates;
+    for (int house : picked) {
+        houseCoordinates.push_back(std::make_pair((int)houses[house].y, (int)houses[house].x));
+    }
+    return houseCoordinates;
+}
+
+/**
+ * Find the path distances from the start of a search to all of its targets. This helps in finding the shortest
+ * @param tree the search from the start with the targets
+ * @return the amount of cells on the path to every target, Dijkstra::UNREACHABLE for a target that cant be driven to
+ */
+std::vector<int> findPathDistances(const SearchTree& tree) {
+    std::vector<int> pathLengths;
+    for (int steps : tree.getDistances()) {
+        // the cell count is one more than the steps. a target that cant be driven to keeps the sentinel so it is
+        // never the cheap choice (the catchment in deliverOrders already takes those orders out)
+        pathLengths.push_back(steps == Dijkstra::UNREACHABLE ? Dijkstra::UNREACHABLE : steps + 1);
     }
-    return -1; // this should never run as it will break the program. Both vectors should contain all the same numbers
+    return pathLengths;
 }
 
 /**
- * Simple contains method as C++11 doesnt have one for vectors
- * @param numbers
- * @param searchNum
- * @return
+ * Write out every leg of a single vehicles route, one path block per order
+ * @param legs the path of every leg in the order they are driven
+ * @param orderBuffer the human readable summary of every order
+ * @param buffer the path output, one block per order
  */
-bool contains(std::vector<int>& numbers, int searchNum) {
-    for (int element : numbers) {
-        if (element == searchNum) {
-            return true;
+void writeRoute(const std::vector<CompactPath>& legs, std::stringstream& orderBuffer, std::stringstream& buffer) {
+    int totalLength = 0;
+    for (int leg = 0; leg < legs.size(); leg++) {
+        const CompactPath& paths = legs[leg];
+        totalLength += paths.size();
+
+        // print out the delivery in a nice to read format to be able to verify with the outputPath file
+        orderBuffer << "Order " << leg + 1 << "\n" << "Start location: (" << paths.front().second << "," << paths.front().first << ")\nEnd location: (" << paths.back().second << "," << paths.back().first << ")" << std::endl;
+        orderBuffer << "Path length: " << paths.size() << "\n" << std::endl;
+
+        // Loop over the cells of the path and write each pair to the file, they are worked out from the runs as we go
+        for (const std::pair<int, int>& p : paths) {
+            buffer << p.first << " " << p.second << std::endl;
         }
+        buffer << std::endl;
     }
-    return false;
+    orderBuffer << "Total path length: " << totalLength << std::endl;
 }
 
 /**
- * Find the coordinates of a house given the house number and the vector of all house points made from the quadtree
- * @param houseNumber house you would like to find
- * @param houses vector of house locations as points
- * @return the location as a pair
+ * Search from every stop to every other stop, one search per stop. Every search keeps its tree so the legs of the
+ * route can be taken out of them once it is planned instead of searched again. The searches are spread over a
+ * thread pool since fleets can have thousands of stops
+ * @param stops the stop locations as pairs
+ * @param grid the dijkstra grid
+ * @param threads how many threads to search with
+ * @return one search per stop, trees[i].getDistance(j) is the amount of steps from stop i to stop j
  */
-std::pair<int,int> findCoordinates(int houseNumber, std::vector<Point>& houses) {
-    for (const Point point : houses) {
-        if (point.c == std::to_string(houseNumber)) {
-            return std::make_pair(point.y, point.x);
+std::vector<SearchTree> findStopTrees(std::vector<std::pair<int,int>>& stops, const std::vector<std::vector<int>>& grid, int threads) {
+    // dijkstra takes (x, y) so flip the stops once
+    std::vector<std::pair<int,int>> targets;
+    for (std::pair<int,int> stop : stops) {
+        targets.push_back(std::make_pair(stop.second, stop.first));
+    }
+
+    std::vector<SearchTree> trees(stops.size());
+    ThreadPool pool(threads);
+    std::vector<std::future<void>> results;
+    for (int worker = 0; worker < pool.size(); worker++) {
+        results.push_back(pool.submit([&, worker]() {
+            Dijkstra dijkstra(grid);
+            for (int i = worker; i < targets.size(); i += pool.size()) {
+                trees[i] = dijkstra.findSearchTree(targets[i].first, targets[i].second, targets);
+            }
+        }));
+    }
+    for (auto& result : results) {
+        result.get();
+    }
+    return trees;
+}
+
+/**
+ * Plan the route for a single vehicle that visits every house starting from the hub, then write out every leg
+ * @param hub the hub location as a pair
+ * @param houseLocations all house locations to deliver to as a vector of pairs
+ * @param grid the dijkstra grid
+ * @param threads how many threads to search with
+ * @param orderBuffer the human readable summary of every order
+ * @param buffer the path output, one block per order
+ */
+void planSingleRoute(std::pair<int,int> hub, std::vector<std::pair<int,int>>& houseLocations, const std::vector<std::vector<int>>& grid,
+                     int threads, std::stringstream& orderBuffer, std::stringstream& buffer) {
+    // now that we have our houses to deliver to find the distance between every pair of stops
+    // stop 0 is the hub and stops 1 -> n are the houses
+    std::vector<std::pair<int,int>> stops;
+    stops.push_back(hub);
+    stops.insert(stops.end(), houseLocations.begin(), houseLocations.end());
+    std::vector<SearchTree> trees = findStopTrees(stops, grid, threads);
+    std::vector<std::vector<int>> stopDistances;
+    for (const SearchTree& tree : trees) {
+        stopDistances.push_back(findPathDistances(tree));
+    }
+
+    // find the best order to visit every house in, starting at the hub
+    RouteOptimizer optimizer(stopDistances);
+    std::vector<int> route = optimizer.solve();
+
+    // drive every leg of the route in order, each leg is walked out of the search that was made from its first stop
+    std::vector<CompactPath> legs;
+    for (int leg = 1; leg < route.size(); leg++) {
+        std::pair<int,int> to = stops[route[leg]];
+        legs.push_back(trees[route[leg - 1]].getPath(to.second, to.first));
+    }
+    writeRoute(legs, orderBuffer, buffer);
+}
+
+/**
+ * Split the houses across several vehicles that all leave from the hub and write out one path block per vehicle
+ * @param hub the hub location as a pair
+ * @param houseLocations all house locations to deliver to as a vector of pairs
+ * @param grid the dijkstra grid
+ * @param vehicles how many vehicles there are
+ * @param capacity how many orders a vehicle can carry, 0 spreads the orders evenly
+ * @param threads how many threads to search and improve the routes with
+ * @param orderBuffer the human readable summary of every vehicle
+ * @param buffer the path output, one block per vehicle
+ * @return false if the fleet cant carry every order
+ */
+bool planFleet(std::pair<int,int> hub, std::vector<std::pair<int,int>>& houseLocations, const std::vector<std::vector<int>>& grid,
+               int vehicles, int capacity, int threads, std::stringstream& orderBuffer, std::stringstream& buffer) {
+    std::vector<std::pair<int,int>> stops;
+    stops.push_back(hub);
+    stops.insert(stops.end(), houseLocations.begin(), houseLocations.end());
+
+    // with no capacity given every vehicle can take an even share of the orders
+    if (capacity == 0) {
+        capacity = std::max(1, ((int)houseLocations.size() + vehicles - 1) / vehicles);
+    }
+    if ((long long)vehicles * capacity < houseLocations.size()) {
+        std::cerr << "Not enough capacity: " << vehicles << " vehicles of capacity " << capacity << " cant carry "
+                  << houseLocations.size() << " orders." << std::endl;
+        return false;
+    }
+
+    std::vector<SearchTree> trees = findStopTrees(stops, grid, threads);
+    std::vector<std::vector<int>> distances;
+    for (const SearchTree& tree : trees) {
+        distances.push_back(tree.getDistances());
+    }
+    FleetPlanner planner(distances, vehicles, capacity, 1000, threads);
+    std::vector<std::vector<int>> routes = planner.plan();
+
+    // drive every leg of every vehicles route, consecutive legs share their end point so it is only written once.
+    // the legs are walked out of the searches the distances came from so nothing is searched again
+    int totalLength = 0;
+    for (int vehicle = 0; vehicle < routes.size(); vehicle++) {
+        const std::vector<int>& route = routes[vehicle];
+        int vehicleLength = 1;
+        buffer << stops[0].second << " " << stops[0].first << std::endl;
+        for (int leg = 1; leg < route.size(); leg++) {
+            std::pair<int,int> to = stops[route[leg]];
+            CompactPath paths = trees[route[leg - 1]].getPath(to.second, to.first);
+            vehicleLength += paths.size() - 1;
+            for (auto cell = ++paths.begin(); cell != paths.end(); ++cell) {
+                buffer << cell->first << " " << cell->second << std::endl;
+            }
         }
+        buffer << std::endl;
+        totalLength += vehicleLength;
+
+        orderBuffer << "Vehicle " << vehicle + 1 << "\n" << "Orders: " << route.size() - 1 << "\nPath length: " << vehicleLength << "\n" << std::endl;
     }
-    std::cerr << "Invalid coordinate generated." << std::endl;
-    return std::make_pair(-1,-1); // this should break the program but should also never run
+    orderBuffer << "Total path length: " << totalLength << std::endl;
+    return true;
 }
 
 /**
- * Generate a random amount of deliveries (house locations) to deliver to given a rng, citymap, and all houses
+ * Split the houses into clusters of nearby orders and send one trip from the hub to every cluster, each trip is
+ * planned on its own and the trips are planned in parallel. A trip searches from the hub and from each of its orders
+ * and every search stops once it has reached the other stops of that trip, so the stop matrices stay maxOrders + 1
+ * wide however many orders there are. The searches from the hub are repeated once per trip. main keeps maxOrders at
+ * most RouteOptimizer::HELD_KARP_LIMIT so every trip is ordered exactly. Writes one path block per trip
+ * @param hub the hub location as a pair
+ * @param houseLocations all house locations to deliver to as a vector of pairs
+ * @param grid the dijkstra grid
+ * @param maxOrders the most orders a single trip delivers
+ * @param threads how many threads to plan the trips with
+ * @param orderBuffer the human readable summary of every trip
+ * @param buffer the path output, one block per trip
+ */
+void planClusters(std::pair<int,int> hub, std::vector<std::pair<int,int>>& houseLocations, const std::vector<std::vector<int>>& grid,
+                  int maxOrders, int threads, std::stringstream& orderBuffer, std::stringstream& buffer) {
+    OrderClusterer clusterer(grid.size(), grid[0].size(), maxOrders);
+    std::vector<std::vector<std::pair<int,int>>> clusters = clusterer.cluster(houseLocations);
+
+    // every worker searches its share of the clusters with its own dijkstra, like findStopTrees
+    std::vector<std::vector<CompactPath>> trips(clusters.size());
+    ThreadPool pool(threads);
+    std::vector<std::future<void>> results;
+    for (int worker = 0; worker < pool.size(); worker++) {
+        results.push_back(pool.submit([&, worker]() {
+            Dijkstra dijkstra(grid);
+            for (int trip = worker; trip < clusters.size(); trip += pool.size()) {
+                // stop 0 is the hub, dijkstra takes (x, y)
+                std::vector<std::pair<int,int>> targets(1, std::make_pair(hub.second, hub.first));
+                for (std::pair<int,int> house : clusters[trip]) {
+                    targets.push_back(std::make_pair(house.second, house.first));
+                }
+                std::vector<SearchTree> trees;
+                std::vector<std::vector<int>> stopDistances;
+                for (std::pair<int,int> from : targets) {
+                    trees.push_back(dijkstra.findSearchTree(from.first, from.second, targets));
+                    stopDistances.push_back(findPathDistances(trees.back()));
+                }
+                RouteOptimizer optimizer(stopDistances);
+                std::vector<int> route = optimizer.solve();
+                for (int leg = 1; leg < route.size(); leg++) {
+                    std::pair<int,int> to = targets[route[leg]];
+                    trips[trip].push_back(trees[route[leg - 1]].getPath(to.first, to.second));
+                }
+            }
+        }));
+    }
+    for (auto& result : results) {
+        result.get();
+    }
+
+    // one block per trip like planFleet, consecutive legs share their end point so it is only written once
+    int totalLength = 0;
+    for (int trip = 0; trip < trips.size(); trip++) {
+        int tripLength = 1;
+        buffer << hub.second << " " << hub.first << std::endl;
+        for (const CompactPath& paths : trips[trip]) {
+            tripLength += paths.size() - 1;
+            for (auto cell = ++paths.begin(); cell != paths.end(); ++cell) {
+                buffer << cell->first << " " << cell->second << std::endl;
+            }
+        }
+        buffer << std::endl;
+        totalLength += tripLength;
+
+        orderBuffer << "Trip " << trip + 1 << "\n" << "Orders: " << clusters[trip].size() << "\nPath length: " << tripLength << "\n" << std::endl;
+    }
+    orderBuffer << "Total path length: " << totalLength << std::endl;
+}
+
+/**
+ * Pick houses to deliver to from a tiled map without listing every house, a tile at a time so each tile is read once
+ * and only the picked houses are kept (reservoir sampling)
  * @param gen the random number generator
- * @param cityMap the cityMap for totalHouses and random number generation
- * @param houses a vector of every house on the cityMap and its coordinates
- * @return
+ * @param cityMap the city, generated into tiles
+ * @param orders how many deliveries to make, 0 picks a random amount from 2 - 7
+ * @return the locations of the houses to deliver to as (row, col) pairs
  */
-std::vector<std::pair<int,int>> generateDeliveries(std::mt19937& gen, City& cityMap, std::vector<Point>& houses) {
-    int MAX_ORDERS = 7;
-    int MIN_ORDERS = 2;
-    std::vector<std::pair<int,int>> houseCoordinates;
-    std::vector<int> pickedHouses;
-
-    // generate a random number of deliveries from 2 - 7
-    int deliveries = cityMap.generateRandomNumber(gen,MIN_ORDERS,MAX_ORDERS);
-
-    // for as many deliveries generated find houses to deliver to
-    for (int i = 0; i < deliveries; i++) {
-        // generate a random house number that exists
-        int randomHouse = cityMap.generateRandomNumber(gen,1,cityMap.getHouseCount());
-        // if this house is already set for a delivery find another one
-        while (contains(pickedHouses, randomHouse)) {
-            randomHouse = cityMap.generateRandomNumber(gen,1,cityMap.getHouseCount());
+std::vector<std::pair<int,int>> sampleTiledDeliveries(std::mt19937& gen, City& cityMap, int orders) {
+    int deliveries = orders == 0 ? cityMap.generateRandomNumber(gen, 2, 7) : orders;
+    TiledGrid& grid = cityMap.getGrid();
+    std::vector<std::pair<int,int>> picked;
+    long long seen = 0;
+    for (int tileRow = 0; tileRow < grid.getRows(); tileRow += TiledGrid::TILE_SIZE) {
+        for (int tileCol = 0; tileCol < grid.getCols(); tileCol += TiledGrid::TILE_SIZE) {
+            for (int row = tileRow; row < std::min(tileRow + TiledGrid::TILE_SIZE, grid.getRows()); row++) {
+                for (int col = tileCol; col < std::min(tileCol + TiledGrid::TILE_SIZE, grid.getCols()); col++) {
+                    if (grid.get(row, col) <= 0) {
+                        continue;
+                    }
+                    // the first houses fill the picks, after that house n replaces a pick with chance deliveries / n
+                    seen++;
+                    if (picked.size() < deliveries) {
+                        picked.push_back(std::make_pair(row, col));
+                    } else {
+                        std::uniform_int_distribution<long long> slot(0, seen - 1);
+                        long long replace = slot(gen);
+                        if (replace < deliveries) {
+                            picked[replace] = std::make_pair(row, col);
+                        }
+                    }
+                }
+            }
         }
-        pickedHouses.push_back(randomHouse);
-        // find the coordinates of the picked house and push them to the list (the coordinates are flipped to be usable)
-        houseCoordinates.push_back(findCoordinates(randomHouse, houses));
     }
-    return houseCoordinates;
+    return picked;
 }
 
 /**
- * Find the path distances from the start to all houseLocations passed as a vector of pairs. This helps in finding the shortest
- * @param start starting location as pair
- * @param houseLocations all house locations as vector of pairs
+ * Generate a city into a tile file and deliver to a few of its houses from the hub, everything goes through the
+ * tile cache so the map can be bigger than memory. Writes map.txt and outputPath.txt like a normal run
+ * @param gen the random number generator
+ * @param size the size of the city, see City
+ * @param tiles where to make the tile file
+ * @param tileCache the most tiles kept in memory at once
+ * @param orders how many deliveries to make, 0 picks a random amount from 2 - 7
+ * @return the exit code for main
+ */
+int deliverTiled(std::mt19937& gen, int size, const std::string& tiles, size_t tileCache, int orders) {
+    City cityMap(size, 1, gen(), tiles, tileCache);
+    TiledGrid& grid = cityMap.getGrid();
+    if (!grid.isFileBacked()) {
+        return 1;
+    }
+
+    std::vector<std::pair<int,int>> houseLocations;
+    {
+        METRICS_TIMER("orders.generate");
+        houseLocations = sampleTiledDeliveries(gen, cityMap, orders);
+    }
+    METRICS_COUNT("orders.count", houseLocations.size());
+
+    std::ofstream outfile("outputPath.txt");
+    if (!outfile) {
+        std::cerr << "Error opening file." << std::endl;
+        return 1;
+    }
+
+    // the same as planSingleRoute, but every search reads the map through the tile cache
+    std::stringstream buffer;
+    std::stringstream orderBuffer;
+    {
+        METRICS_TIMER("routes.plan");
+        std::vector<std::pair<int,int>> stops;
+        stops.push_back(cityMap.getHubLocation());
+        stops.insert(stops.end(), houseLocations.begin(), houseLocations.end());
+        TiledRouter router(grid);
+        // routers take (x, y)
+        std::vector<std::pair<int,int>> targets;
+        for (std::pair<int,int> stop : stops) {
+            targets.push_back(std::make_pair(stop.second, stop.first));
+        }
+
+        // the search from the hub shows which houses can be driven to at all, roads go both ways so those can also
+        // reach each other. the rest are left out with a warning like the catchment in deliverOrders does
+        std::vector<int> hubDistances;
+        std::vector<CompactPath> hubPaths = router.findShortestPaths(targets[0].first, targets[0].second, targets, hubDistances);
+        std::vector<int> reachable;
+        std::vector<std::pair<int,int>> unassigned;
+        for (int stop = 0; stop < stops.size(); stop++) {
+            if (hubDistances[stop] != TiledRouter::UNREACHABLE) {
+                reachable.push_back(stop);
+            } else {
+                unassigned.push_back(stops[stop]);
+            }
+        }
+        if (!unassigned.empty()) {
+            std::cerr << "Warning: " << unassigned.size() << " orders cant be reached from the hub and are not delivered:";
+            for (std::pair<int,int> house : unassigned) {
+                std::cerr << " (" << house.first << "," << house.second << ")";
+            }
+            std::cerr << std::endl;
+        }
+        METRICS_COUNT("hubs.unassigned_orders", unassigned.size());
+
+        // one search per stop reaches every other stop, the paths it found are kept so the legs dont search again
+        std::vector<std::pair<int,int>> reachableTargets;
+        for (int stop : reachable) {
+            reachableTargets.push_back(targets[stop]);
+        }
+        std::vector<std::vector<CompactPath>> paths(reachable.size());
+        std::vector<std::vector<int>> stopDistances(reachable.size(), std::vector<int>(reachable.size()));
+        for (int i = 0; i < reachable.size(); i++) {
+            std::vector<int> distances;
+            if (i == 0) {
+                for (int stop : reachable) {
+                    paths[i].push_back(hubPaths[stop]);
+                    distances.push_back(hubDistances[stop]);
+                }
+            } else {
+                paths[i] = router.findShortestPaths(reachableTargets[i].first, reachableTargets[i].second, reachableTargets, distances);
+            }
+            for (int j = 0; j < reachable.size(); j++) {
+                // the cell count is one more than the steps, like findPathDistances
+                stopDistances[i][j] = distances[j] == TiledRouter::UNREACHABLE ? TiledRouter::UNREACHABLE : distances[j] + 1;
+            }
+        }
+
+        RouteOptimizer optimizer(stopDistances);
+        std::vector<int> route = optimizer.solve();
+        std::vector<CompactPath> legs;
+        for (int leg = 1; leg < route.size(); leg++) {
+            legs.push_back(paths[route[leg - 1]][route[leg]]);
+        }
+        writeRoute(legs, orderBuffer, buffer);
+    }
+    std::cout << orderBuffer.str();
+    outfile << buffer.str();
+    METRICS_COUNT("tiled_grid.resident_tiles", grid.getResidentTiles());
+    return 0;
+}
+
+/**
+ * Run the routing server on a prepared session until it is told to stop
+ * @param session the session to answer queries about
+ * @param serve "stdin" to read queries from standard input, otherwise the path of the unix socket to listen on
+ * @param shards cut the map into shards * shards regions with a worker process each for routing, 0 to route in here
+ * @return the exit code for main
+ */
+int serveQueries(CitySession& session, const std::string& serve, int shards) {
+    // the workers are forked before anything else starts so they only copy the map
+    std::unique_ptr<ShardedRouter> sharded;
+    if (shards > 0) {
+        sharded.reset(new ShardedRouter(session.getHeight(), session.getWidth(), session.getSnapshot().getPassable(), shards, shards));
+    }
+    RoutingServer server(session, sharded.get());
+    if (serve == "stdin") {
+        server.serve(std::cin, std::cout);
+        return 0;
+    }
+    return server.serveSocket(serve) ? 0 : 1;
+}
+
+// one hubs orders on their way to a planner
+struct HubJob {
+    int hub = 0;
+    std::vector<std::pair<int,int>> orders;
+};
+
+// one hubs routes on their way to the writer, as the text for stdout and outputPath.txt
+struct HubOutput {
+    int hub = 0;
+    bool planned = false;
+    std::string orders;
+    std::string paths;
+};
+
+/**
+ * Generate the orders and deliver them as a pipeline of three stages joined by bounded lock free queues. A source
+ * thread generates the orders and hands them out a hub at a time, planner threads each plan the routes of one hub,
+ * and this thread writes every hub out as soon as it and all the hubs before it are planned. The output streams
+ * while later hubs are still being planned and comes out in the same order as planning them one after another.
+ * A single hub has nothing to overlap so it skips the pipeline and is planned and written on this thread
+ * @param gen the random number generator
+ * @param cityMap the city, for its hubs and random numbers
+ * @param houses every house on the map
  * @param grid the dijkstra grid
- * @return
+ * @param orders how many deliveries to make, 0 picks a random amount from 2 - 7
+ * @param hotspots how many hotspots orders cluster around, 0 picks houses uniformly
+ * @param vehicles how many vehicles leave each hub
+ * @param capacity how many orders a vehicle can carry, 0 spreads the orders evenly
+ * @param clusterSize 0 plans every hub as a whole, otherwise the most orders in a trip of planClusters
+ * @param outfile where the paths go
+ * @return the exit code for main, 1 if a hub cant be served (the hubs before it are already written)
  */
-std::vector<int> findPathDistances(std::pair<int,int> start, std::vector<std::pair<int,int>> houseLocations, std::vector<std::vector<int>>& grid) {
-    std::vector<int> pathLengths;
-    for (std::pair<int,int> houseLocation : houseLocations) {
-        Dijkstra dijkstra(grid);
-        std::vector<std::pair<int, int>> paths = dijkstra.findShortestPath(start.second,start.first, houseLocation.second, houseLocation.first);
-        pathLengths.push_back((int)paths.size());
+int deliverOrders(std::mt19937& gen, City& cityMap, std::vector<Point>& houses, const std::vector<std::vector<int>>& grid,
+                  int orders, int hotspots, int vehicles, int capacity, int clusterSize, std::ofstream& outfile) {
+    // a few hubs waiting in each queue keeps the next stage busy, more would only hold finished output back
+    const int PIPELINE_DEPTH = 4;
+    std::vector<std::pair<int,int>> hubLocations = cityMap.getHubLocations();
+
+    // generate the deliveries and split them between the hubs, every order goes out from the hub closest to it
+    auto assignOrders = [&]() {
+        std::vector<std::pair<int,int>> houseLocations;
+        {
+            METRICS_TIMER("orders.generate");
+            houseLocations = generateDeliveries(gen, cityMap, houses, orders, hotspots);
+        }
+        METRICS_COUNT("orders.count", houseLocations.size());
+
+        // even a single hub goes through the catchment, it takes out the orders the hub cant drive to
+        METRICS_TIMER("hubs.partition");
+        HubCatchment catchment(grid, hubLocations);
+        std::vector<std::pair<int,int>> unassigned;
+        std::vector<std::vector<std::pair<int,int>>> hubOrders = catchment.partition(houseLocations, unassigned);
+        // an order no hub can drive to would otherwise just be missing from the output
+        if (!unassigned.empty()) {
+            std::cerr << "Warning: " << unassigned.size() << " orders cant be reached from any hub and are not delivered:";
+            for (std::pair<int,int> house : unassigned) {
+                std::cerr << " (" << house.first << "," << house.second << ")";
+            }
+            std::cerr << std::endl;
+        }
+        METRICS_COUNT("hubs.unassigned_orders", unassigned.size());
+        return hubOrders;
+    };
+
+    // plan the route for one vehicle or split the orders across the fleet for one hub
+    auto planHub = [&](HubJob& job, int threads) {
+        HubOutput output;
+        output.hub = job.hub;
+        output.planned = true;
+        if (!job.orders.empty()) {
+            METRICS_TIMER("routes.plan");
+            std::stringstream buffer;
+            std::stringstream orderBuffer;
+            std::pair<int,int> hub = hubLocations[job.hub];
+            if (hubLocations.size() > 1) {
+                orderBuffer << "Hub " << job.hub + 1 << ": (" << hub.first << "," << hub.second << ")\n" << std::endl;
+            }
+            if (clusterSize > 0) {
+                planClusters(hub, job.orders, grid, clusterSize, threads, orderBuffer, buffer);
+            } else if (vehicles == 1) {
+                planSingleRoute(hub, job.orders, grid, threads, orderBuffer, buffer);
+            } else {
+                output.planned = planFleet(hub, job.orders, grid, vehicles, capacity, threads, orderBuffer, buffer);
+            }
+            output.orders = orderBuffer.str();
+            output.paths = buffer.str();
+        }
+        return output;
+    };
+
+    long long bytesWritten = 0;
+    auto writeHub = [&](const HubOutput& output) {
+        METRICS_TIMER("output.write");
+        std::cout << output.orders << std::flush;
+        outfile << output.paths << std::flush;
+        bytesWritten += output.paths.size();
+    };
+
+    int hardwareThreads = std::max(1, (int)std::thread::hardware_concurrency());
+
+    // a single hub is a single job, there is nothing for the stages to overlap so it is planned and written right here
+    // and its searches get every hardware thread
+    if (hubLocations.size() == 1) {
+        HubJob job;
+        job.orders = assignOrders()[0];
+        HubOutput output = planHub(job, hardwareThreads);
+        if (output.planned) {
+            writeHub(output);
+        }
+        METRICS_COUNT("output.bytes_written", bytesWritten);
+        return output.planned ? 0 : 1;
     }
-    return pathLengths;
+
+    BoundedQueue<HubJob> jobs(PIPELINE_DEPTH);
+    BoundedQueue<HubOutput> outputs(PIPELINE_DEPTH);
+
+    // source: hand the orders out a hub at a time
+    std::thread source([&]() {
+        std::vector<std::vector<std::pair<int,int>>> hubOrders = assignOrders();
+        for (int hub = 0; hub < hubLocations.size(); hub++) {
+            HubJob job;
+            job.hub = hub;
+            job.orders = hubOrders[hub];
+            jobs.push(std::move(job));
+        }
+        jobs.close();
+    });
+
+    // planners: each plans a hub at a time. the hardware threads are shared out between the planners so their
+    // searches dont start a thread pool per hardware thread each
+    int planners = std::max(1, std::min((int)hubLocations.size(), hardwareThreads));
+    int threadsPerPlanner = std::max(1, hardwareThreads / planners);
+    std::atomic<int> planning(planners);
+    std::vector<std::thread> plannerThreads;
+    for (int planner = 0; planner < planners; planner++) {
+        plannerThreads.push_back(std::thread([&]() {
+            HubJob job;
+            while (jobs.pop(job)) {
+                outputs.push(planHub(job, threadsPerPlanner));
+            }
+            // the last planner to finish tells the writer nothing more is coming
+            if (--planning == 0) {
+                outputs.close();
+            }
+        }));
+    }
+
+    // writer: hubs can finish out of order, each one waits here until every hub before it has been written
+    std::map<int, HubOutput> waiting;
+    int next = 0;
+    bool failed = false;
+    HubOutput output;
+    while (outputs.pop(output)) {
+        waiting[output.hub] = std::move(output);
+        for (auto ready = waiting.find(next); ready != waiting.end(); ready = waiting.find(next)) {
+            // after a hub that cant be served nothing more is written, but the queue is still drained
+            failed = failed || !ready->second.planned;
+            if (!failed) {
+                writeHub(ready->second);
+            }
+            waiting.erase(ready);
+            next++;
+        }
+    }
+    source.join();
+    for (std::thread& thread : plannerThreads) {
+        thread.join();
+    }
+    METRICS_COUNT("output.bytes_written", bytesWritten);
+    return failed ? 1 : 0;
 }
 
+// printed when the arguments cant be understood
+static const char* USAGE = "Usage: main SIZE [--vehicles N] [--capacity N] [--hubs N] [--orders N] [--hotspots N] [--serve stdin|SOCKET] [--save SNAPSHOT] [--load SNAPSHOT] [--tiles FILE] [--tile-cache N] [--shards N] [--simulate DAYS] [--workers N] [--cluster N]";
+
 int main(int argc, char* argv[]) {
     // make a random number generator
     std::random_device rd;  // a random seed for the mt19937
     std::mt19937 gen(rd()); // random number generator with a random seed
 
     // generate a randomized city accessible through the output file
+    if (argc < 2) {
+        std::cerr << USAGE << std::endl;
+        return 1;
+    }
     int size = std::stoi(argv[1]); // size must be either 1 or 2.
-    City cityMap(size);
-
-    // get the total house count for order generation
-    int totalHouses = cityMap.getHouseCount();
 
-    // Generate a quadtree and begin quadtree setup --------------------------------------------------------------------
-    // read in points from a file
-    std::ifstream file("map.txt");
-    std::vector<std::vector<std::string>> points;
-    std::string line;
-    int width = 0;
-    int height = 0;
-
-    // break up the points based on commas
-    while (std::getline(file, line)) {
-        std::vector<std::string> point;
-        std::istringstream iss(line);
-        std::string token;
-        while (std::getline(iss, token, ',')) {
-            point.push_back(token);
+    // optional flags after the size, how many vehicles leave each hub, how many orders each can carry (0 = no limit)
+    // how many hubs the city has, how many orders to deliver (0 = 2 - 7) and how many hotspots the orders cluster around
+    // and where to take queries from when running as a server instead of delivering a single batch,
+    // where to save the prepared session to and where to load one from instead of generating a city,
+    // and a tile file to generate and route a map bigger than memory in with how many tiles to keep in memory,
+    // and how many shards per side to split the map into for a server that routes with worker processes,
+    // and how many days to simulate in this process for capacity planning with how many worker threads,
+    // and the most orders per trip when the orders are split into clusters that are routed separately
+    int vehicles = 1;
+    int capacity = 0;
+    int hubs = 1;
+    int orders = 0;
+    int hotspots = 0;
+    std::string serve;
+    std::string save;
+    std::string load;
+    std::string tiles;
+    size_t tileCache = TiledGrid::DEFAULT_CACHE_TILES;
+    int shards = 0;
+    int simulate = 0;
+    int workers = 0;
+    int cluster = 0;
+    for (int i = 2; i < argc; i += 2) {
+        std::string flag = argv[i];
+        // every flag takes a value, a flag left at the end without one is a mistake rather than something to skip
+        if (i + 1 == argc) {
+            std::cerr << "Missing value for " << flag << std::endl << USAGE << std::endl;
+            return 1;
         }
-        points.push_back(point);
-        width = point.size();
-        height++;
-    }
-
-    // create a quadtree with a boundary of the vector
-    Rectangle boundary = {0, 0, (float)width, (float)height};
-    Quadtree quadtree(boundary);
-
-    // insert the points into the quadtree
-    for (int i = 0; i < points.size(); i++) {
-        for (int j = 0; j < points[i].size(); j++) {
-            if (points[i][j] != "0") {
-                float x = j;
-                float y = i;
-                std::string c = points[i][j];
-                //std::cout << c << std::endl;
-                Point p = {x, y, c};
-                quadtree.insert(p);
-            }
+        if (flag == "--vehicles") {
+            vehicles = std::max(1, std::stoi(argv[i + 1]));
+        } else if (flag == "--capacity") {
+            capacity = std::max(0, std::stoi(argv[i + 1]));
+        } else if (flag == "--hubs") {
+            hubs = std::max(1, std::stoi(argv[i + 1]));
+        } else if (flag == "--orders") {
+            orders = std::max(0, std::stoi(argv[i + 1]));
+        } else if (flag == "--hotspots") {
+            hotspots = std::max(0, std::stoi(argv[i + 1]));
+        } else if (flag == "--serve") {
+            serve = argv[i + 1];
+        } else if (flag == "--save") {
+            save = argv[i + 1];
+        } else if (flag == "--load") {
+            load = argv[i + 1];
+        } else if (flag == "--tiles") {
+            tiles = argv[i + 1];
+        } else if (flag == "--tile-cache") {
+            tileCache = std::max(1, std::stoi(argv[i + 1]));
+        } else if (flag == "--shards") {
+            shards = std::max(0, std::stoi(argv[i + 1]));
+        } else if (flag == "--simulate") {
+            simulate = std::max(0, std::stoi(argv[i + 1]));
+        } else if (flag == "--workers") {
+            workers = std::max(0, std::stoi(argv[i + 1]));
+        } else if (flag == "--cluster") {
+            cluster = std::max(0, std::stoi(argv[i + 1]));
+        } else {
+            std::cerr << "Unknown option " << flag << std::endl << USAGE << std::endl;
+            return 1;
         }
     }
 
-    // create a grid for the dijkstra algorithm
-    std::vector<std::vector<int>> grid(height, std::vector<int>(width, 0));
-    for (int i = 0; i < points.size(); i++) {
-        for (int j = 0; j < points[i].size(); j++) {
-            if (points[i][j] != "0") {
-                grid[i][j] = 1;
-            }
+    // every shard is a process, more than a few dozen only costs startup time
+    if (shards > ShardedRouter::MAX_SHARDS_PER_SIDE || (shards > 0 && serve.empty())) {
+        std::cerr << "--shards needs --serve and at most " << ShardedRouter::MAX_SHARDS_PER_SIDE << " shards per side." << std::endl;
+        return 1;
+    }
+
+    // every cluster is its own trip, there is no fleet to split them between
+    if (cluster > 0 && (vehicles > 1 || capacity > 0)) {
+        std::cerr << "--cluster sends one trip per cluster, it cant be used with --vehicles or --capacity." << std::endl;
+        return 1;
+    }
+    // a cluster is small enough to plan its trip exactly, bigger ones would fall back to local search
+    if (cluster > RouteOptimizer::HELD_KARP_LIMIT) {
+        std::cerr << "--cluster takes at most " << RouteOptimizer::HELD_KARP_LIMIT << " orders per cluster." << std::endl;
+        return 1;
+    }
+
+    // a simulation runs many generated days in this process and only prints their statistics
+    if (simulate > 0) {
+        if (hotspots > 0 || !serve.empty() || !save.empty() || !load.empty() || !tiles.empty()) {
+            std::cerr << "--simulate generates its own cities, it cant be used with --hotspots, --serve, --save, --load or --tiles." << std::endl;
+            return 1;
         }
+        Simulation simulation(size, hubs, orders, vehicles, capacity, gen(), workers);
+        simulation.run(simulate);
+        simulation.printReport(std::cout);
+        return 0;
     }
 
-    // create a vector of points that have houses
-    std::vector<Point> houses;
-    for (int i = 0; i < points.size(); i++) {
-        for (int j = 0; j < points[i].size(); j++) {
-            if (std::stoi(points[i][j]) > 0) {
-                float x = j;
-                float y = i;
-                std::string c = points[i][j];
-                Point p = {x, y, c};
-                houses.push_back(p);
-            }
+    // a saved snapshot is mapped straight in and served, there is no city to generate or map to parse
+    if (!load.empty()) {
+        if (serve.empty()) {
+            std::cerr << "--load needs --serve, orders are only generated for a new city." << std::endl;
+            return 1;
         }
+        Snapshot snapshot;
+        if (!snapshot.open(load)) {
+            return 1;
+        }
+        CitySession session(snapshot);
+        return serveQueries(session, serve, shards);
     }
-    // quadtree setup complete, now we can use dijkstras ---------------------------------------------------------------
 
-    // Create a string stream to buffer the output
-    std::stringstream buffer;
-    std::stringstream orderBuffer;
-    // with everything ready start making the deliveries
-    // generate up from 2 to 7 deliveries and store their locations in pickedHouses
-    std::vector<std::pair<int,int>> houseLocations = generateDeliveries(gen, cityMap, houses);
+    // a tiled city is only ever partly in memory, so it gets a single route that never builds the full grid
+    if (!tiles.empty()) {
+        if (vehicles > 1 || hubs > 1 || hotspots > 0 || !serve.empty() || !save.empty()) {
+            std::cerr << "--tiles plans a single route from one hub, it cant be used with --vehicles, --hubs, --hotspots, --serve or --save." << std::endl;
+            return 1;
+        }
+        return deliverTiled(gen, size, tiles, tileCache, orders);
+    }
 
-    // now that we have our houses to deliver to lets make some deliveries by chosing the one closest to the hub
-    // get the distance to all houses from the hub
-    std::vector<int> pathLengths;
-    pathLengths = findPathDistances(cityMap.getHubLocation(), houseLocations, grid);
-    std::vector<int> initialPathLengths = pathLengths;
+    City cityMap(size, hubs);
 
-    // bucket sort the pathLengths to find the lowest length
-    BucketSortInt bucketSort(1);
-    // for such a small amount of distances we can use a high bucket count for speed
-    bucketSort.bucket_sort(pathLengths, 10);
-    // with our path lengths sorted lowest to highest pick the lowest distance as shortestIndex (the index location of the shortest distance)
-    int shortestIndex = findLowestIndex(pathLengths,initialPathLengths);
+    // get the total house count for order generation
+    int totalHouses = cityMap.getHouseCount();
+
+    // Generate a quadtree and begin quadtree setup --------------------------------------------------------------------
+    // read in points from a file
+    MapReader map("map.txt");
 
-    // store the delivery house location
-    int lastHouseX = houseLocations[shortestIndex].first;
-    int lastHouseY = houseLocations[shortestIndex].second;
-    //std::cout << lastHouseY << ":" << lastHouseX << std::endl; // debug to show house locations
+    // the session builds the snapshot with the quadtree and the road mask, only a server or a save needs it
+    if (!save.empty() || !serve.empty()) {
+        CitySession session(map);
+        if (!save.empty() && !session.getSnapshot().save(save)) {
+            return 1;
+        }
+
+        // as a server everything above stays in memory and queries are answered until the input ends or SHUTDOWN is sent
+        if (!serve.empty()) {
+            return serveQueries(session, serve, shards);
+        }
+    }
+
+    // a batch only needs the grid for the dijkstra algorithm and the vector of points that have houses
+    std::vector<std::vector<int>> grid = map.buildGrid();
+    std::vector<Point> houses = map.findHouses();
+    // map setup complete, now we can use dijkstras --------------------------------------------------------------------
 
     // write the path output to a file
     // Create an ofstream object for file output
@@ -216,64 +832,7 @@ int main(int argc, char* argv[]) {
         std::cerr << "Error opening file." << std::endl;
         return 1; // Return with error code
     }
-    Dijkstra dijkstraHub(grid);
-    std::pair<int,int> hubLocation = cityMap.getHubLocation();
-    std::vector<std::pair<int, int>> paths = dijkstraHub.findShortestPath(hubLocation.second,hubLocation.first, lastHouseY, lastHouseX);
-    // print out the delivery in a nice to read format to be able to verify with the outputPath file
-    orderBuffer << "Order 1\n" << "Start location: (" << paths[0].second << "," << paths[0].first << ")\nEnd location: (" << paths[paths.size() - 1].second << "," << paths[paths.size() - 1].first << ")" << std::endl;
-    orderBuffer << "Path length: " << paths.size() << "\n" << std::endl;
-
-    // Loop over the paths vector and write each pair to the file
-    for (const std::pair<int, int>& p : paths) {
-        buffer << p.first << " " << p.second << std::endl;
-    }
-    buffer << std::endl;
-
-    houseLocations.erase(houseLocations.begin()+shortestIndex); // delete the house we already visited
-    shortestIndex = 0; // reset our shortest index for the next orders
-    // we have successfully plotted our first delivery which comes from the hub (special case), lets do the rest of the orders
-
-    // Polymorphic implementation of the above code to use a for loop for the remaining orders
-    // for all orders we have left
-    int orderNum = 2;
-    for (int order = 0; order < houseLocations.size(); order++) {
-        // get the distance to all houses from the last house (our current location)
-        pathLengths = findPathDistances(std::make_pair(lastHouseX, lastHouseY), houseLocations, grid);
-        initialPathLengths = pathLengths;
-
-        // for such a small amount of distances we can use a high bucket count for speed
-        bucketSort.bucket_sort(pathLengths, 10);
-        // with our path lengths sorted lowest to highest pick the lowest distance as shortestIndex (the index location of the shortest distance)
-        shortestIndex = findLowestIndex(pathLengths,initialPathLengths);
-
-        // write the path output to a file
-        Dijkstra dijkstraHouses(grid);
-        paths = dijkstraHouses.findShortestPath(lastHouseY,lastHouseX, houseLocations[shortestIndex].second, houseLocations[shortestIndex].first);
-        orderBuffer << "Order " << orderNum << "\n" << "Start location: (" << paths[0].second << "," << paths[0].first << ")\nEnd location: (" << paths[paths.size() - 1].second << "," << paths[paths.size() - 1].first << ")" << std::endl;
-        orderBuffer << "Path length: " << paths.size() << "\n" << std::endl;
-        orderNum++;
-
-        // store the delivery house location
-        lastHouseX = houseLocations[shortestIndex].first;
-        lastHouseY = houseLocations[shortestIndex].second;
-        // std::cout << lastHouseY << ":" << lastHouseX << std::endl; // debug to show house locations
 
-        // Loop over the paths vector and write each pair to the file
-        for (const std::pair<int, int>& p : paths) {
-            buffer << p.first << " " << p.second << std::endl;
-        }
-        buffer << std::endl;
-
-        houseLocations.erase(houseLocations.begin()+shortestIndex); // delete the house we already visited
-        order--;
-        shortestIndex = 0; // reset our shortest index for the next orders
-    }
-    std::string orderOutput = orderBuffer.str();
-    std::string output = buffer.str();
-    std::cout << orderOutput;
-    outfile << output;
-    return 0;
+    // with everything ready start making the deliveries
+    return deliverOrders(gen, cityMap, houses, grid, orders, hotspots, vehicles, capacity, cluster, outfile);
 }
-
-
-
@@ -0,0 +1,96 @@
+#include "mapreader.h"
+#include "metrics.h"
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Constructor for the map reader, reads and splits the whole file straight away
+ * @param path the map file to read, usually map.txt
+ */
+MapReader::MapReader(const std::string& path) {
+    METRICS_TIMER("map.parse");
+    std::ifstream file(path);
+    std::string line;
+
+    // break up the points based on commas
+    while (std::getline(file, line)) {
+        std::vector<std::string> point;
+        std::istringstream iss(line);
+        std::string token;
+        while (std::getline(iss, token, ',')) {
+            point.push_back(token);
+        }
+        points.push_back(point);
+        width = point.size();
+        height++;
+    }
+}
+
+int MapReader::getWidth() const {
+    return width;
+}
+
+int MapReader::getHeight() const {
+    return height;
+}
+
+const std::vector<std::vector<std::string>>& MapReader::getPoints() const {
+    return points;
+}
+
+/**
+ * Create a grid for the dijkstra algorithm
+ * @return grid[row][col], 1 for anything that can be driven on (roads, houses and hubs) and 0 for empty land
+ */
+std::vector<std::vector<int>> MapReader::buildGrid() const {
+    std::vector<std::vector<int>> grid(height, std::vector<int>(width, 0));
+    for (int i = 0; i < points.size(); i++) {
+        for (int j = 0; j < points[i].size(); j++) {
+            if (points[i][j] != "0") {
+                grid[i][j] = 1;
+            }
+        }
+    }
+    return grid;
+}
+
+/**
+ * Create a vector of points that have houses
+ * @return every house with x as the column, y as the row and c as its house number
+ */
+std::vector<Point> MapReader::findHouses() const {
+    std::vector<Point> houses;
+    for (int i = 0; i < points.size(); i++) {
+        for (int j = 0; j < points[i].size(); j++) {
+            if (std::stoi(points[i][j]) > 0) {
+                float x = j;
+                float y = i;
+                std::string c = points[i][j];
+                Point p = {x, y, c};
+                houses.push_back(p);
+            }
+        }
+    }
+    return houses;
+}
+
+/**
+ * Insert every non empty point into the quadtree
+ * @param quadtree a quadtree with a boundary covering the map
+ */
+void MapReader::fillQuadtree(Quadtree& quadtree) const {
+    METRICS_TIMER("quadtree.build");
+    for (int i = 0; i < points.size(); i++) {
+        for (int j = 0; j < points[i].size(); j++) {
+            if (points[i][j] != "0") {
+                float x = j;
+                float y = i;
+                std::string c = points[i][j];
+                Point p = {x, y, c};
+                quadtree.insert(p);
+            }
+        }
+    }
+}
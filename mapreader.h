@@ -0,0 +1,30 @@
+#ifndef MAPREADER_H
+#define MAPREADER_H
+
+#include <string>
+#include <vector>
+#include "quadtree.h"
+
+/*
+ * Reads the comma separated map.txt written by City and turns it into the structures the rest of the program uses,
+ * the dijkstra grid, the list of houses and the quadtree
+ */
+class MapReader {
+public:
+    explicit MapReader(const std::string& path);
+
+    int getWidth() const;
+    int getHeight() const;
+    const std::vector<std::vector<std::string>>& getPoints() const;
+
+    std::vector<std::vector<int>> buildGrid() const;
+    std::vector<Point> findHouses() const;
+    void fillQuadtree(Quadtree& quadtree) const;
+
+private:
+    std::vector<std::vector<std::string>> points;
+    int width = 0;
+    int height = 0;
+};
+
+#endif
@@ -0,0 +1,96 @@
+#include "metrics.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+/**
+ * The process wide metrics, created on first use and destroyed (writing the report) when the program exits
+ */
+Metrics& Metrics::instance() {
+    static Metrics metrics;
+    return metrics;
+}
+
+Metrics::~Metrics() {
+    // nothing was recorded, so metrics are turned off, dont leave an empty report behind
+    if (phases.empty() && counters.empty()) {
+        return;
+    }
+    std::ofstream report(reportPath);
+    if (!report) {
+        std::cerr << "Error opening metrics report " << reportPath << std::endl;
+        return;
+    }
+    report << toJson();
+}
+
+void Metrics::add(Stat& stat, double value) {
+    if (stat.samples == 0 || value < stat.min) {
+        stat.min = value;
+    }
+    if (stat.samples == 0 || value > stat.max) {
+        stat.max = value;
+    }
+    stat.samples++;
+    stat.total += value;
+}
+
+/**
+ * Record how long one run of a phase took
+ * @param phase the phase name
+ * @param milliseconds how long it took
+ */
+void Metrics::recordTime(const std::string& phase, double milliseconds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    add(phases[phase], milliseconds);
+}
+
+/**
+ * Record one sample of a counter, for example the nodes popped by a single query
+ * @param counter the counter name
+ * @param value the value for this sample
+ */
+void Metrics::recordCount(const std::string& counter, long long value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    add(counters[counter], value);
+}
+
+void Metrics::setReportPath(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    reportPath = path;
+}
+
+/**
+ * Build the JSON report, every phase and counter lists its samples, total, mean, min and max
+ * @return the report as a JSON string
+ */
+std::string Metrics::toJson() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ostringstream json;
+
+    auto writeStats = [&json](const std::map<std::string, Stat>& stats, const std::string& unit) {
+        bool first = true;
+        for (const auto& entry : stats) {
+            const Stat& stat = entry.second;
+            json << (first ? "\n" : ",\n") << "    \"" << entry.first << "\": {\"samples\": " << stat.samples
+                 << ", \"total" << unit << "\": " << stat.total << ", \"mean" << unit << "\": " << stat.total / stat.samples
+                 << ", \"min" << unit << "\": " << stat.min << ", \"max" << unit << "\": " << stat.max << "}";
+            first = false;
+        }
+    };
+
+    json << "{\n  \"phases\": {";
+    writeStats(phases, "_ms");
+    json << "\n  },\n  \"counters\": {";
+    writeStats(counters, "");
+    json << "\n  }\n}\n";
+    return json.str();
+}
+
+ScopedTimer::ScopedTimer(const char* phase) : phase(phase), start(std::chrono::steady_clock::now()) {
+}
+
+ScopedTimer::~ScopedTimer() {
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    Metrics::instance().recordTime(phase, elapsed.count());
+}
@@ -0,0 +1,67 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+
+/*
+ * Lightweight instrumentation. Phases are timed with scoped (RAII) timers and searches report per query counters,
+ * everything is collected in one process wide Metrics object that writes a JSON report when the program exits.
+ * Build with -DDELIVERY_METRICS to turn it on, without it every macro below compiles to nothing
+ */
+class Metrics {
+public:
+    static Metrics& instance();
+    ~Metrics();
+
+    void recordTime(const std::string& phase, double milliseconds);
+    void recordCount(const std::string& counter, long long value);
+    void setReportPath(const std::string& path);
+    std::string toJson();
+
+private:
+    // summary of every sample of a timer or counter
+    struct Stat {
+        long long samples = 0;
+        double total = 0;
+        double min = 0;
+        double max = 0;
+    };
+
+    std::map<std::string, Stat> phases;
+    std::map<std::string, Stat> counters;
+    std::string reportPath = "metrics.json";
+    std::mutex mutex;
+
+    Metrics() = default;
+    static void add(Stat& stat, double value);
+};
+
+/*
+ * Times the scope it lives in and records it under the phase name when it is destroyed
+ */
+class ScopedTimer {
+public:
+    explicit ScopedTimer(const char* phase);
+    ~ScopedTimer();
+
+private:
+    const char* phase;
+    std::chrono::steady_clock::time_point start;
+};
+
+#ifdef DELIVERY_METRICS
+#define METRICS_CONCAT_INNER(a, b) a##b
+#define METRICS_CONCAT(a, b) METRICS_CONCAT_INNER(a, b)
+#define METRICS_TIMER(phase) ScopedTimer METRICS_CONCAT(metricsTimer, __LINE__)(phase)
+#define METRICS_COUNT(counter, value) Metrics::instance().recordCount(counter, value)
+#define METRICS_REPORT_PATH(path) Metrics::instance().setReportPath(path)
+#else
+#define METRICS_TIMER(phase) ((void)0)
+#define METRICS_COUNT(counter, value) ((void)0)
+#define METRICS_REPORT_PATH(path) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,110 @@
+#include "orderclusterer.h"
+#include "metrics.h"
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+/**
+ * Constructor for the clusterer
+ * @param rows the amount of rows in the map
+ * @param cols the amount of collumns in the map
+ * @param maxOrders the most orders a cluster can have
+ */
+OrderClusterer::OrderClusterer(int rows, int cols, int maxOrders) {
+    this->rows = rows;
+    this->cols = cols;
+    this->maxOrders = std::max(1, maxOrders);
+}
+
+/**
+ * Split the orders into clusters of at most maxOrders orders that are close together
+ * @param orders the orders to split
+ * @return the clusters, every order is in exactly one of them
+ */
+std::vector<std::vector<std::pair<int,int>>> OrderClusterer::cluster(const std::vector<std::pair<int,int>>& orders) const {
+    METRICS_TIMER("orders.cluster");
+    // every point remembers which order it is, the quadtree keeps it in the point's c field
+    Quadtree quadtree(Rectangle{0, 0, (float)cols, (float)rows});
+    for (int order = 0; order < orders.size(); order++) {
+        quadtree.insert(Point{(float)orders[order].second, (float)orders[order].first, std::to_string(order)});
+    }
+    std::vector<std::vector<int>> groups;
+    collectGroups(quadtree.root, groups);
+
+    // a point on the edge between two quarters is in both of them, it goes to the first group that has it
+    std::vector<bool> taken(orders.size(), false);
+    std::vector<std::vector<std::pair<int,int>>> clusters;
+    std::vector<std::pair<int,int>> current;
+    for (const std::vector<int>& group : groups) {
+        std::vector<std::pair<int,int>> members;
+        for (int order : group) {
+            if (!taken[order]) {
+                taken[order] = true;
+                members.push_back(orders[order]);
+            }
+        }
+        // groups next to each other on the Z curve are neighbors on the map, keep filling the cluster while they fit
+        if (!current.empty() && current.size() + members.size() > maxOrders) {
+            clusters.push_back(current);
+            current.clear();
+        }
+        // a leaf can hold a few more than a tiny maxOrders, it is cut up in order
+        for (std::pair<int,int> member : members) {
+            if (current.size() == maxOrders) {
+                clusters.push_back(current);
+                current.clear();
+            }
+            current.push_back(member);
+        }
+    }
+    if (!current.empty()) {
+        clusters.push_back(current);
+    }
+    METRICS_COUNT("orders.clusters", clusters.size());
+    return clusters;
+}
+
+/**
+ * @return how many points are in the subtree, points on an edge are counted once per quarter they are in
+ */
+int OrderClusterer::countOrders(const QuadTreeNode* node) {
+    if (node == nullptr) {
+        return 0;
+    }
+    return node->points.size() + countOrders(node->NW) + countOrders(node->NE) + countOrders(node->SW) + countOrders(node->SE);
+}
+
+/**
+ * Walk the tree and turn every subtree that is small enough into one group of order numbers
+ */
+void OrderClusterer::collectGroups(const QuadTreeNode* node, std::vector<std::vector<int>>& groups) const {
+    if (node == nullptr) {
+        return;
+    }
+    if (node->NW == nullptr || countOrders(node) <= maxOrders) {
+        std::vector<int> group;
+        collectOrders(node, group);
+        if (!group.empty()) {
+            groups.push_back(group);
+        }
+        return;
+    }
+    collectGroups(node->NW, groups);
+    collectGroups(node->NE, groups);
+    collectGroups(node->SW, groups);
+    collectGroups(node->SE, groups);
+}
+
+void OrderClusterer::collectOrders(const QuadTreeNode* node, std::vector<int>& group) {
+    if (node == nullptr) {
+        return;
+    }
+    for (const Point& point : node->points) {
+        group.push_back(std::atoi(point.c.c_str()));
+    }
+    collectOrders(node->NW, group);
+    collectOrders(node->NE, group);
+    collectOrders(node->SW, group);
+    collectOrders(node->SE, group);
+}
@@ -0,0 +1,32 @@
+#ifndef ORDERCLUSTERER_H
+#define ORDERCLUSTERER_H
+
+#include <vector>
+#include <utility>
+#include "quadtree.h"
+
+/*
+ * Splits a large batch of orders into small spatially compact clusters that can each be routed on their own.
+ * The orders are put in a Quadtree over the map and every subtree with at most maxOrders orders in it is kept
+ * together, bigger subtrees are split into their quarters. The groups come out in NW, NE, SW, SE order (a Z curve),
+ * so groups that follow each other are close together and are packed into one cluster while they fit.
+ * Routing n orders then costs n / maxOrders small problems instead of one problem that grows much faster than n.
+ * Coordinates are (row, col) pairs like the ones used by City and main
+ */
+class OrderClusterer {
+public:
+    OrderClusterer(int rows, int cols, int maxOrders);
+
+    std::vector<std::vector<std::pair<int,int>>> cluster(const std::vector<std::pair<int,int>>& orders) const;
+
+private:
+    int rows;
+    int cols;
+    int maxOrders;
+
+    static int countOrders(const QuadTreeNode* node);
+    void collectGroups(const QuadTreeNode* node, std::vector<std::vector<int>>& groups) const;
+    static void collectOrders(const QuadTreeNode* node, std::vector<int>& group);
+};
+
+#endif
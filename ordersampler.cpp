@@ -0,0 +1,70 @@
+#include "ordersampler.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_set>
+
+/**
+ * Constructor for an order sampler
+ * @param population how many items there are to pick from, items are numbered 0 -> population - 1
+ */
+OrderSampler::OrderSampler(int population) {
+    this->population = population;
+}
+
+/**
+ * Pick count distinct items uniformly at random with Floyd's algorithm. For every j in the last count items of the
+ * population a random item from 0 -> j is taken, and if it was already taken j itself is taken instead.
+ * Every pick is O(1) so there is no retry loop that slows down as count gets close to the population
+ * @param gen the random number generator
+ * @param count how many items to pick, clamped to the population
+ * @return the picked items
+ */
+std::vector<int> OrderSampler::sample(std::mt19937& gen, int count) {
+    count = std::max(0, std::min(count, population));
+    std::vector<int> picked;
+    picked.reserve(count);
+    std::unordered_set<int> taken;
+    taken.reserve(count * 2);
+
+    for (int j = population - count; j < population; j++) {
+        std::uniform_int_distribution<int> dist(0, j);
+        int item = dist(gen);
+        if (!taken.insert(item).second) {
+            item = j;
+            taken.insert(item);
+        }
+        picked.push_back(item);
+    }
+    return picked;
+}
+
+/**
+ * Pick count distinct items where item i is picked with a chance proportional to weights[i]
+ * (Efraimidis-Spirakis: every item gets the key log(u) / weight and the count largest keys are kept).
+ * Items with a weight of 0 are only picked once every weighted item has been
+ * @param gen the random number generator
+ * @param count how many items to pick, clamped to the population
+ * @param weights one weight per item, must not be negative
+ * @return the picked items
+ */
+std::vector<int> OrderSampler::sampleWeighted(std::mt19937& gen, int count, const std::vector<double>& weights) {
+    count = std::max(0, std::min(count, population));
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+
+    std::vector<std::pair<double, int>> keys(population);
+    for (int i = 0; i < population; i++) {
+        double u = std::max(dist(gen), std::numeric_limits<double>::min());
+        double key = weights[i] > 0 ? std::log(u) / weights[i] : -std::numeric_limits<double>::infinity();
+        keys[i] = std::make_pair(key, i);
+    }
+
+    // only the count largest keys are needed so a partial selection is enough, no full sort
+    std::nth_element(keys.begin(), keys.begin() + count, keys.end(), std::greater<std::pair<double, int>>());
+    std::vector<int> picked;
+    picked.reserve(count);
+    for (int i = 0; i < count; i++) {
+        picked.push_back(keys[i].second);
+    }
+    return picked;
+}
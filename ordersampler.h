@@ -0,0 +1,22 @@
+#ifndef ORDERSAMPLER_H
+#define ORDERSAMPLER_H
+
+#include <vector>
+#include <random>
+
+/*
+ * Order sampler, picks distinct items (houses) out of a population without replacement
+ * uniform sampling uses Floyd's algorithm so it costs O(count) no matter how close count gets to the population
+ */
+class OrderSampler {
+public:
+    explicit OrderSampler(int population);
+
+    std::vector<int> sample(std::mt19937& gen, int count);
+    std::vector<int> sampleWeighted(std::mt19937& gen, int count, const std::vector<double>& weights);
+
+private:
+    int population;
+};
+
+#endif
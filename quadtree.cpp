@@ -1,5 +1,6 @@
 #include <iostream>
 #include <vector>
+#include <cstdlib>
 #include "quadtree.h"
 
 
@@ -10,6 +11,22 @@ Quadtree::Quadtree(Rectangle boundary){
     root = new QuadTreeNode(boundary);
 }
 
+Quadtree::~Quadtree(){
+    destroy(root);
+}
+
+void Quadtree::destroy(QuadTreeNode* node){
+    // delete the children before the node itself
+    if(node == nullptr){
+        return;
+    }
+    destroy(node->NW);
+    destroy(node->NE);
+    destroy(node->SW);
+    destroy(node->SE);
+    delete node;
+}
+
 void Quadtree::insert(Point p){
     // insert a point into the quadtree from the root
     insert(root, p);
@@ -80,6 +97,98 @@ void Quadtree::subdivide(QuadTreeNode* node){
     node->SE = new QuadTreeNode(SE);
 }
 
+std::vector<Point> Quadtree::query(Rectangle range){
+    // collect every point inside the range, starting from the root
+    std::vector<Point> found;
+    query(root, range, found);
+    return found;
+}
+
+void Quadtree::query(QuadTreeNode* node, Rectangle range, std::vector<Point>& found){
+    // skip any node that doesnt overlap the range at all
+    if(node == nullptr || !intersects(node->boundary, range)){
+        return;
+    }
+    for(const Point& p : node->points){
+        // points on the edge between two nodes are stored in both, only report them from the node they start in
+        bool inNode = p.x < node->boundary.x + node->boundary.w && p.y < node->boundary.y + node->boundary.h;
+        if(inNode && contains(range, p)){
+            found.push_back(p);
+        }
+    }
+    query(node->NW, range, found);
+    query(node->NE, range, found);
+    query(node->SW, range, found);
+    query(node->SE, range, found);
+}
+
+/**
+ * Copy the tree into flat arrays with no pointers, nodes are numbered breadth first so the root is node 0
+ * @param nodes filled with every node
+ * @param flatPoints filled with the points of every leaf, each node points at its own range
+ */
+void Quadtree::flatten(std::vector<FlatQuadtreeNode>& nodes, std::vector<FlatPoint>& flatPoints){
+    nodes.clear();
+    flatPoints.clear();
+    std::vector<QuadTreeNode*> order;
+    order.push_back(root);
+    nodes.push_back(FlatQuadtreeNode{root->boundary, -1, 0, 0, 0});
+    for(int i = 0; i < order.size(); i++){
+        QuadTreeNode* node = order[i];
+        nodes[i].firstPoint = flatPoints.size();
+        nodes[i].pointCount = node->points.size();
+        for(const Point& p : node->points){
+            flatPoints.push_back(FlatPoint{(int32_t)p.x, (int32_t)p.y, (int32_t)std::atoi(p.c.c_str())});
+        }
+        if(node->NW != nullptr){
+            nodes[i].firstChild = order.size();
+            QuadTreeNode* children[4] = {node->NW, node->NE, node->SW, node->SE};
+            for(QuadTreeNode* child : children){
+                order.push_back(child);
+                nodes.push_back(FlatQuadtreeNode{child->boundary, -1, 0, 0, 0});
+            }
+        }
+    }
+}
+
+/**
+ * Same as query but on a flattened tree, so it works on a tree loaded straight from a snapshot file
+ * @param nodes the flat nodes, node 0 is the root
+ * @param flatPoints the flat points the nodes point into
+ * @param range the rectangle to search
+ * @param found every point inside the range is added to this
+ */
+void Quadtree::query(const FlatQuadtreeNode* nodes, const FlatPoint* flatPoints, Rectangle range, std::vector<FlatPoint>& found){
+    std::vector<int> stack;
+    stack.push_back(0);
+    while(!stack.empty()){
+        const FlatQuadtreeNode& node = nodes[stack.back()];
+        stack.pop_back();
+        if(!intersects(node.boundary, range)){
+            continue;
+        }
+        for(int i = node.firstPoint; i < node.firstPoint + node.pointCount; i++){
+            const FlatPoint& p = flatPoints[i];
+            // same as the pointer query, edge points are only reported from the node they start in
+            bool inNode = p.x < node.boundary.x + node.boundary.w && p.y < node.boundary.y + node.boundary.h;
+            bool inRange = p.x >= range.x && p.x <= range.x + range.w && p.y >= range.y && p.y <= range.y + range.h;
+            if(inNode && inRange){
+                found.push_back(p);
+            }
+        }
+        if(node.firstChild != -1){
+            for(int child = 0; child < 4; child++){
+                stack.push_back(node.firstChild + child);
+            }
+        }
+    }
+}
+
+bool Quadtree::intersects(Rectangle boundary, Rectangle range){
+    // checks if the two rectangles overlap, touching edges count as overlapping
+    return !(range.x > boundary.x + boundary.w || range.x + range.w < boundary.x ||
+             range.y > boundary.y + boundary.h || range.y + range.h < boundary.y);
+}
 
 void Quadtree::print(){
     print(root);
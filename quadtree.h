@@ -3,6 +3,8 @@
 
 #include <vector>
 #include <iostream>
+#include <cstdint>
+#include <string>
 
 struct Point{
     // x, y values of a point
@@ -34,9 +36,27 @@ struct QuadTreeNode{
         SE = nullptr;
     }    
 };
+// pointer free copy of a quadtree node, the children of a node are stored next to each other in NW, NE, SW, SE order
+// and its points are a range of a separate point array, so the whole tree can be written to a file and used in place
+struct FlatQuadtreeNode{
+    Rectangle boundary;
+    int32_t firstChild; // -1 for a leaf
+    int32_t firstPoint;
+    int32_t pointCount;
+    int32_t padding;
+};
+struct FlatPoint{
+    int32_t x;
+    int32_t y;
+    int32_t value; // the map value of the cell, positive numbers are houses
+};
+
 class Quadtree {
     public:
         Quadtree(Rectangle boundary);
+        ~Quadtree();
+        Quadtree(const Quadtree&) = delete;
+        Quadtree& operator=(const Quadtree&) = delete;
         void insert(Point p);
         std::vector<Point> query(Rectangle range);
         void subdivide();
@@ -45,6 +65,8 @@ class Quadtree {
         bool contains(Point p);
         bool search(Point p);
         Rectangle getBoundary();
+        void flatten(std::vector<FlatQuadtreeNode>& nodes, std::vector<FlatPoint>& flatPoints);
+        static void query(const FlatQuadtreeNode* nodes, const FlatPoint* flatPoints, Rectangle range, std::vector<FlatPoint>& found);
         QuadTreeNode* root;
 
 
@@ -53,7 +75,9 @@ class Quadtree {
         Rectangle boundary;
         bool contains(Rectangle boundary, Point p);
         void insert(QuadTreeNode* node, Point p);
-        bool intersects(Rectangle boundary, Rectangle range);
+        static bool intersects(Rectangle boundary, Rectangle range);
+        void destroy(QuadTreeNode* node);
+        void query(QuadTreeNode* node, Rectangle range, std::vector<Point>& found);
         void subdivide(QuadTreeNode* node);
         
         bool seach(QuadTreeNode* node, Point p);
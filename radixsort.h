@@ -0,0 +1,155 @@
+#ifndef RADIXSORT_H
+#define RADIXSORT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+ * Radix sort for integer keys that can also hand back the sorting permutation (argsort), so callers get the
+ * original index of every key without searching for it afterwards.
+ * Keys with a small range (no bigger than the amount of keys, or 65536) are counting sorted in a single pass,
+ * wider keys use least significant digit radix sort with 11 bit digits, only over the digits the key range needs.
+ * Both are stable, equal keys keep their original order
+ */
+class RadixSort {
+public:
+    /**
+     * Find the order that sorts the keys
+     * @param keys the keys to sort, they are not changed
+     * @param descending sort highest to lowest instead of lowest to highest
+     * @return indexes into keys, keys[result[0]] is the first key in sorted order
+     */
+    template <typename Key>
+    static std::vector<int> argsort(const std::vector<Key>& keys, bool descending = false) {
+        static_assert(std::is_integral<Key>::value, "RadixSort only sorts integer keys");
+        std::vector<Entry> entries(keys.size());
+        for (int i = 0; i < keys.size(); i++) {
+            entries[i].rank = normalize(keys[i], descending);
+            entries[i].index = i;
+        }
+        sortEntries(entries);
+
+        std::vector<int> order(entries.size());
+        for (int i = 0; i < entries.size(); i++) {
+            order[i] = entries[i].index;
+        }
+        return order;
+    }
+
+    /**
+     * Sort (key, payload) pairs by their key, the payload moves with its key
+     * @param items the pairs to sort in place
+     * @param descending sort highest to lowest instead of lowest to highest
+     */
+    template <typename Key, typename Payload>
+    static void sort(std::vector<std::pair<Key, Payload>>& items, bool descending = false) {
+        std::vector<Key> keys(items.size());
+        for (int i = 0; i < items.size(); i++) {
+            keys[i] = items[i].first;
+        }
+        std::vector<int> order = argsort(keys, descending);
+
+        std::vector<std::pair<Key, Payload>> sorted;
+        sorted.reserve(items.size());
+        for (int index : order) {
+            sorted.push_back(std::move(items[index]));
+        }
+        items.swap(sorted);
+    }
+
+private:
+    // a key turned into an unsigned rank that sorts the same way, and where it came from
+    struct Entry {
+        uint64_t rank;
+        int index;
+    };
+
+    static const int COUNTING_SORT_RANGE = 1 << 16;
+    static const int DIGIT_BITS = 11;
+    static const int DIGIT_VALUES = 1 << DIGIT_BITS;
+
+    /**
+     * Map a key onto an unsigned 64 bit rank with the same order. Signed keys have their sign bit flipped so
+     * negatives come first, and descending order just inverts every bit
+     */
+    template <typename Key>
+    static uint64_t normalize(Key key, bool descending) {
+        typedef typename std::make_unsigned<Key>::type Unsigned;
+        uint64_t rank = (Unsigned)key;
+        if (std::is_signed<Key>::value) {
+            rank ^= (uint64_t)1 << (sizeof(Key) * 8 - 1);
+        }
+        if (descending) {
+            rank = ~rank & (std::numeric_limits<Unsigned>::max)();
+        }
+        return rank;
+    }
+
+    static void sortEntries(std::vector<Entry>& entries) {
+        if (entries.size() <= 1) {
+            return;
+        }
+        uint64_t minRank = entries[0].rank;
+        uint64_t maxRank = entries[0].rank;
+        for (const Entry& entry : entries) {
+            minRank = std::min(minRank, entry.rank);
+            maxRank = std::max(maxRank, entry.rank);
+        }
+        // shift the ranks down to start at 0 so only the digits of the range have to be sorted
+        uint64_t range = maxRank - minRank;
+        for (Entry& entry : entries) {
+            entry.rank -= minRank;
+        }
+
+        if (range < entries.size() || range < COUNTING_SORT_RANGE) {
+            countingSort(entries, range);
+        } else {
+            radixSort(entries, range);
+        }
+    }
+
+    /**
+     * Counting sort, one bucket per possible rank
+     */
+    static void countingSort(std::vector<Entry>& entries, uint64_t range) {
+        std::vector<int> counts(range + 2, 0);
+        for (const Entry& entry : entries) {
+            counts[entry.rank + 1]++;
+        }
+        for (int i = 1; i < counts.size(); i++) {
+            counts[i] += counts[i - 1];
+        }
+        std::vector<Entry> sorted(entries.size());
+        for (const Entry& entry : entries) {
+            sorted[counts[entry.rank]++] = entry;
+        }
+        entries.swap(sorted);
+    }
+
+    /**
+     * Least significant digit radix sort, one stable counting pass per digit of the range
+     */
+    static void radixSort(std::vector<Entry>& entries, uint64_t range) {
+        std::vector<Entry> buffer(entries.size());
+        std::vector<int> counts(DIGIT_VALUES + 1);
+        for (int shift = 0; shift < 64 && (range >> shift) != 0; shift += DIGIT_BITS) {
+            std::fill(counts.begin(), counts.end(), 0);
+            for (const Entry& entry : entries) {
+                counts[((entry.rank >> shift) & (DIGIT_VALUES - 1)) + 1]++;
+            }
+            for (int i = 1; i <= DIGIT_VALUES; i++) {
+                counts[i] += counts[i - 1];
+            }
+            for (const Entry& entry : entries) {
+                buffer[counts[(entry.rank >> shift) & (DIGIT_VALUES - 1)]++] = entry;
+            }
+            entries.swap(buffer);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,234 @@
+#include "routeoptimizer.h"
+#include "dispatchqueue.h"
+#include "metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <vector>
+
+const int RouteOptimizer::HELD_KARP_LIMIT;
+
+/**
+ * Constructor for a route optimizer
+ * @param distances square matrix where distances[i][j] is the distance from stop i to stop j, stop 0 is the start
+ * @param timeBudgetMs how long local search is allowed to run for on large stop counts
+ * @param maxPasses 0 to search until the time budget runs out, otherwise the most passes of 2-opt and Or-opt and the
+ *                  time budget is ignored, so the route doesnt depend on how busy the machine is
+ */
+RouteOptimizer::RouteOptimizer(const std::vector<std::vector<int>>& distances, int timeBudgetMs, int maxPasses) : distances(distances) {
+    this->stops = distances.size();
+    this->timeBudgetMs = timeBudgetMs;
+    this->maxPasses = maxPasses;
+}
+
+/**
+ * Distance between two stops in the route. The route is open (we dont drive back to the hub)
+ * so going to the "stop" after the last one (-1) costs nothing
+ */
+int RouteOptimizer::distance(int from, int to) const {
+    if (from < 0 || to < 0) {
+        return 0;
+    }
+    return distances[from][to];
+}
+
+/**
+ * Total length of a route
+ * @param route the stops in the order they are visited, starting with 0
+ * @return the sum of the distances of every leg
+ */
+int RouteOptimizer::routeLength(const std::vector<int>& route) const {
+    int length = 0;
+    for (int i = 1; i < route.size(); i++) {
+        length += distance(route[i - 1], route[i]);
+    }
+    return length;
+}
+
+/**
+ * Find the best order to visit the stops in
+ * @return the stops in the order they should be visited, the first is always 0 (the start)
+ */
+std::vector<int> RouteOptimizer::solve() {
+    METRICS_TIMER("route_optimizer.solve");
+    if (stops <= 2) {
+        std::vector<int> route;
+        for (int i = 0; i < stops; i++) {
+            route.push_back(i);
+        }
+        return route;
+    }
+    if (stops - 1 <= HELD_KARP_LIMIT) {
+        return heldKarp();
+    }
+    return localSearch();
+}
+
+/**
+ * Exact Held-Karp dynamic programming solution, O(2^n * n^2) so only used for small stop counts
+ * cost[mask][last] is the shortest route from the start that visits every stop in mask and ends at last
+ * @return the optimal route
+ */
+std::vector<int> RouteOptimizer::heldKarp() {
+    int houses = stops - 1;
+    int fullMask = (1 << houses) - 1;
+    const int INF = std::numeric_limits<int>::max();
+
+    std::vector<std::vector<int>> cost(1 << houses, std::vector<int>(houses, INF));
+    std::vector<std::vector<int>> parent(1 << houses, std::vector<int>(houses, -1));
+
+    // going straight from the start to a single house
+    for (int house = 0; house < houses; house++) {
+        cost[1 << house][house] = distance(0, house + 1);
+    }
+
+    // extend every partial route by one more house that it hasnt visited yet
+    for (int mask = 1; mask <= fullMask; mask++) {
+        for (int last = 0; last < houses; last++) {
+            if (!(mask & (1 << last)) || cost[mask][last] == INF) {
+                continue;
+            }
+            for (int next = 0; next < houses; next++) {
+                if (mask & (1 << next)) {
+                    continue;
+                }
+                int nextMask = mask | (1 << next);
+                int newCost = cost[mask][last] + distance(last + 1, next + 1);
+                if (newCost < cost[nextMask][next]) {
+                    cost[nextMask][next] = newCost;
+                    parent[nextMask][next] = last;
+                }
+            }
+        }
+    }
+
+    // the route can end at any house, pick the cheapest
+    int last = 0;
+    for (int house = 1; house < houses; house++) {
+        if (cost[fullMask][house] < cost[fullMask][last]) {
+            last = house;
+        }
+    }
+
+    // walk the parents back to rebuild the route
+    std::vector<int> route;
+    int mask = fullMask;
+    while (last != -1) {
+        route.push_back(last + 1);
+        int previous = parent[mask][last];
+        mask ^= 1 << last;
+        last = previous;
+    }
+    route.push_back(0);
+    std::reverse(route.begin(), route.end());
+    return route;
+}
+
+/**
+ * Greedy route that always goes to the closest stop not yet visited, used as the starting point for local search
+ * the pending stops sit in a dispatch queue so every leg is one batch distance refresh and one O(log n) extract
+ * @return the greedy route
+ */
+std::vector<int> RouteOptimizer::nearestNeighbour() {
+    std::vector<int> route;
+    route.push_back(0);
+
+    DispatchQueue pending(stops);
+    for (int stop = 1; stop < stops; stop++) {
+        pending.push(stop, distance(0, stop));
+    }
+
+    while (!pending.empty()) {
+        int closest = pending.extractMin();
+        route.push_back(closest);
+        // we moved, so every pending stop now has a new distance
+        pending.updateAll(distances[closest]);
+    }
+    return route;
+}
+
+/**
+ * Start from the greedy route and keep applying 2-opt and Or-opt moves until neither improves the route
+ * or the time budget (or the pass limit) runs out
+ * @return the improved route
+ */
+std::vector<int> RouteOptimizer::localSearch() {
+    std::vector<int> route = nearestNeighbour();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeBudgetMs);
+
+    bool improved = true;
+    for (int pass = 0; improved && (maxPasses > 0 ? pass < maxPasses : std::chrono::steady_clock::now() < deadline); pass++) {
+        improved = twoOpt(route);
+        if (orOpt(route)) {
+            improved = true;
+        }
+    }
+    return route;
+}
+
+/**
+ * One pass of 2-opt, reverses any section of the route that makes it shorter
+ * distances are assumed to be symmetric (true for shortest paths on our road grid)
+ * @param route the route to improve in place
+ * @return true if the route was improved
+ */
+bool RouteOptimizer::twoOpt(std::vector<int>& route) {
+    bool improved = false;
+    int size = route.size();
+    for (int i = 1; i < size - 1; i++) {
+        for (int j = i + 1; j < size; j++) {
+            int after = j + 1 < size ? route[j + 1] : -1;
+            int oldLength = distance(route[i - 1], route[i]) + distance(route[j], after);
+            int newLength = distance(route[i - 1], route[j]) + distance(route[i], after);
+            if (newLength < oldLength) {
+                std::reverse(route.begin() + i, route.begin() + j + 1);
+                improved = true;
+            }
+        }
+    }
+    return improved;
+}
+
+/**
+ * One pass of Or-opt, moves short chains of 1 to 3 stops (possibly reversed) to a cheaper spot in the route
+ * @param route the route to improve in place
+ * @return true if the route was improved
+ */
+bool RouteOptimizer::orOpt(std::vector<int>& route) {
+    bool improved = false;
+    for (int chain = 1; chain <= 3; chain++) {
+        for (int i = 1; i + chain <= route.size(); i++) {
+            int size = route.size();
+            int first = route[i];
+            int last = route[i + chain - 1];
+            int before = route[i - 1];
+            int after = i + chain < size ? route[i + chain] : -1;
+
+            // how much shorter the route gets when the chain is taken out
+            int removeGain = distance(before, first) + distance(last, after) - distance(before, after);
+
+            // try putting the chain between every pair of stops a -> b that are not part of it
+            for (int j = 0; j < size; j++) {
+                if (j >= i - 1 && j < i + chain) {
+                    continue;
+                }
+                int a = route[j];
+                int b = j + 1 < size ? route[j + 1] : -1;
+                int forward = distance(a, first) + distance(last, b) - distance(a, b);
+                int backward = distance(a, last) + distance(first, b) - distance(a, b);
+                if (std::min(forward, backward) < removeGain) {
+                    std::vector<int> moved(route.begin() + i, route.begin() + i + chain);
+                    if (backward < forward) {
+                        std::reverse(moved.begin(), moved.end());
+                    }
+                    route.erase(route.begin() + i, route.begin() + i + chain);
+                    int insertAt = j < i ? j + 1 : j + 1 - chain;
+                    route.insert(route.begin() + insertAt, moved.begin(), moved.end());
+                    improved = true;
+                    break;
+                }
+            }
+        }
+    }
+    return improved;
+}
@@ -0,0 +1,37 @@
+#ifndef ROUTEOPTIMIZER_H
+#define ROUTEOPTIMIZER_H
+
+#include <vector>
+
+/*
+ * Route optimizer, given a matrix of distances between stops finds the order to visit every stop in
+ * Stop 0 is always the starting point (the hub) and the route ends at the last stop visited
+ * Small stop counts are solved exactly with Held-Karp, larger ones use 2-opt and Or-opt local search with a time budget
+ * or, when the result has to be the same on every run, a fixed number of passes
+ */
+class RouteOptimizer {
+public:
+    RouteOptimizer(const std::vector<std::vector<int>>& distances, int timeBudgetMs = 100, int maxPasses = 0);
+
+    std::vector<int> solve();
+    int routeLength(const std::vector<int>& route) const;
+
+    // the largest amount of stops (not counting the start) that Held-Karp will be used for
+    static const int HELD_KARP_LIMIT = 13;
+
+private:
+    std::vector<std::vector<int>> distances;
+    int stops;
+    int timeBudgetMs;
+    int maxPasses;
+
+    int distance(int from, int to) const;
+
+    std::vector<int> heldKarp();
+    std::vector<int> nearestNeighbour();
+    std::vector<int> localSearch();
+    bool twoOpt(std::vector<int>& route);
+    bool orOpt(std::vector<int>& route);
+};
+
+#endif
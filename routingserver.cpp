@@ -0,0 +1,470 @@
+#include "routingserver.h"
+#include "metrics.h"
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+/**
+ * Constructor for the server, every road starts out with the rush hour traffic profile
+ * @param session the map to answer queries about, it is kept hot for the whole lifetime of the server
+ * @param shards optional router over the same map split across worker processes, it has to outlive the server
+ */
+RoutingServer::RoutingServer(CitySession& session, ShardedRouter* shards)
+    : session(session), closures(session.getHeight(), session.getWidth(), session.getSnapshot().getPassable()),
+      shards(shards), traffic(session.getHeight(), session.getWidth()),
+      trafficRouter(session.getHeight(), session.getWidth(), session.getSnapshot().getPassable(), traffic) {
+    // the same peaks the benchmark uses, JAM is for the few roads that are much worse than the rest
+    rushProfile = traffic.addProfile(TrafficProfiles::rushHour(traffic.getFreeFlowSeconds(), 3, 2.5));
+    jamProfile = traffic.addProfile(TrafficProfiles::rushHour(traffic.getFreeFlowSeconds(), 8, 6));
+    for (int y = 0; y < session.getHeight(); y++) {
+        traffic.setSegmentProfile(0, y, session.getWidth() - 1, y, rushProfile);
+    }
+}
+
+/**
+ * Check a cell is on the map and can be driven on right now, closures included
+ */
+bool RoutingServer::isRoad(int x, int y) const {
+    return closures.isValid(x, y) && closures.getCost(x, y) != DynamicRouter::BLOCKED;
+}
+
+/**
+ * Answer a single query
+ * @param line the query, a command followed by its arguments separated by spaces
+ * @return the reply without a trailing new line
+ */
+std::string RoutingServer::handle(const std::string& line) {
+    METRICS_TIMER("server.query");
+    std::istringstream arguments(line);
+    std::string command;
+    if (!(arguments >> command)) {
+        return "ERR empty query";
+    }
+
+    if (command == "ROUTE") {
+        return route(arguments);
+    } else if (command == "DISTANCE") {
+        return distance(arguments);
+    } else if (command == "ETA") {
+        return eta(arguments);
+    } else if (command == "TRAFFIC") {
+        return setTraffic(arguments);
+    } else if (command == "NEAREST") {
+        return nearest(arguments);
+    } else if (command == "REACHABLE") {
+        return reachable(arguments);
+    } else if (command == "BLOCK" || command == "UNBLOCK" || command == "COST") {
+        return changeCost(command, arguments);
+    } else if (command == "WATCH") {
+        return watch(arguments);
+    } else if (command == "PATH") {
+        return watchedPath(arguments);
+    } else if (command == "UNWATCH") {
+        int route;
+        if (!(arguments >> route) || !closures.isWatched(route)) {
+            return "ERR usage: UNWATCH id";
+        }
+        closures.unwatch(route);
+        return "OK";
+    } else if (command == "HUBS") {
+        return hubs();
+    } else if (command == "PING") {
+        return "OK";
+    } else if (command == "QUIT") {
+        closing = true;
+        return "OK";
+    } else if (command == "SHUTDOWN") {
+        closing = true;
+        stopping = true;
+        return "OK";
+    }
+    return "ERR unknown command " + command;
+}
+
+std::string RoutingServer::route(std::istringstream& arguments) {
+    int startX, startY, endX, endY;
+    if (!(arguments >> startX >> startY >> endX >> endY)) {
+        return "ERR usage: ROUTE x1 y1 x2 y2 [RUNS] [AT seconds]";
+    }
+    bool runs = false;
+    int departure = -1;
+    std::string option;
+    while (arguments >> option) {
+        if (option == "RUNS") {
+            runs = true;
+        } else if (option == "AT" && (!(arguments >> departure) || departure < 0 || departure >= TrafficProfiles::DAY)) {
+            return "ERR usage: ROUTE x1 y1 x2 y2 [RUNS] [AT seconds]";
+        }
+    }
+    if (!isRoad(startX, startY) || !isRoad(endX, endY)) {
+        return "ERR not a road";
+    }
+    // the plain search is faster, it is only wrong once roads have been closed or their costs changed
+    CompactPath path;
+    int seconds = -1;
+    if (departure >= 0) {
+        int arrival;
+        std::vector<std::pair<int, int>> cells = trafficRouter.findFastestPath(startX, startY, endX, endY, departure, arrival);
+        if (arrival == TimeDependentRouter::UNREACHABLE) {
+            return "ERR unreachable";
+        }
+        path = CompactPath::fromCells(cells);
+        seconds = arrival - departure;
+    } else if (closures.isModified()) {
+        std::vector<std::pair<int, int>> cells = closures.findShortestPath(startX, startY, endX, endY);
+        if (cells.empty()) {
+            return "ERR unreachable";
+        }
+        path = CompactPath::fromCells(cells);
+    } else if (shards) {
+        path = shards->findShortestPath(startX, startY, endX, endY);
+        if (path.size() == 1 && (startX != endX || startY != endY)) {
+            return "ERR unreachable";
+        }
+    } else {
+        path = session.getRouter().findCompactPath(startX, startY, endX, endY);
+        if (path.size() == 1 && (startX != endX || startY != endY)) {
+            return "ERR unreachable";
+        }
+    }
+
+    std::ostringstream reply;
+    reply << "OK ";
+    if (seconds >= 0) {
+        reply << seconds << " ";
+    }
+    reply << path.size();
+    if (runs) {
+        reply << " " << path.front().first << " " << path.front().second << " " << path.getRunCount();
+        if (path.getRunCount() > 0) {
+            reply << " " << path.toRunString();
+        }
+        return reply.str();
+    }
+    for (const std::pair<int, int>& cell : path) {
+        reply << " " << cell.first << " " << cell.second;
+    }
+    return reply.str();
+}
+
+std::string RoutingServer::distance(std::istringstream& arguments) {
+    int startX, startY;
+    if (!(arguments >> startX >> startY)) {
+        return "ERR usage: DISTANCE x y x1 y1 [x2 y2 ...]";
+    }
+    std::vector<std::pair<int, int>> targets;
+    int x, y;
+    while (arguments >> x >> y) {
+        if (!isRoad(x, y)) {
+            return "ERR not a road";
+        }
+        targets.push_back(std::make_pair(x, y));
+    }
+    if (targets.empty()) {
+        return "ERR usage: DISTANCE x y x1 y1 [x2 y2 ...]";
+    }
+    if (!isRoad(startX, startY)) {
+        return "ERR not a road";
+    }
+
+    std::ostringstream reply;
+    reply << "OK";
+    if (closures.isModified()) {
+        // with closures every distance is cached until a change could affect it
+        for (const std::pair<int, int>& target : targets) {
+            int cost = closures.findDistance(startX, startY, target.first, target.second);
+            reply << " " << (cost == DynamicRouter::UNREACHABLE ? -1 : cost);
+        }
+        return reply.str();
+    }
+    if (shards) {
+        // the shards of all the targets search at the same time
+        std::vector<ShardedRouter::Query> queries;
+        for (const std::pair<int, int>& target : targets) {
+            queries.push_back(ShardedRouter::Query(std::make_pair(startX, startY), target));
+        }
+        for (int steps : shards->findDistances(queries)) {
+            reply << " " << (steps == ShardedRouter::UNREACHABLE ? -1 : steps);
+        }
+        return reply.str();
+    }
+    // every target comes out of a single search
+    std::vector<int> distances = session.getRouter().findDistances(startX, startY, targets);
+    for (int steps : distances) {
+        reply << " " << (steps == Dijkstra::UNREACHABLE ? -1 : steps);
+    }
+    return reply.str();
+}
+
+std::string RoutingServer::eta(std::istringstream& arguments) {
+    // the coordinates end at the first word that isnt a number, which has to be AT
+    std::vector<int> numbers;
+    int number;
+    while (arguments >> number) {
+        numbers.push_back(number);
+    }
+    arguments.clear();
+    std::string at;
+    int departure;
+    if (numbers.size() < 4 || numbers.size() % 2 != 0 || !(arguments >> at >> departure) || at != "AT" ||
+        departure < 0 || departure >= TrafficProfiles::DAY) {
+        return "ERR usage: ETA x y x1 y1 [x2 y2 ...] AT seconds";
+    }
+    std::vector<std::pair<int, int>> targets;
+    for (int i = 2; i < numbers.size(); i += 2) {
+        if (!isRoad(numbers[i], numbers[i + 1])) {
+            return "ERR not a road";
+        }
+        targets.push_back(std::make_pair(numbers[i], numbers[i + 1]));
+    }
+    if (!isRoad(numbers[0], numbers[1])) {
+        return "ERR not a road";
+    }
+
+    // every target comes out of a single search
+    std::ostringstream reply;
+    reply << "OK";
+    for (int arrival : trafficRouter.findArrivalTimes(numbers[0], numbers[1], departure, targets)) {
+        reply << " " << (arrival == TimeDependentRouter::UNREACHABLE ? -1 : arrival - departure);
+    }
+    return reply.str();
+}
+
+std::string RoutingServer::setTraffic(std::istringstream& arguments) {
+    int x1, y1, x2, y2;
+    std::string level;
+    if (!(arguments >> x1 >> y1 >> x2 >> y2 >> level)) {
+        return "ERR usage: TRAFFIC x1 y1 x2 y2 FREE|RUSH|JAM";
+    }
+    int profile;
+    if (level == "FREE") {
+        profile = TrafficProfiles::FREE_FLOW;
+    } else if (level == "RUSH") {
+        profile = rushProfile;
+    } else if (level == "JAM") {
+        profile = jamProfile;
+    } else {
+        return "ERR usage: TRAFFIC x1 y1 x2 y2 FREE|RUSH|JAM";
+    }
+    int cells = traffic.setSegmentProfile(x1, y1, x2, y2, profile);
+    if (cells == -1) {
+        return "ERR the segment has to be horizontal or vertical and on the map";
+    }
+    return "OK " + std::to_string(cells);
+}
+
+std::string RoutingServer::nearest(std::istringstream& arguments) {
+    int x, y;
+    if (!(arguments >> x >> y)) {
+        return "ERR usage: NEAREST x y [count]";
+    }
+    int count = 1;
+    if (!(arguments >> count)) {
+        count = 1;
+    }
+    if (count <= 0) {
+        return "ERR count must be positive";
+    }
+
+    std::vector<FlatPoint> houses = session.findNearestHouses(x, y, count);
+    std::ostringstream reply;
+    reply << "OK " << houses.size();
+    for (const FlatPoint& house : houses) {
+        reply << " " << house.x << " " << house.y << " " << house.value;
+    }
+    return reply.str();
+}
+
+std::string RoutingServer::reachable(std::istringstream& arguments) {
+    int x, y, steps;
+    if (!(arguments >> x >> y >> steps) || steps < 0) {
+        return "ERR usage: REACHABLE x y steps";
+    }
+    if (!isRoad(x, y)) {
+        return "ERR not a road";
+    }
+
+    // once roads have been closed the search has to go around them, a COST change still counts as one step
+    std::vector<std::pair<FlatPoint, int>> houses;
+    if (closures.isModified()) {
+        houses = session.findReachableHouses(x, y, steps, [this](int x, int y) { return isRoad(x, y); });
+    } else {
+        houses = session.findReachableHouses(x, y, steps);
+    }
+    std::ostringstream reply;
+    reply << "OK " << houses.size();
+    for (const std::pair<FlatPoint, int>& house : houses) {
+        reply << " " << house.first.x << " " << house.first.y << " " << house.first.value << " " << house.second;
+    }
+    return reply.str();
+}
+
+std::string RoutingServer::changeCost(const std::string& command, std::istringstream& arguments) {
+    int x, y;
+    if (!(arguments >> x >> y) || !closures.isValid(x, y)) {
+        return "ERR usage: " + command + " x y" + (command == "COST" ? " cost" : "");
+    }
+    // the traffic router keeps its own copy of which cells are roads
+    if (command == "BLOCK") {
+        closures.block(x, y);
+        trafficRouter.setPassable(x, y, false);
+    } else if (command == "UNBLOCK") {
+        closures.unblock(x, y);
+        trafficRouter.setPassable(x, y, true);
+    } else {
+        int cost;
+        if (!(arguments >> cost) || cost < 1 || cost > 65535) {
+            return "ERR cost must be from 1 to 65535";
+        }
+        closures.setCost(x, y, cost);
+    }
+    return "OK";
+}
+
+std::string RoutingServer::watch(std::istringstream& arguments) {
+    int startX, startY, endX, endY;
+    if (!(arguments >> startX >> startY >> endX >> endY)) {
+        return "ERR usage: WATCH x1 y1 x2 y2";
+    }
+    if (!isRoad(startX, startY) || !isRoad(endX, endY)) {
+        return "ERR not a road";
+    }
+    return "OK " + std::to_string(closures.watch(startX, startY, endX, endY));
+}
+
+std::string RoutingServer::watchedPath(std::istringstream& arguments) {
+    int route;
+    if (!(arguments >> route) || !closures.isWatched(route)) {
+        return "ERR usage: PATH id";
+    }
+    std::vector<std::pair<int, int>> path = closures.getPath(route);
+    if (path.empty()) {
+        return "ERR unreachable";
+    }
+    std::ostringstream reply;
+    reply << "OK " << closures.getDistance(route) << " " << path.size();
+    for (const std::pair<int, int>& cell : path) {
+        reply << " " << cell.first << " " << cell.second;
+    }
+    return reply.str();
+}
+
+std::string RoutingServer::hubs() {
+    std::ostringstream reply;
+    reply << "OK " << session.getHubs().size();
+    for (const std::pair<int,int>& hub : session.getHubs()) {
+        reply << " " << hub.second << " " << hub.first;
+    }
+    return reply.str();
+}
+
+/**
+ * Answer queries from a stream until it ends or QUIT is sent, every reply is flushed straight away so the other end
+ * can wait for it
+ * @param in where the queries come from, usually std::cin
+ * @param out where the replies go, usually std::cout
+ */
+void RoutingServer::serve(std::istream& in, std::ostream& out) {
+    closing = false;
+    std::string line;
+    while (!closing && std::getline(in, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        out << handle(line) << std::endl;
+    }
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+/**
+ * Write all of a reply to a socket, send can write less than asked for
+ */
+static bool writeAll(int socket, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        int flags = 0;
+#ifdef MSG_NOSIGNAL
+        flags = MSG_NOSIGNAL; // a client hanging up shouldnt kill the server
+#endif
+        ssize_t written = send(socket, data.data() + sent, data.size() - sent, flags);
+        if (written <= 0) {
+            return false;
+        }
+        sent += written;
+    }
+    return true;
+}
+
+/**
+ * Listen on a unix domain socket and answer queries from one client at a time until SHUTDOWN is sent
+ * @param path where to create the socket, an old socket at the same path is replaced
+ * @return false if the socket could not be created
+ */
+bool RoutingServer::serveSocket(const std::string& path) {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path too long: " << path << std::endl;
+        return false;
+    }
+    std::strcpy(address.sun_path, path.c_str());
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        std::cerr << "Error creating socket." << std::endl;
+        return false;
+    }
+    unlink(path.c_str());
+    if (bind(listener, (sockaddr*)&address, sizeof(address)) < 0 || listen(listener, 8) < 0) {
+        std::cerr << "Error listening on " << path << std::endl;
+        close(listener);
+        return false;
+    }
+
+    stopping = false;
+    while (!stopping) {
+        int client = accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            continue;
+        }
+        // queries can arrive split over several reads or several in one read, so split them on new lines ourselves
+        closing = false;
+        std::string pending;
+        char chunk[4096];
+        while (!closing) {
+            ssize_t received = read(client, chunk, sizeof(chunk));
+            if (received <= 0) {
+                break;
+            }
+            pending.append(chunk, received);
+            size_t end;
+            while (!closing && (end = pending.find('\n')) != std::string::npos) {
+                std::string line = pending.substr(0, end);
+                pending.erase(0, end + 1);
+                if (!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+                if (!line.empty() && !writeAll(client, handle(line) + "\n")) {
+                    closing = true;
+                }
+            }
+        }
+        close(client);
+    }
+    close(listener);
+    unlink(path.c_str());
+    return true;
+}
+#else
+bool RoutingServer::serveSocket(const std::string& path) {
+    std::cerr << "Unix domain sockets are not supported on this platform, use --serve stdin" << std::endl;
+    return false;
+}
+#endif
@@ -0,0 +1,73 @@
+#ifndef ROUTINGSERVER_H
+#define ROUTINGSERVER_H
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "citysession.h"
+#include "dynamicrouter.h"
+#include "shardedrouter.h"
+#include "timedependentrouter.h"
+#include "trafficprofile.h"
+
+/*
+ * Long running server that answers route, distance and nearest house queries against a session that is only built
+ * once. Queries are one line of text each and every query gets exactly one line back, starting with OK or ERR.
+ * Coordinates are "x y" (column then row) like the path output. Once a road has been closed or had its cost changed
+ * ROUTE and DISTANCE go through the dynamic router and DISTANCE reports costs instead of steps.
+ * REACHABLE drives around closed roads but counts every step as one. With a sharded router (main --shards) ROUTE
+ * and DISTANCE are answered by the shard processes until the first change.
+ * Queries with AT use travel times in seconds from the traffic profiles instead. Every road starts out with the rush
+ * hour profile and TRAFFIC changes it for a straight segment, closures are followed but COST is not
+ *
+ *   ROUTE x1 y1 x2 y2              OK <cells> x y x y ...        the shortest path, start and end included
+ *   ROUTE x1 y1 x2 y2 RUNS         OK <cells> x y <runs> D n ...  the same path as its start and runs of L R U D steps
+ *   ROUTE x1 y1 x2 y2 AT seconds   OK <seconds> <cells> x y ...  the fastest path leaving at seconds after midnight
+ *   DISTANCE x y x1 y1 [x2 y2 ...] OK d1 d2 ...                  steps from x y to every target, -1 if unreachable
+ *   ETA x y x1 y1 [...] AT seconds OK t1 t2 ...                  seconds to every target leaving then, -1 if unreachable
+ *   TRAFFIC x1 y1 x2 y2 level      OK <cells>                    FREE, RUSH or JAM for a horizontal or vertical segment
+ *   NEAREST x y [count]            OK <found> x y house ...      closest houses by manhattan distance
+ *   REACHABLE x y steps            OK <found> x y house steps ...  houses within steps of x y, closest first
+ *   BLOCK x y / UNBLOCK x y        OK                            close or reopen a road cell
+ *   COST x y cost                  OK                            cost of driving into a cell (1 - 65535, normally 1)
+ *   WATCH x1 y1 x2 y2              OK <id>                       keep a route that is repaired after every change
+ *   PATH id                        OK <cost> <cells> x y ...     the current path of a watched route
+ *   UNWATCH id                     OK
+ *   HUBS                           OK <hubs> x y ...
+ *   PING                           OK
+ *   QUIT                           OK, then the connection (or stdin session) ends
+ *   SHUTDOWN                       OK, then the socket server stops
+ */
+class RoutingServer {
+public:
+    explicit RoutingServer(CitySession& session, ShardedRouter* shards = nullptr);
+
+    std::string handle(const std::string& line);
+    void serve(std::istream& in, std::ostream& out);
+    bool serveSocket(const std::string& path);
+
+private:
+    CitySession& session;
+    DynamicRouter closures;
+    ShardedRouter* shards;
+    TrafficProfiles traffic;
+    TimeDependentRouter trafficRouter;
+    int rushProfile;
+    int jamProfile;
+    bool closing = false;
+    bool stopping = false;
+
+    std::string route(std::istringstream& arguments);
+    std::string distance(std::istringstream& arguments);
+    std::string eta(std::istringstream& arguments);
+    std::string setTraffic(std::istringstream& arguments);
+    std::string nearest(std::istringstream& arguments);
+    std::string reachable(std::istringstream& arguments);
+    std::string changeCost(const std::string& command, std::istringstream& arguments);
+    std::string watch(std::istringstream& arguments);
+    std::string watchedPath(std::istringstream& arguments);
+    std::string hubs();
+    bool isRoad(int x, int y) const;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#include "searchtree.h"
+#include <utility>
+#include <vector>
+
+SearchTree::SearchTree() : cols(0), startX(0), startY(0) {
+}
+
+/**
+ * Constructor, keeps a copy of the search state so the Dijkstra it came from can go on to the next search
+ * @param cols the amount of collumns in the grid
+ * @param startX the x the search started from
+ * @param startY the y the search started from
+ * @param reached the visited bitset of the search
+ * @param parents the 2 bit parent directions of the search
+ * @param distances the distance to every target of the search
+ */
+SearchTree::SearchTree(int cols, int startX, int startY, const std::vector<uint64_t>& reached, const std::vector<uint8_t>& parents,
+                       const std::vector<int>& distances)
+    : cols(cols), startX(startX), startY(startY), reached(reached), parents(parents), distances(distances) {
+}
+
+/**
+ * Walk the 2 bit parent directions backwards from the end until we are back at the start, a run at a time
+ * @param parents the parent directions packed 4 to a byte, the end has to have been reached by the search
+ * @param cols the amount of collumns in the grid
+ * @return the path from start to end
+ */
+CompactPath SearchTree::buildPath(const std::vector<uint8_t>& parents, int cols, int startX, int startY, int endX, int endY) {
+    return walkParents(startX, startY, endX, endY, [&](int x, int y) {
+        int index = y * cols + x;
+        return (parents[index >> 2] >> ((index & 3) * 2)) & 3;
+    });
+}
+
+/**
+ * @param target the index of the target in the list the search was given
+ * @return the amount of steps to it, Dijkstra::UNREACHABLE if the search didnt reach it
+ */
+int SearchTree::getDistance(int target) const {
+    return distances[target];
+}
+
+const std::vector<int>& SearchTree::getDistances() const {
+    return distances;
+}
+
+/**
+ * @return true if the search reached the cell, every target it reached and every cell on their paths is
+ */
+bool SearchTree::isReached(int x, int y) const {
+    int index = y * cols + x;
+    return (reached[index >> 6] >> (index & 63)) & 1;
+}
+
+/**
+ * Path from the start of the search to a cell without searching again
+ * @return the path from start to end, just the end cell if the search didnt reach it (like Dijkstra::findCompactPath)
+ */
+CompactPath SearchTree::getPath(int endX, int endY) const {
+    if (!isReached(endX, endY)) {
+        return CompactPath(endX, endY);
+    }
+    return buildPath(parents, cols, startX, startY, endX, endY);
+}
@@ -0,0 +1,68 @@
+#ifndef SEARCHTREE_H
+#define SEARCHTREE_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "compactpath.h"
+#include "directions.h"
+
+/*
+ * What a one to many Dijkstra search leaves behind: the distance to each of its targets and the tree of parent
+ * directions it grew on the way. The path to any cell the search reached can be walked back out of the tree later
+ * without searching again, so a tour that was planned from one search per stop can be driven from those same
+ * searches. The tree is 3 bits per cell (2 for the parent direction and 1 for reached), 24 KB for a 256x256 city.
+ * Coordinates are (x, y) like Dijkstra
+ */
+class SearchTree {
+public:
+    SearchTree();
+    SearchTree(int cols, int startX, int startY, const std::vector<uint64_t>& reached, const std::vector<uint8_t>& parents,
+               const std::vector<int>& distances);
+
+    static CompactPath buildPath(const std::vector<uint8_t>& parents, int cols, int startX, int startY, int endX, int endY);
+
+    int getDistance(int target) const;
+    const std::vector<int>& getDistances() const;
+    bool isReached(int x, int y) const;
+    CompactPath getPath(int endX, int endY) const;
+
+private:
+    int cols;
+    int startX;
+    int startY;
+    // same packing as Dijkstra, 1 bit per cell for reached and 2 bits per cell for the parent direction
+    std::vector<uint64_t> reached;
+    std::vector<uint8_t> parents;
+    std::vector<int> distances;
+};
+
+/**
+ * Walk the parent directions of a search back from the end until we are at the start, a run at a time, and turn them
+ * into a path. Every search keeps its parents its own way, parentOf(x, y) reads the direction that reached a cell
+ * @param parentOf called with the x and y of every cell on the path except the start
+ * @return the path from start to end, the end has to have been reached by the search
+ */
+template <typename ParentOf>
+CompactPath walkParents(int startX, int startY, int endX, int endY, ParentOf parentOf) {
+    std::vector<std::pair<int, uint32_t>> reversedRuns;
+    int x = endX;
+    int y = endY;
+    while (x != startX || y != startY) {
+        int direction = parentOf(x, y);
+        if (reversedRuns.empty() || reversedRuns.back().first != direction) {
+            reversedRuns.push_back(std::make_pair(direction, 0));
+        }
+        reversedRuns.back().second++;
+        x -= DIRECTION_X[direction];
+        y -= DIRECTION_Y[direction];
+    }
+
+    CompactPath path(startX, startY);
+    for (auto run = reversedRuns.rbegin(); run != reversedRuns.rend(); ++run) {
+        path.append(run->first, run->second);
+    }
+    return path;
+}
+
+#endif
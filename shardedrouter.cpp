@@ -0,0 +1,767 @@
+#include "shardedrouter.h"
+#include "metrics.h"
+#include "directions.h"
+#include "searchtree.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define SHARDEDROUTER_FORK
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#endif
+
+// what the coordinator asks a worker, the first int of every message. cells are global (y * cols + x)
+static const int32_t REQUEST_BOUNDARY = 1;  // -> count, every boundary cell, then count * count distances (-1 if none)
+static const int32_t REQUEST_DISTANCES = 2; // n, (x, y, tx, ty) * n -> per query the distance to every boundary cell
+                                            // then to tx ty (-1 if none or tx is -1)
+static const int32_t REQUEST_PATHS = 3;     // n, (x1, y1, x2, y2) * n -> per path the run count (-1 if none)
+                                            // then (direction, length) for every run
+static const int32_t REQUEST_QUIT = 4;
+
+const int ShardedRouter::UNREACHABLE;
+const int ShardedRouter::MAX_SHARDS_PER_SIDE;
+
+static bool isSet(const uint64_t* bits, long long index) {
+    return (bits[index >> 6] >> (index & 63)) & 1;
+}
+
+/*
+ * One shard of the map, normally in its own process. It searches only the cells of its shard (its own copy of them)
+ * and answers the coordinators requests with breadth first searches that never leave the shard
+ */
+class ShardWorker {
+public:
+    ShardWorker(int rows, int cols, const uint64_t* passable, int left, int top, int right, int bottom);
+    std::vector<int32_t> handle(const std::vector<int32_t>& message);
+#ifdef SHARDEDROUTER_FORK
+    void serve(int socket);
+#endif
+
+private:
+    int cols;
+    int left;
+    int top;
+    int width;
+    int height;
+    std::vector<uint8_t> road;
+    // local index (y * width + x inside the shard) of every boundary cell
+    std::vector<int> boundary;
+    // scratch for the searches
+    std::vector<int> distances;
+    std::vector<uint8_t> parents;
+    std::vector<int> queue;
+
+    int localIndex(int x, int y) const;
+    void search(int from, int to);
+};
+
+#ifdef SHARDEDROUTER_FORK
+static bool writeAll(int socket, const char* bytes, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::send(socket, bytes, size, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+static bool readAll(int socket, char* bytes, size_t size) {
+    while (size > 0) {
+        ssize_t received = ::read(socket, bytes, size);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        bytes += received;
+        size -= received;
+    }
+    return true;
+}
+
+/**
+ * Send a message as its length followed by its ints
+ */
+static bool sendMessage(int socket, const std::vector<int32_t>& message) {
+    uint32_t count = message.size();
+    return writeAll(socket, (const char*)&count, sizeof(count)) &&
+           writeAll(socket, (const char*)message.data(), count * sizeof(int32_t));
+}
+
+static bool receiveMessage(int socket, std::vector<int32_t>& message) {
+    uint32_t count;
+    if (!readAll(socket, (char*)&count, sizeof(count))) {
+        return false;
+    }
+    message.resize(count);
+    return count == 0 || readAll(socket, (char*)message.data(), count * sizeof(int32_t));
+}
+#endif
+
+/**
+ * Constructor, copies the cells of the shard and finds its boundary cells
+ * @param rows the amount of rows in the whole map
+ * @param cols the amount of collumns in the whole map
+ * @param passable (rows * cols + 63) / 64 words for the whole map, only the shard and the cells around it are read
+ * @param left the first collumn of the shard
+ * @param top the first row of the shard
+ * @param right one past the last collumn
+ * @param bottom one past the last row
+ */
+ShardWorker::ShardWorker(int rows, int cols, const uint64_t* passable, int left, int top, int right, int bottom) {
+    this->cols = cols;
+    this->left = left;
+    this->top = top;
+    width = right - left;
+    height = bottom - top;
+    road = std::vector<uint8_t>((size_t)width * height, 0);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            road[y * width + x] = isSet(passable, (long long)(top + y) * cols + left + x);
+        }
+    }
+    // a boundary cell is a road with a road right next to it on the other side of the shard border
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            if (!road[y * width + x]) {
+                continue;
+            }
+            for (int direction = 0; direction < 4; direction++) {
+                int globalX = left + x + DIRECTION_X[direction];
+                int globalY = top + y + DIRECTION_Y[direction];
+                bool outside = localIndex(globalX, globalY) < 0;
+                if (outside && globalX >= 0 && globalX < cols && globalY >= 0 && globalY < rows &&
+                    isSet(passable, (long long)globalY * cols + globalX)) {
+                    boundary.push_back(y * width + x);
+                    break;
+                }
+            }
+        }
+    }
+    distances = std::vector<int>((size_t)width * height, -1);
+    parents = std::vector<uint8_t>((size_t)width * height, 0);
+    queue.reserve((size_t)width * height);
+}
+
+/**
+ * @return the local index of a global cell, -1 if it isnt in the shard
+ */
+int ShardWorker::localIndex(int x, int y) const {
+    if (x < left || x >= left + width || y < top || y >= top + height) {
+        return -1;
+    }
+    return (y - top) * width + x - left;
+}
+
+/**
+ * Breadth first search inside the shard, leaves the distances (-1 if not reached) and parent directions behind
+ * @param from the local cell to start from
+ * @param to stop once this local cell is reached, -1 to search the whole shard
+ */
+void ShardWorker::search(int from, int to) {
+    std::fill(distances.begin(), distances.end(), -1);
+    queue.clear();
+    queue.push_back(from);
+    distances[from] = 0;
+    for (size_t head = 0; head < queue.size(); head++) {
+        int index = queue[head];
+        if (index == to) {
+            break;
+        }
+        int x = index % width;
+        int y = index / width;
+        for (int direction = 0; direction < 4; direction++) {
+            int newX = x + DIRECTION_X[direction];
+            int newY = y + DIRECTION_Y[direction];
+            if (newX < 0 || newX >= width || newY < 0 || newY >= height) {
+                continue;
+            }
+            int newIndex = newY * width + newX;
+            if (road[newIndex] && distances[newIndex] < 0) {
+                distances[newIndex] = distances[index] + 1;
+                parents[newIndex] = direction;
+                queue.push_back(newIndex);
+            }
+        }
+    }
+}
+
+/**
+ * Answer one request from the coordinator
+ * @param message the request, see the REQUEST_ constants
+ * @return the reply, empty for a request it doesnt know
+ */
+std::vector<int32_t> ShardWorker::handle(const std::vector<int32_t>& message) {
+    std::vector<int32_t> reply;
+    if (message.empty()) {
+        return reply;
+    }
+    if (message[0] == REQUEST_BOUNDARY) {
+        reply.push_back(boundary.size());
+        for (int cell : boundary) {
+            reply.push_back((top + cell / width) * cols + left + cell % width);
+        }
+        for (int cell : boundary) {
+            search(cell, -1);
+            for (int other : boundary) {
+                reply.push_back(distances[other]);
+            }
+        }
+    } else if (message[0] == REQUEST_DISTANCES && message.size() >= 2) {
+        for (int query = 0; query < message[1] && 2 + query * 4 + 3 < message.size(); query++) {
+            const int32_t* values = &message[2 + query * 4];
+            int from = localIndex(values[0], values[1]);
+            int to = values[2] < 0 ? -1 : localIndex(values[2], values[3]);
+            if (from < 0 || !road[from]) {
+                reply.insert(reply.end(), boundary.size() + 1, -1);
+                continue;
+            }
+            search(from, -1);
+            for (int cell : boundary) {
+                reply.push_back(distances[cell]);
+            }
+            reply.push_back(to < 0 ? -1 : distances[to]);
+        }
+    } else if (message[0] == REQUEST_PATHS && message.size() >= 2) {
+        for (int path = 0; path < message[1] && 2 + path * 4 + 3 < message.size(); path++) {
+            const int32_t* values = &message[2 + path * 4];
+            int from = localIndex(values[0], values[1]);
+            int to = localIndex(values[2], values[3]);
+            if (from < 0 || to < 0 || !road[from]) {
+                reply.push_back(-1);
+                continue;
+            }
+            search(from, to);
+            if (distances[to] < 0) {
+                reply.push_back(-1);
+                continue;
+            }
+            // walk the parents back from the end, then send the runs start first
+            CompactPath runs = walkParents(from % width, from / width, to % width, to / width,
+                                           [this](int x, int y) { return (int)parents[y * width + x]; });
+            reply.push_back(runs.getRunCount());
+            for (size_t run = 0; run < runs.getRunCount(); run++) {
+                reply.push_back(runs.getRunDirection(run));
+                reply.push_back(runs.getRunLength(run));
+            }
+        }
+    }
+    return reply;
+}
+
+#ifdef SHARDEDROUTER_FORK
+/**
+ * Answer requests until the coordinator says to quit or goes away
+ */
+void ShardWorker::serve(int socket) {
+    std::vector<int32_t> message;
+    while (receiveMessage(socket, message) && !(message.size() == 1 && message[0] == REQUEST_QUIT)) {
+        if (!sendMessage(socket, handle(message))) {
+            return;
+        }
+    }
+}
+#endif
+
+/**
+ * Constructor, starts a worker for every shard and builds the boundary graph from what they send back
+ * @param rows the amount of rows in the grid
+ * @param cols the amount of collumns in the grid
+ * @param passable (rows * cols + 63) / 64 words, bit i is set if cell i can be driven on. only read while the
+ *                 workers start, every worker copies just its own shard out of it
+ * @param shardRows how many shards to cut the map into from top to bottom
+ * @param shardCols how many shards to cut the map into from left to right
+ */
+ShardedRouter::ShardedRouter(int rows, int cols, const uint64_t* passable, int shardRows, int shardCols) {
+    METRICS_TIMER("sharded_router.build");
+    this->rows = rows;
+    this->cols = cols;
+    this->shardRows = std::max(1, std::min(shardRows, rows));
+    this->shardCols = std::max(1, std::min(shardCols, cols));
+    for (int row = 0; row < this->shardRows; row++) {
+        for (int col = 0; col < this->shardCols; col++) {
+            Shard shard;
+            shard.left = (long long)col * cols / this->shardCols;
+            shard.right = (long long)(col + 1) * cols / this->shardCols;
+            shard.top = (long long)row * rows / this->shardRows;
+            shard.bottom = (long long)(row + 1) * rows / this->shardRows;
+            shards.push_back(shard);
+        }
+    }
+    startWorkers(passable);
+    buildGraph();
+}
+
+ShardedRouter::~ShardedRouter() {
+    stopWorkers();
+}
+
+/**
+ * Fork a worker process for every shard, connected by a socket pair. A shard whose process cant be started is
+ * served from this process instead
+ */
+void ShardedRouter::startWorkers(const uint64_t* passable) {
+    localWorkers.resize(shards.size());
+    localReplies.resize(shards.size());
+#ifdef SHARDEDROUTER_FORK
+    for (int i = 0; i < shards.size(); i++) {
+        int pair[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) < 0) {
+            std::cerr << "Error making a socket for shard " << i << ", serving it in process." << std::endl;
+            continue;
+        }
+        pid_t child = fork();
+        if (child == 0) {
+            // the worker only needs its own end, the ends of the workers started before it belong to the coordinator
+            ::close(pair[0]);
+            for (int j = 0; j < i; j++) {
+                if (shards[j].socket >= 0) {
+                    ::close(shards[j].socket);
+                }
+            }
+            {
+                ShardWorker worker(rows, cols, passable, shards[i].left, shards[i].top, shards[i].right, shards[i].bottom);
+                worker.serve(pair[1]);
+            }
+            // skip the exit handlers, they belong to the coordinator (the metrics report for one)
+            _exit(0);
+        }
+        ::close(pair[1]);
+        if (child < 0) {
+            std::cerr << "Error starting a process for shard " << i << ", serving it in process." << std::endl;
+            ::close(pair[0]);
+            continue;
+        }
+        shards[i].socket = pair[0];
+        shards[i].process = child;
+    }
+#endif
+    for (int i = 0; i < shards.size(); i++) {
+        if (shards[i].process < 0) {
+            localWorkers[i].reset(new ShardWorker(rows, cols, passable, shards[i].left, shards[i].top, shards[i].right, shards[i].bottom));
+        }
+    }
+}
+
+/**
+ * Tell every worker to quit and wait for it
+ */
+void ShardedRouter::stopWorkers() {
+#ifdef SHARDEDROUTER_FORK
+    for (Shard& shard : shards) {
+        if (shard.process >= 0) {
+            sendMessage(shard.socket, std::vector<int32_t>(1, REQUEST_QUIT));
+            ::close(shard.socket);
+            waitpid(shard.process, nullptr, 0);
+            shard.socket = -1;
+            shard.process = -1;
+        }
+    }
+#endif
+    localWorkers.clear();
+}
+
+/**
+ * Send a request to a shard, the reply has to be collected with receive before the next request to the same shard
+ * @return false if the worker is gone
+ */
+bool ShardedRouter::send(int shard, const std::vector<int32_t>& message) {
+    if (localWorkers[shard]) {
+        localReplies[shard] = localWorkers[shard]->handle(message);
+        return true;
+    }
+#ifdef SHARDEDROUTER_FORK
+    if (!sendMessage(shards[shard].socket, message)) {
+        std::cerr << "Shard " << shard << " stopped answering." << std::endl;
+        return false;
+    }
+#endif
+    return true;
+}
+
+/**
+ * @return the reply to the last request sent to a shard, empty if the worker is gone
+ */
+std::vector<int32_t> ShardedRouter::receive(int shard) {
+    std::vector<int32_t> reply;
+    if (localWorkers[shard]) {
+        reply.swap(localReplies[shard]);
+        return reply;
+    }
+#ifdef SHARDEDROUTER_FORK
+    if (!receiveMessage(shards[shard].socket, reply)) {
+        std::cerr << "Shard " << shard << " stopped answering." << std::endl;
+        reply.clear();
+    }
+#endif
+    return reply;
+}
+
+/**
+ * Ask every shard for its boundary cells and the distances between them, then join the shards with an edge of 1
+ * between every pair of boundary cells that are next to each other across a border
+ */
+void ShardedRouter::buildGraph() {
+    std::vector<std::vector<int32_t>> replies(shards.size());
+    for (int i = 0; i < shards.size(); i++) {
+        send(i, std::vector<int32_t>(1, REQUEST_BOUNDARY));
+    }
+    for (int i = 0; i < shards.size(); i++) {
+        replies[i] = receive(i);
+        size_t count = replies[i].empty() ? 0 : replies[i][0];
+        if (replies[i].size() != 1 + count + count * count) {
+            std::cerr << "Shard " << i << " sent a broken boundary table, routes cant pass through it." << std::endl;
+            replies[i].assign(1, 0);
+        }
+    }
+
+    // the nodes of a shard are numbered one after the other, so a node is nodes[0] + its position in the shard
+    std::unordered_map<int, int> nodeOf;
+    for (int i = 0; i < shards.size(); i++) {
+        for (int k = 0; k < replies[i][0]; k++) {
+            int cell = replies[i][1 + k];
+            nodeOf[cell] = nodeCell.size();
+            shards[i].nodes.push_back(nodeCell.size());
+            nodeCell.push_back(cell);
+            nodeShard.push_back(i);
+        }
+    }
+
+    std::vector<std::vector<std::pair<int, int>>> adjacency(nodeCell.size());
+    for (int i = 0; i < shards.size(); i++) {
+        int count = replies[i][0];
+        const int32_t* table = replies[i].data() + 1 + count;
+        for (int from = 0; from < count; from++) {
+            for (int to = 0; to < count; to++) {
+                int distance = table[from * count + to];
+                if (from != to && distance > 0) {
+                    adjacency[shards[i].nodes[from]].push_back(std::make_pair(shards[i].nodes[to], distance));
+                }
+            }
+        }
+    }
+    for (int node = 0; node < nodeCell.size(); node++) {
+        int x = nodeCell[node] % cols;
+        int y = nodeCell[node] / cols;
+        for (int direction = 0; direction < 4; direction++) {
+            int newX = x + DIRECTION_X[direction];
+            int newY = y + DIRECTION_Y[direction];
+            if (newX < 0 || newX >= cols || newY < 0 || newY >= rows || shardOf(newX, newY) == nodeShard[node]) {
+                continue;
+            }
+            auto other = nodeOf.find(newY * cols + newX);
+            if (other != nodeOf.end()) {
+                adjacency[node].push_back(std::make_pair(other->second, 1));
+            }
+        }
+    }
+
+    edgeStart.push_back(0);
+    for (const std::vector<std::pair<int, int>>& edges : adjacency) {
+        for (const std::pair<int, int>& edge : edges) {
+            edgeTarget.push_back(edge.first);
+            edgeCost.push_back(edge.second);
+        }
+        edgeStart.push_back(edgeTarget.size());
+    }
+    nodeDistance = std::vector<int>(nodeCell.size(), UNREACHABLE);
+    nodeParent = std::vector<int>(nodeCell.size(), -1);
+    METRICS_COUNT("sharded_router.nodes", nodeCell.size());
+    METRICS_COUNT("sharded_router.edges", edgeTarget.size());
+}
+
+/**
+ * @return the shard a cell is in
+ */
+int ShardedRouter::shardOf(int x, int y) const {
+    int col = std::min((long long)x * shardCols / cols, (long long)shardCols - 1);
+    int row = std::min((long long)y * shardRows / rows, (long long)shardRows - 1);
+    // the shard edges are rounded down, so the estimate can be one shard off
+    while (col > 0 && x < shards[col].left) {
+        col--;
+    }
+    while (col < shardCols - 1 && x >= shards[col].right) {
+        col++;
+    }
+    while (row > 0 && y < shards[row * shardCols].top) {
+        row--;
+    }
+    while (row < shardRows - 1 && y >= shards[row * shardCols].bottom) {
+        row++;
+    }
+    return row * shardCols + col;
+}
+
+/**
+ * Send the start and end of every query to the shards they are in, one request per shard so every shard searches
+ * at the same time
+ * @param queries ((startX, startY), (endX, endY)) pairs
+ * @param startSlot filled with the shard of every start and its position in that shards reply, shard -1 if off the map
+ * @param endSlot the same for every end
+ * @return the reply of every shard
+ */
+std::vector<std::vector<int32_t>> ShardedRouter::askDistances(const std::vector<Query>& queries,
+                                                              std::vector<std::pair<int, int>>& startSlot,
+                                                              std::vector<std::pair<int, int>>& endSlot) {
+    std::vector<std::vector<int32_t>> messages(shards.size(), std::vector<int32_t>{REQUEST_DISTANCES, 0});
+    startSlot.assign(queries.size(), std::make_pair(-1, 0));
+    endSlot.assign(queries.size(), std::make_pair(-1, 0));
+    for (int q = 0; q < queries.size(); q++) {
+        int startX = queries[q].first.first;
+        int startY = queries[q].first.second;
+        int endX = queries[q].second.first;
+        int endY = queries[q].second.second;
+        if (startX < 0 || startX >= cols || startY < 0 || startY >= rows || endX < 0 || endX >= cols || endY < 0 || endY >= rows) {
+            continue;
+        }
+        int startShard = shardOf(startX, startY);
+        int endShard = shardOf(endX, endY);
+        // from the start the shard also measures straight to the end when both are in it
+        std::vector<int32_t>& start = messages[startShard];
+        startSlot[q] = std::make_pair(startShard, start[1]++);
+        start.insert(start.end(), {startX, startY, startShard == endShard ? endX : -1, endY});
+        std::vector<int32_t>& end = messages[endShard];
+        endSlot[q] = std::make_pair(endShard, end[1]++);
+        end.insert(end.end(), {endX, endY, -1, -1});
+    }
+    std::vector<std::vector<int32_t>> replies(shards.size());
+    for (int i = 0; i < shards.size(); i++) {
+        if (messages[i][1] > 0) {
+            send(i, messages[i]);
+        }
+    }
+    for (int i = 0; i < shards.size(); i++) {
+        if (messages[i][1] > 0) {
+            replies[i] = receive(i);
+            if (replies[i].size() != (size_t)messages[i][1] * (shards[i].nodes.size() + 1)) {
+                replies[i].assign((size_t)messages[i][1] * (shards[i].nodes.size() + 1), -1);
+            }
+        }
+    }
+    return replies;
+}
+
+/**
+ * Dijkstra over the boundary graph for one query, the graph search never looks at a single cell
+ * @param startShard the shard of the start
+ * @param fromStart the distance from the start to every boundary cell of its shard (-1 if none)
+ * @param endShard the shard of the end
+ * @param toEnd the distance from every boundary cell of the end shard to the end (-1 if none)
+ * @param direct the distance from start to end without leaving the shard, UNREACHABLE if there is none
+ * @param lastNode set to the boundary cell the route reaches the end from, -1 if the direct route is the shortest
+ * @return the distance, UNREACHABLE if there is none. the route is left in nodeParent
+ */
+int ShardedRouter::searchGraph(int startShard, const int32_t* fromStart, int endShard, const int32_t* toEnd, int direct, int& lastNode) {
+    for (int node : touched) {
+        nodeDistance[node] = UNREACHABLE;
+        nodeParent[node] = -1;
+    }
+    touched.clear();
+    int best = direct;
+    lastNode = -1;
+
+    std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>, std::greater<std::pair<int, int>>> pq;
+    const std::vector<int>& startNodes = shards[startShard].nodes;
+    for (int k = 0; k < startNodes.size(); k++) {
+        if (fromStart[k] >= 0) {
+            nodeDistance[startNodes[k]] = fromStart[k];
+            touched.push_back(startNodes[k]);
+            pq.push(std::make_pair(fromStart[k], startNodes[k]));
+        }
+    }
+    int firstEndNode = shards[endShard].nodes.empty() ? 0 : shards[endShard].nodes[0];
+    long long popped = 0;
+    while (!pq.empty()) {
+        int distance = pq.top().first;
+        int node = pq.top().second;
+        pq.pop();
+        if (distance > nodeDistance[node]) {
+            continue;
+        }
+        // every edge costs at least 1, nothing left in the queue can beat the best route found
+        if (distance >= best) {
+            break;
+        }
+        popped++;
+        if (nodeShard[node] == endShard && toEnd[node - firstEndNode] >= 0 && distance + toEnd[node - firstEndNode] < best) {
+            best = distance + toEnd[node - firstEndNode];
+            lastNode = node;
+        }
+        for (int edge = edgeStart[node]; edge < edgeStart[node + 1]; edge++) {
+            int next = edgeTarget[edge];
+            int nextDistance = distance + edgeCost[edge];
+            if (nextDistance < nodeDistance[next]) {
+                if (nodeDistance[next] == UNREACHABLE) {
+                    touched.push_back(next);
+                }
+                nodeDistance[next] = nextDistance;
+                nodeParent[next] = node;
+                pq.push(std::make_pair(nextDistance, next));
+            }
+        }
+    }
+    METRICS_COUNT("sharded_router.nodes_popped", popped);
+    return best;
+}
+
+/**
+ * Run the graph search for one query out of the replies of askDistances
+ */
+int ShardedRouter::searchQuery(const std::vector<std::vector<int32_t>>& replies, std::pair<int, int> startSlot,
+                               std::pair<int, int> endSlot, int& lastNode) {
+    lastNode = -1;
+    if (startSlot.first < 0) {
+        return UNREACHABLE;
+    }
+    size_t startStride = shards[startSlot.first].nodes.size() + 1;
+    size_t endStride = shards[endSlot.first].nodes.size() + 1;
+    const int32_t* fromStart = replies[startSlot.first].data() + startSlot.second * startStride;
+    const int32_t* toEnd = replies[endSlot.first].data() + endSlot.second * endStride;
+    int direct = fromStart[startStride - 1] >= 0 ? fromStart[startStride - 1] : UNREACHABLE;
+    return searchGraph(startSlot.first, fromStart, endSlot.first, toEnd, direct, lastNode);
+}
+
+/**
+ * Length of the shortest path between two cells
+ * @return the amount of steps, UNREACHABLE if there is none
+ */
+int ShardedRouter::findDistance(int startX, int startY, int endX, int endY) {
+    return findDistances(std::vector<Query>(1, Query(std::make_pair(startX, startY), std::make_pair(endX, endY))))[0];
+}
+
+/**
+ * Length of the shortest path for a batch of queries. Every shard gets one request with all the cells of the batch
+ * that are in it and they all work on them at the same time
+ * @param queries ((startX, startY), (endX, endY)) pairs
+ * @return the amount of steps for every query, UNREACHABLE where there is no path
+ */
+std::vector<int> ShardedRouter::findDistances(const std::vector<Query>& queries) {
+    METRICS_TIMER("sharded_router.find_distances");
+    std::vector<std::pair<int, int>> startSlot;
+    std::vector<std::pair<int, int>> endSlot;
+    std::vector<std::vector<int32_t>> replies = askDistances(queries, startSlot, endSlot);
+    std::vector<int> distances;
+    for (int q = 0; q < queries.size(); q++) {
+        int lastNode;
+        distances.push_back(searchQuery(replies, startSlot[q], endSlot[q], lastNode));
+    }
+    return distances;
+}
+
+/**
+ * Shortest path between two cells, stitched together from pieces that the shards it passes through search for
+ * @return the path from start to end, just the end cell if it cant be reached (like Dijkstra)
+ */
+CompactPath ShardedRouter::findShortestPath(int startX, int startY, int endX, int endY) {
+    METRICS_TIMER("sharded_router.find_shortest_path");
+    std::vector<Query> queries(1, Query(std::make_pair(startX, startY), std::make_pair(endX, endY)));
+    std::vector<std::pair<int, int>> startSlot;
+    std::vector<std::pair<int, int>> endSlot;
+    std::vector<std::vector<int32_t>> replies = askDistances(queries, startSlot, endSlot);
+    int lastNode;
+    if (searchQuery(replies, startSlot[0], endSlot[0], lastNode) == UNREACHABLE) {
+        return CompactPath(endX, endY);
+    }
+
+    // the boundary cells the route goes through, the start and end are added on both sides
+    std::vector<int> cells;
+    for (int node = lastNode; node >= 0; node = nodeParent[node]) {
+        cells.push_back(nodeCell[node]);
+    }
+    cells.push_back(startY * cols + startX);
+    std::reverse(cells.begin(), cells.end());
+    cells.push_back(endY * cols + endX);
+
+    // every hop is either a step across a border or a piece inside one shard, the pieces are asked for all at once
+    std::vector<std::vector<int32_t>> messages(shards.size(), std::vector<int32_t>{REQUEST_PATHS, 0});
+    for (int hop = 1; hop < cells.size(); hop++) {
+        int fromShard = shardOf(cells[hop - 1] % cols, cells[hop - 1] / cols);
+        if (fromShard == shardOf(cells[hop] % cols, cells[hop] / cols)) {
+            messages[fromShard][1]++;
+            messages[fromShard].insert(messages[fromShard].end(),
+                                       {cells[hop - 1] % cols, cells[hop - 1] / cols, cells[hop] % cols, cells[hop] / cols});
+        }
+    }
+    std::vector<std::vector<int32_t>> pieces(shards.size());
+    std::vector<size_t> read(shards.size(), 0);
+    for (int i = 0; i < shards.size(); i++) {
+        if (messages[i][1] > 0) {
+            send(i, messages[i]);
+        }
+    }
+    for (int i = 0; i < shards.size(); i++) {
+        if (messages[i][1] > 0) {
+            pieces[i] = receive(i);
+        }
+    }
+
+    CompactPath path(startX, startY);
+    for (int hop = 1; hop < cells.size(); hop++) {
+        int fromX = cells[hop - 1] % cols;
+        int fromY = cells[hop - 1] / cols;
+        int toX = cells[hop] % cols;
+        int toY = cells[hop] / cols;
+        int shard = shardOf(fromX, fromY);
+        if (shard != shardOf(toX, toY)) {
+            path.append(toX < fromX ? 0 : (toX > fromX ? 1 : (toY < fromY ? 2 : 3)));
+            continue;
+        }
+        const std::vector<int32_t>& piece = pieces[shard];
+        if (read[shard] >= piece.size() || piece[read[shard]] < 0 || read[shard] + 1 + 2 * piece[read[shard]] > piece.size()) {
+            std::cerr << "Shard " << shard << " couldnt find its piece of a route." << std::endl;
+            return CompactPath(endX, endY);
+        }
+        int runs = piece[read[shard]++];
+        for (int run = 0; run < runs; run++) {
+            path.append(piece[read[shard]], piece[read[shard] + 1]);
+            read[shard] += 2;
+        }
+    }
+    return path;
+}
+
+int ShardedRouter::getShardCount() const {
+    return shards.size();
+}
+
+/**
+ * @return how many boundary cells the graph has
+ */
+int ShardedRouter::getNodeCount() const {
+    return nodeCell.size();
+}
+
+int ShardedRouter::getEdgeCount() const {
+    return edgeTarget.size();
+}
+
+/**
+ * @return true if every shard is served by its own process
+ */
+bool ShardedRouter::isMultiProcess() const {
+    for (const std::unique_ptr<ShardWorker>& worker : localWorkers) {
+        if (worker) {
+            return false;
+        }
+    }
+    return true;
+}
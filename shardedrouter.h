@@ -0,0 +1,96 @@
+#ifndef SHARDEDROUTER_H
+#define SHARDEDROUTER_H
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "compactpath.h"
+
+class ShardWorker;
+
+/*
+ * Routing with the map cut into a grid of rectangular shards that are each served by their own worker process.
+ * A worker only copies the cells of its own shard and talks to the coordinator over a unix socket pair. Once started
+ * every worker finds its boundary cells (road cells with a road right across the shard border) and the distance
+ * between every pair of them inside the shard. The coordinator keeps only the graph of boundary cells: the distances
+ * inside each shard plus a step of 1 across every border. A route asks the shards of its two ends for their
+ * distances to the boundary, runs Dijkstra over the boundary graph and then asks each shard the route passes through
+ * for its piece of the path. The workers answer at the same time, so batches of queries keep every process busy.
+ * The routes are exactly as long as Dijkstra's. Without fork (not unix) the shards are served in this process.
+ * This splits the searching between processes, not the memory: the coordinator still has the whole grid (the server
+ * keeps it for everything else) and the workers are forks of it that share those pages until they are written to.
+ * A map that doesnt fit in one process doesnt fit here either, that is what TiledGrid is for.
+ * Workers are forked when the router is built, so build it before starting any threads.
+ * Coordinates are (x, y) like Dijkstra
+ */
+class ShardedRouter {
+public:
+    // distance reported for targets that cant be reached
+    static const int UNREACHABLE = INT32_MAX / 4;
+    // every shard is its own process, past this the startup costs more than the shards save
+    static const int MAX_SHARDS_PER_SIDE = 16;
+    // ((startX, startY), (endX, endY))
+    typedef std::pair<std::pair<int, int>, std::pair<int, int>> Query;
+
+    ShardedRouter(int rows, int cols, const uint64_t* passable, int shardRows, int shardCols);
+    ~ShardedRouter();
+    ShardedRouter(const ShardedRouter&) = delete;
+    ShardedRouter& operator=(const ShardedRouter&) = delete;
+
+    CompactPath findShortestPath(int startX, int startY, int endX, int endY);
+    int findDistance(int startX, int startY, int endX, int endY);
+    std::vector<int> findDistances(const std::vector<Query>& queries);
+
+    int getShardCount() const;
+    int getNodeCount() const;
+    int getEdgeCount() const;
+    bool isMultiProcess() const;
+
+private:
+    struct Shard {
+        int left;
+        int top;
+        int right;  // one past the last collumn
+        int bottom; // one past the last row
+        int socket = -1;
+        int process = -1;
+        // the graph node of every boundary cell, in the order the worker reports them
+        std::vector<int> nodes;
+    };
+
+    int rows;
+    int cols;
+    int shardRows;
+    int shardCols;
+    std::vector<Shard> shards;
+    // without fork the workers live here and a request is answered as soon as it is sent
+    std::vector<std::unique_ptr<ShardWorker>> localWorkers;
+    std::vector<std::vector<int32_t>> localReplies;
+
+    // the boundary graph, the edges of node i are edgeTarget / edgeCost[edgeStart[i] .. edgeStart[i + 1])
+    std::vector<int> nodeCell;
+    std::vector<int> nodeShard;
+    std::vector<int> edgeStart;
+    std::vector<int> edgeTarget;
+    std::vector<int> edgeCost;
+    // search state, reset through touched
+    std::vector<int> nodeDistance;
+    std::vector<int> nodeParent;
+    std::vector<int> touched;
+
+    void startWorkers(const uint64_t* passable);
+    void buildGraph();
+    int shardOf(int x, int y) const;
+    bool send(int shard, const std::vector<int32_t>& message);
+    std::vector<int32_t> receive(int shard);
+    std::vector<std::vector<int32_t>> askDistances(const std::vector<Query>& queries,
+                                                   std::vector<std::pair<int, int>>& startSlot,
+                                                   std::vector<std::pair<int, int>>& endSlot);
+    int searchGraph(int startShard, const int32_t* fromStart, int endShard, const int32_t* toEnd, int direct, int& lastNode);
+    int searchQuery(const std::vector<std::vector<int32_t>>& replies, std::pair<int, int> startSlot,
+                    std::pair<int, int> endSlot, int& lastNode);
+    void stopWorkers();
+};
+
+#endif
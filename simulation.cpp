@@ -0,0 +1,254 @@
+#include "simulation.h"
+#include "City.h"
+#include "dijkstra.h"
+#include "fleetplanner.h"
+#include "hubcatchment.h"
+#include "metrics.h"
+#include "ordersampler.h"
+#include "routeoptimizer.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+
+const int Simulation::PLAN_PASSES;
+
+/**
+ * Constructor for the simulation, nothing runs until run is called
+ * @param size the size of every city, see City
+ * @param hubs how many hubs every city has
+ * @param orders how many orders a day has, 0 picks a random amount from 2 - 7 every day
+ * @param vehicles how many vehicles leave each hub
+ * @param capacity how many orders a vehicle can carry, 0 spreads the orders evenly
+ * @param seed the base seed, the same seed runs the same days
+ * @param workers how many threads to run days on, 0 uses one per hardware thread
+ */
+Simulation::Simulation(int size, int hubs, int orders, int vehicles, int capacity, unsigned int seed, int workers)
+    : pool(workers) {
+    this->size = size;
+    this->hubs = std::max(1, hubs);
+    this->orders = std::max(0, orders);
+    this->vehicles = std::max(1, vehicles);
+    this->capacity = std::max(0, capacity);
+    this->seed = seed;
+    workspaces = std::vector<Workspace>(pool.size());
+}
+
+/**
+ * Run more days, their results are added to the ones of earlier runs
+ * @param count how many days to run
+ */
+void Simulation::run(int count) {
+    METRICS_TIMER("simulation.run");
+    int firstDay = days;
+    auto start = std::chrono::steady_clock::now();
+    pool.run(count, [this, firstDay](int worker, int task) {
+        Workspace& workspace = workspaces[worker];
+        auto dayStart = std::chrono::steady_clock::now();
+        double routeLength = 0;
+        double planTime = 0;
+        if (!simulateDay(firstDay + task, workspace, routeLength, planTime)) {
+            workspace.failed++;
+            return;
+        }
+        workspace.routeLengths.push_back(routeLength);
+        workspace.planMs.push_back(planTime);
+        workspace.dayMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - dayStart).count());
+    });
+    seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    days += count;
+
+    // gather what every worker collected
+    for (Workspace& workspace : workspaces) {
+        routeLengths.insert(routeLengths.end(), workspace.routeLengths.begin(), workspace.routeLengths.end());
+        dayMs.insert(dayMs.end(), workspace.dayMs.begin(), workspace.dayMs.end());
+        planMs.insert(planMs.end(), workspace.planMs.begin(), workspace.planMs.end());
+        failedDays += workspace.failed;
+        workspace.routeLengths.clear();
+        workspace.dayMs.clear();
+        workspace.planMs.clear();
+        workspace.failed = 0;
+    }
+    std::sort(routeLengths.begin(), routeLengths.end());
+    std::sort(dayMs.begin(), dayMs.end());
+    std::sort(planMs.begin(), planMs.end());
+    METRICS_COUNT("simulation.days", count);
+    METRICS_COUNT("simulation.steals", pool.getSteals());
+}
+
+/**
+ * Generate, order and plan one day
+ * @param day the day number, picks the random stream
+ * @param workspace the workers buffers
+ * @param routeLength set to the steps driven by every vehicle of every hub together
+ * @param planTime set to the milliseconds spent planning, from the orders to the finished routes
+ * @return false if an order cant be driven to or the fleet cant carry the orders
+ */
+bool Simulation::simulateDay(int day, Workspace& workspace, double& routeLength, double& planTime) {
+    std::seed_seq stream{seed, (unsigned int)day};
+    workspace.gen.seed(stream);
+    City city(size, hubs, workspace.gen(), false);
+    city.fillGrid(workspace.grid);
+    city.fillHouses(workspace.houses);
+
+    // orders go to different houses, like generateDeliveries in main. (row, col) like the hubs
+    int deliveries = orders == 0 ? city.generateRandomNumber(workspace.gen, 2, 7) : orders;
+    OrderSampler sampler(workspace.houses.size());
+    workspace.orders.clear();
+    for (int house : sampler.sample(workspace.gen, deliveries)) {
+        workspace.orders.push_back(std::make_pair((int)workspace.houses[house].y, (int)workspace.houses[house].x));
+    }
+
+    auto planStart = std::chrono::steady_clock::now();
+    std::vector<std::pair<int,int>> hubLocations = city.getHubLocations();
+    std::vector<std::vector<std::pair<int,int>>> hubOrders(1, workspace.orders);
+    if (hubLocations.size() > 1) {
+        HubCatchment catchment(workspace.grid, hubLocations);
+        std::vector<std::pair<int,int>> unassigned;
+        hubOrders = catchment.partition(workspace.orders, unassigned);
+        // an order no hub can reach fails the day, the same as one a hub cant find a route to
+        if (!unassigned.empty()) {
+            return false;
+        }
+    }
+
+    Dijkstra dijkstra(workspace.grid);
+    long long steps = 0;
+    for (int hub = 0; hub < hubLocations.size(); hub++) {
+        if (hubOrders[hub].empty()) {
+            continue;
+        }
+        // stop 0 is the hub, dijkstra takes (x, y)
+        std::vector<std::pair<int,int>> targets(1, std::make_pair(hubLocations[hub].second, hubLocations[hub].first));
+        for (std::pair<int,int> order : hubOrders[hub]) {
+            targets.push_back(std::make_pair(order.second, order.first));
+        }
+        std::vector<std::vector<int>> distances;
+        for (std::pair<int,int> from : targets) {
+            distances.push_back(dijkstra.findDistances(from.first, from.second, targets));
+            for (int distance : distances.back()) {
+                if (distance == Dijkstra::UNREACHABLE) {
+                    return false;
+                }
+            }
+        }
+
+        std::vector<std::vector<int>> routes;
+        if (vehicles == 1) {
+            // the optimizer counts the cells of a leg, one more than its steps
+            std::vector<std::vector<int>> cells = distances;
+            for (std::vector<int>& row : cells) {
+                for (int& distance : row) {
+                    distance++;
+                }
+            }
+            RouteOptimizer optimizer(cells, 0, PLAN_PASSES);
+            routes.push_back(optimizer.solve());
+        } else {
+            int hubCapacity = capacity;
+            if (hubCapacity == 0) {
+                hubCapacity = std::max(1, ((int)hubOrders[hub].size() + vehicles - 1) / vehicles);
+            }
+            if ((long long)vehicles * hubCapacity < hubOrders[hub].size()) {
+                return false;
+            }
+            // the days already use every core, so the planner gets a single thread
+            FleetPlanner planner(distances, vehicles, hubCapacity, 0, 1, PLAN_PASSES);
+            routes = planner.plan();
+        }
+        for (const std::vector<int>& route : routes) {
+            for (int leg = 1; leg < route.size(); leg++) {
+                steps += distances[route[leg - 1]][route[leg]];
+            }
+        }
+    }
+    routeLength = steps;
+    planTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - planStart).count();
+    return true;
+}
+
+/**
+ * @param sorted every value, smallest first
+ * @return the mean, percentiles and max of the values
+ */
+Simulation::Distribution Simulation::summarize(const std::vector<double>& sorted) {
+    Distribution distribution;
+    if (sorted.empty()) {
+        return distribution;
+    }
+    double total = 0;
+    for (double value : sorted) {
+        total += value;
+    }
+    auto percentile = [&sorted](double fraction) {
+        return sorted[std::min(sorted.size() - 1, (size_t)(fraction * sorted.size()))];
+    };
+    distribution.mean = total / sorted.size();
+    distribution.p50 = percentile(0.5);
+    distribution.p90 = percentile(0.9);
+    distribution.p99 = percentile(0.99);
+    distribution.max = sorted.back();
+    return distribution;
+}
+
+int Simulation::getDays() const {
+    return days;
+}
+
+/**
+ * @return how many days couldnt be planned, they are left out of every distribution
+ */
+int Simulation::getFailedDays() const {
+    return failedDays;
+}
+
+/**
+ * @return the wall clock time spent in run
+ */
+double Simulation::getSeconds() const {
+    return seconds;
+}
+
+long long Simulation::getSteals() const {
+    return pool.getSteals();
+}
+
+/**
+ * @return the steps driven per day, every vehicle of every hub together
+ */
+Simulation::Distribution Simulation::getRouteLengths() const {
+    return summarize(routeLengths);
+}
+
+/**
+ * @return how long a whole day took, generating the city included
+ */
+Simulation::Distribution Simulation::getDayLatencies() const {
+    return summarize(dayMs);
+}
+
+/**
+ * @return how long planning took per day, from the orders to the finished routes
+ */
+Simulation::Distribution Simulation::getPlanLatencies() const {
+    return summarize(planMs);
+}
+
+/**
+ * Write a table of the distributions and the throughput
+ */
+void Simulation::printReport(std::ostream& out) const {
+    out << "Days: " << days << " (" << failedDays << " could not be planned) on " << pool.size() << " workers, "
+        << pool.getSteals() << " steals" << std::endl;
+    out << "Throughput: " << std::fixed << std::setprecision(1) << (seconds > 0 ? days / seconds : 0) << " days/s" << std::endl;
+    out << std::left << std::setw(22) << "" << std::right << std::setw(12) << "mean" << std::setw(12) << "p50"
+        << std::setw(12) << "p90" << std::setw(12) << "p99" << std::setw(12) << "max" << std::endl;
+    auto row = [&out](const char* name, const Distribution& distribution) {
+        out << std::left << std::setw(22) << name << std::right << std::setprecision(2) << std::setw(12)
+            << distribution.mean << std::setw(12) << distribution.p50 << std::setw(12) << distribution.p90
+            << std::setw(12) << distribution.p99 << std::setw(12) << distribution.max << std::endl;
+    };
+    row("route length (steps)", getRouteLengths());
+    row("day latency (ms)", getDayLatencies());
+    row("plan latency (ms)", getPlanLatencies());
+    out.unsetf(std::ios::floatfield);
+}
@@ -0,0 +1,81 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <ostream>
+#include <random>
+#include <utility>
+#include <vector>
+#include "quadtree.h"
+#include "workstealingpool.h"
+
+/*
+ * Monte Carlo driver for capacity planning, runs many independent days in one process instead of one run of main per
+ * day. A day generates a city, picks its orders, splits them between the hubs and plans the routes like main does,
+ * but nothing is written to map.txt or outputPath.txt. Days are spread over a WorkStealingPool since some take much
+ * longer than others. Every day gets its own random stream, seeded from the base seed and the day number, and planning
+ * is capped by passes instead of time, so the results are the same for any amount of workers. Each worker keeps a
+ * workspace (grid, house list, results) that is reused from day to day instead of allocated again
+ */
+class Simulation {
+public:
+    // summary of one value over every day that was planned
+    struct Distribution {
+        double mean = 0;
+        double p50 = 0;
+        double p90 = 0;
+        double p99 = 0;
+        double max = 0;
+    };
+
+    Simulation(int size, int hubs, int orders, int vehicles, int capacity, unsigned int seed, int workers = 0);
+
+    void run(int days);
+    int getDays() const;
+    int getFailedDays() const;
+    double getSeconds() const;
+    long long getSteals() const;
+    Distribution getRouteLengths() const;
+    Distribution getDayLatencies() const;
+    Distribution getPlanLatencies() const;
+    void printReport(std::ostream& out) const;
+
+private:
+    // the most local search passes the route optimizer and fleet planner get per hub, main gives them 100 ms and 1 s
+    // instead. a pass cap keeps a day from depending on how many workers share the cpu
+    static const int PLAN_PASSES = 10;
+
+    // everything a worker reuses from one day to the next
+    struct Workspace {
+        std::mt19937 gen;
+        std::vector<std::vector<int>> grid;
+        std::vector<Point> houses;
+        std::vector<std::pair<int,int>> orders;
+        // the results of the days this worker ran, moved out after every run
+        std::vector<double> routeLengths;
+        std::vector<double> dayMs;
+        std::vector<double> planMs;
+        int failed = 0;
+    };
+
+    int size;
+    int hubs;
+    int orders;
+    int vehicles;
+    int capacity;
+    unsigned int seed;
+    WorkStealingPool pool;
+    std::vector<Workspace> workspaces;
+
+    // every day that was run, sorted
+    std::vector<double> routeLengths;
+    std::vector<double> dayMs;
+    std::vector<double> planMs;
+    int days = 0;
+    int failedDays = 0;
+    double seconds = 0;
+
+    bool simulateDay(int day, Workspace& workspace, double& routeLength, double& planTime);
+    static Distribution summarize(const std::vector<double>& sorted);
+};
+
+#endif
@@ -0,0 +1,312 @@
+#include "snapshot.h"
+#include "metrics.h"
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SNAPSHOT_MMAP
+#endif
+
+static const char MAGIC[8] = {'D', 'L', 'V', 'S', 'N', 'A', 'P', '\0'};
+
+Snapshot::Snapshot() {
+}
+
+Snapshot::~Snapshot() {
+    release();
+}
+
+/**
+ * Drop whatever the snapshot currently holds, unmapping the file if there is one
+ */
+void Snapshot::release() {
+#ifdef SNAPSHOT_MMAP
+    if (mapping != nullptr) {
+        munmap(mapping, mappingSize);
+    }
+#endif
+    mapping = nullptr;
+    mappingSize = 0;
+    image.clear();
+    data = nullptr;
+    size = 0;
+}
+
+/**
+ * Prepare everything from a parsed map and lay it out in memory exactly like the file
+ * @param map the parsed map file
+ */
+void Snapshot::build(const MapReader& map) {
+    METRICS_TIMER("snapshot.build");
+    release();
+    int width = map.getWidth();
+    int height = map.getHeight();
+    const std::vector<std::vector<std::string>>& points = map.getPoints();
+
+    std::vector<int32_t> cells((size_t)width * height, 0);
+    std::vector<uint64_t> passable(((size_t)width * height + 63) / 64, 0);
+    std::vector<FlatPoint> houses;
+    std::vector<int32_t> hubs;
+    for (int i = 0; i < points.size(); i++) {
+        for (int j = 0; j < points[i].size() && j < width; j++) {
+            int value = std::atoi(points[i][j].c_str());
+            int index = i * width + j;
+            cells[index] = value;
+            if (value != 0) {
+                passable[index >> 6] |= (uint64_t)1 << (index & 63);
+            }
+            if (value > 0) {
+                houses.push_back(FlatPoint{j, i, value});
+            } else if (value == -2) {
+                hubs.push_back(i);
+                hubs.push_back(j);
+            }
+        }
+    }
+
+    Quadtree quadtree(Rectangle{0, 0, (float)width, (float)height});
+    map.fillQuadtree(quadtree);
+    std::vector<FlatQuadtreeNode> nodes;
+    std::vector<FlatPoint> quadtreePoints;
+    quadtree.flatten(nodes, quadtreePoints);
+
+    // the header, then the section table, then every section starting on an aligned offset
+    struct Pending {
+        uint32_t id;
+        const void* bytes;
+        size_t size;
+    };
+    std::vector<Pending> sections = {
+        {CELLS, cells.data(), cells.size() * sizeof(int32_t)},
+        {PASSABLE, passable.data(), passable.size() * sizeof(uint64_t)},
+        {HOUSES, houses.data(), houses.size() * sizeof(FlatPoint)},
+        {HUBS, hubs.data(), hubs.size() * sizeof(int32_t)},
+        {QUADTREE_NODES, nodes.data(), nodes.size() * sizeof(FlatQuadtreeNode)},
+        {QUADTREE_POINTS, quadtreePoints.data(), quadtreePoints.size() * sizeof(FlatPoint)},
+    };
+    auto align = [](size_t offset) { return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT; };
+
+    std::vector<SectionEntry> table;
+    size_t offset = align(sizeof(Header) + sections.size() * sizeof(SectionEntry));
+    for (const Pending& section : sections) {
+        table.push_back(SectionEntry{section.id, 0, offset, section.size});
+        offset = align(offset + section.size);
+    }
+
+    image.assign((offset + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+    char* bytes = (char*)image.data();
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.byteOrder = ENDIAN_MARKER;
+    header.width = width;
+    header.height = height;
+    header.sectionCount = table.size();
+    std::memcpy(bytes, &header, sizeof(header));
+    std::memcpy(bytes + sizeof(header), table.data(), table.size() * sizeof(SectionEntry));
+    for (int i = 0; i < sections.size(); i++) {
+        if (sections[i].size > 0) {
+            std::memcpy(bytes + table[i].offset, sections[i].bytes, sections[i].size);
+        }
+    }
+    data = bytes;
+    size = offset;
+}
+
+/**
+ * Write the snapshot to a file
+ * @param path where to write it
+ * @return false if nothing has been built or the file could not be written
+ */
+bool Snapshot::save(const std::string& path) const {
+    METRICS_TIMER("snapshot.save");
+    if (!isLoaded()) {
+        std::cerr << "No snapshot to save." << std::endl;
+        return false;
+    }
+    std::ofstream file(path, std::ios::binary);
+    if (!file || !file.write(data, size)) {
+        std::cerr << "Error writing snapshot " << path << std::endl;
+        return false;
+    }
+    METRICS_COUNT("snapshot.bytes_written", (long long)size);
+    return true;
+}
+
+/**
+ * Map a snapshot file into memory. Nothing is copied or parsed, the sections are used where they are in the file
+ * @param path the snapshot file
+ * @return false if the file could not be read or is not a snapshot this version understands
+ */
+bool Snapshot::open(const std::string& path) {
+    METRICS_TIMER("snapshot.open");
+    release();
+#ifdef SNAPSHOT_MMAP
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        std::cerr << "Error opening snapshot " << path << std::endl;
+        return false;
+    }
+    struct stat info;
+    if (fstat(file, &info) < 0 || info.st_size < (off_t)sizeof(Header)) {
+        std::cerr << "Snapshot " << path << " is too small." << std::endl;
+        ::close(file);
+        return false;
+    }
+    void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file); // the mapping stays valid after the file is closed
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Error mapping snapshot " << path << std::endl;
+        return false;
+    }
+    mapping = mapped;
+    mappingSize = info.st_size;
+    data = (const char*)mapped;
+    size = info.st_size;
+#else
+    // without mmap read the whole file in, the layout is the same so everything else works unchanged
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        std::cerr << "Error opening snapshot " << path << std::endl;
+        return false;
+    }
+    size_t fileSize = file.tellg();
+    file.seekg(0);
+    image.assign((fileSize + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+    file.read((char*)image.data(), fileSize);
+    data = (const char*)image.data();
+    size = fileSize;
+#endif
+    return validate(path);
+}
+
+/**
+ * Check the header and that every section lies inside the file and is aligned, so later reads can trust it
+ */
+bool Snapshot::validate(const std::string& path) {
+    const char* problem = nullptr;
+    const Header* header = (const Header*)data;
+    if (size < sizeof(Header) || std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0) {
+        problem = "is not a snapshot";
+    } else if (header->byteOrder != ENDIAN_MARKER) {
+        problem = "was written on a machine with a different byte order";
+    } else if (header->version != VERSION) {
+        problem = "was written by a different version";
+    } else if (header->width <= 0 || header->height <= 0 ||
+               sizeof(Header) + (uint64_t)header->sectionCount * sizeof(SectionEntry) > size) {
+        problem = "has a broken header";
+    } else {
+        const SectionEntry* table = (const SectionEntry*)(data + sizeof(Header));
+        for (uint32_t i = 0; i < header->sectionCount; i++) {
+            if (table[i].offset % ALIGNMENT != 0 || table[i].offset > size || table[i].size > size - table[i].offset) {
+                problem = "has a section outside the file";
+            }
+        }
+    }
+    if (problem == nullptr) {
+        // the grid sections have to match the size in the header and the quadtree can only point inside itself
+        size_t cellCount, wordCount, nodeCount, pointCount;
+        const int32_t* cells = (const int32_t*)findSection(CELLS, sizeof(int32_t), cellCount);
+        const uint64_t* passable = (const uint64_t*)findSection(PASSABLE, sizeof(uint64_t), wordCount);
+        const FlatQuadtreeNode* nodes = getQuadtreeNodes(nodeCount);
+        getQuadtreePoints(pointCount);
+        size_t expectedCells = (size_t)header->width * header->height;
+        if (cells == nullptr || cellCount != expectedCells || passable == nullptr || wordCount != (expectedCells + 63) / 64 ||
+            nodes == nullptr || nodeCount == 0) {
+            problem = "is missing sections";
+        } else {
+            for (size_t i = 0; i < nodeCount; i++) {
+                bool badChildren = nodes[i].firstChild != -1 && (nodes[i].firstChild <= (int64_t)i || nodes[i].firstChild + 4 > (int64_t)nodeCount);
+                bool badPoints = nodes[i].firstPoint < 0 || nodes[i].pointCount < 0 || (size_t)nodes[i].firstPoint + nodes[i].pointCount > pointCount;
+                if (badChildren || badPoints) {
+                    problem = "has a broken quadtree";
+                    break;
+                }
+            }
+        }
+    }
+    if (problem != nullptr) {
+        std::cerr << "Snapshot " << path << " " << problem << "." << std::endl;
+        release();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Find a section by id
+ * @param id the section to look for
+ * @param elementSize the size of one element of the section
+ * @param count set to the amount of elements
+ * @return the start of the section, nullptr if there is none
+ */
+const void* Snapshot::findSection(uint32_t id, size_t elementSize, size_t& count) const {
+    count = 0;
+    if (!isLoaded()) {
+        return nullptr;
+    }
+    const Header* header = (const Header*)data;
+    const SectionEntry* table = (const SectionEntry*)(data + sizeof(Header));
+    for (uint32_t i = 0; i < header->sectionCount; i++) {
+        if (table[i].id == id) {
+            count = table[i].size / elementSize;
+            return data + table[i].offset;
+        }
+    }
+    return nullptr;
+}
+
+bool Snapshot::isLoaded() const {
+    return data != nullptr;
+}
+
+int Snapshot::getWidth() const {
+    return isLoaded() ? ((const Header*)data)->width : 0;
+}
+
+int Snapshot::getHeight() const {
+    return isLoaded() ? ((const Header*)data)->height : 0;
+}
+
+const int32_t* Snapshot::getCells() const {
+    size_t count;
+    return (const int32_t*)findSection(CELLS, sizeof(int32_t), count);
+}
+
+const uint64_t* Snapshot::getPassable() const {
+    size_t count;
+    return (const uint64_t*)findSection(PASSABLE, sizeof(uint64_t), count);
+}
+
+const FlatPoint* Snapshot::getHouses(size_t& count) const {
+    return (const FlatPoint*)findSection(HOUSES, sizeof(FlatPoint), count);
+}
+
+/**
+ * Hub locations as (row, col) pairs like City uses
+ */
+std::vector<std::pair<int,int>> Snapshot::getHubs() const {
+    size_t count;
+    const int32_t* hubs = (const int32_t*)findSection(HUBS, sizeof(int32_t), count);
+    std::vector<std::pair<int,int>> locations;
+    for (size_t i = 0; i + 1 < count; i += 2) {
+        locations.push_back(std::make_pair(hubs[i], hubs[i + 1]));
+    }
+    return locations;
+}
+
+const FlatQuadtreeNode* Snapshot::getQuadtreeNodes(size_t& count) const {
+    return (const FlatQuadtreeNode*)findSection(QUADTREE_NODES, sizeof(FlatQuadtreeNode), count);
+}
+
+const FlatPoint* Snapshot::getQuadtreePoints(size_t& count) const {
+    return (const FlatPoint*)findSection(QUADTREE_POINTS, sizeof(FlatPoint), count);
+}
@@ -0,0 +1,84 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "quadtree.h"
+#include "mapreader.h"
+
+/*
+ * A prepared session as one block of bytes with no pointers in it, so it can be written to a file and later mapped
+ * straight back into memory (mmap) and used in place without parsing or rebuilding anything.
+ * The file is a header, a table of sections and then the sections themselves, each aligned to 64 bytes.
+ * Sections hold plain arrays: the map cells, the packed road mask, the houses, the hubs and the flattened quadtree.
+ * Readers skip sections they dont know about, so new preprocessing can be added as new sections
+ */
+class Snapshot {
+public:
+    // section ids, never reuse or renumber these, old files depend on them
+    enum Section : uint32_t {
+        CELLS = 1,           // int32 per cell in row order, the map value (0 empty, -1 road, -2 hub, houses > 0)
+        PASSABLE = 2,        // uint64 words, one bit per cell that can be driven on
+        HOUSES = 3,          // FlatPoint per house
+        HUBS = 4,            // int32 (row, col) pair per hub
+        QUADTREE_NODES = 5,  // FlatQuadtreeNode per node, node 0 is the root
+        QUADTREE_POINTS = 6  // FlatPoint per point stored in the quadtree
+    };
+
+    Snapshot();
+    ~Snapshot();
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+    void build(const MapReader& map);
+    bool open(const std::string& path);
+    bool save(const std::string& path) const;
+
+    bool isLoaded() const;
+    int getWidth() const;
+    int getHeight() const;
+
+    const int32_t* getCells() const;
+    const uint64_t* getPassable() const;
+    const FlatPoint* getHouses(size_t& count) const;
+    std::vector<std::pair<int,int>> getHubs() const;
+    const FlatQuadtreeNode* getQuadtreeNodes(size_t& count) const;
+    const FlatPoint* getQuadtreePoints(size_t& count) const;
+
+private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder; // ENDIAN_MARKER as written by the machine that saved the file
+        int32_t width;
+        int32_t height;
+        uint32_t sectionCount;
+        uint32_t padding;
+    };
+    struct SectionEntry {
+        uint32_t id;
+        uint32_t padding;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    static const uint32_t VERSION = 1;
+    static const uint32_t ENDIAN_MARKER = 0x01020304;
+    static const size_t ALIGNMENT = 64;
+
+    // either the bytes we built ourselves (kept as uint64 so they are aligned) or a mapping of a file
+    std::vector<uint64_t> image;
+    const char* data = nullptr;
+    size_t size = 0;
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+
+    const void* findSection(uint32_t id, size_t elementSize, size_t& count) const;
+    bool validate(const std::string& path);
+    void release();
+};
+
+#endif
@@ -0,0 +1,52 @@
+#include "threadpool.h"
+
+/**
+ * Constructor for a thread pool
+ * @param threads the amount of worker threads, 0 uses one per hardware thread
+ */
+ThreadPool::ThreadPool(int threads) {
+    if (threads <= 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    if (threads <= 0) {
+        threads = 1; // hardware_concurrency is allowed to return 0 when it cant tell
+    }
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    // let the workers finish whatever is queued and then join them
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+int ThreadPool::size() const {
+    return workers.size();
+}
+
+/**
+ * Worker loop, waits for a task and runs it until the pool is destroyed
+ */
+void ThreadPool::work() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/*
+ * Fixed size thread pool, tasks are queued with submit and picked up by whichever worker is free
+ */
+class ThreadPool {
+public:
+    explicit ThreadPool(int threads = 0);
+    ~ThreadPool();
+
+    int size() const;
+
+    /**
+     * Queue a task to run on the pool
+     * @param task any callable that takes no arguments
+     * @return a future holding the result of the task
+     */
+    template <typename Task>
+    auto submit(Task task) -> std::future<decltype(task())> {
+        auto packaged = std::make_shared<std::packaged_task<decltype(task())()>>(task);
+        std::future<decltype(task())> result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push([packaged]() { (*packaged)(); });
+        }
+        condition.notify_one();
+        return result;
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+
+    void work();
+};
+
+#endif
@@ -0,0 +1,339 @@
+#include "tiledgrid.h"
+#include "metrics.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define TILEDGRID_MMAP
+#endif
+
+static const char MAGIC[8] = {'D', 'L', 'V', 'T', 'I', 'L', 'E', '\0'};
+
+const int TiledGrid::TILE_SHIFT;
+const int TiledGrid::TILE_SIZE;
+const int TiledGrid::TILE_MASK;
+const size_t TiledGrid::TILE_BYTES;
+const size_t TiledGrid::DEFAULT_CACHE_TILES;
+
+TiledGrid::TiledGrid() {
+}
+
+TiledGrid::~TiledGrid() {
+    release();
+}
+
+/**
+ * Set the size and clear the tile table, every tile starts out not in memory
+ */
+void TiledGrid::setSize(int rows, int cols, int32_t fill, size_t cacheTiles) {
+    this->rows = rows;
+    this->cols = cols;
+    this->fill = fill;
+    tileRows = (rows + TILE_MASK) >> TILE_SHIFT;
+    tileCols = (cols + TILE_MASK) >> TILE_SHIFT;
+    size_t count = (size_t)tileRows * tileCols;
+    tiles.assign(count, nullptr);
+    used.assign(count, 0);
+    dirty.assign(count, false);
+    resident.clear();
+    hand = 0;
+    tileLoads = 0;
+    this->cacheTiles = std::max((size_t)1, cacheTiles);
+}
+
+/**
+ * Keep the whole grid in memory, for maps small enough that a file would only slow them down
+ * @param rows the amount of rows
+ * @param cols the amount of collumns
+ * @param fill the value every cell starts with
+ */
+void TiledGrid::allocate(int rows, int cols, int32_t fill) {
+    release();
+    setSize(rows, cols, fill, 0);
+    memory.assign(tiles.size() * TILE_SIZE * TILE_SIZE, 0);
+    for (size_t tile = 0; tile < tiles.size(); tile++) {
+        tiles[tile] = memory.data() + tile * TILE_SIZE * TILE_SIZE;
+    }
+}
+
+/**
+ * Make a new tile file with every cell set to fill. The file is only as big on disk as the tiles written to
+ * @param path where to make the file, an existing file is replaced
+ * @param rows the amount of rows
+ * @param cols the amount of collumns
+ * @param fill the value every cell starts with
+ * @param cacheTiles the most tiles kept in memory at once
+ * @return false if the file could not be made
+ */
+bool TiledGrid::create(const std::string& path, int rows, int cols, int32_t fill, size_t cacheTiles) {
+    release();
+    setSize(rows, cols, fill, cacheTiles);
+    // the header takes up the first tile sized block so every tile starts on a page boundary
+    if (!openFile(path, true, (tiles.size() + 1) * TILE_BYTES)) {
+        return false;
+    }
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.byteOrder = ENDIAN_MARKER;
+    header.rows = rows;
+    header.cols = cols;
+    header.tileSize = TILE_SIZE;
+    header.fill = fill;
+#ifdef TILEDGRID_MMAP
+    bool written = pwrite(file, &header, sizeof(header), 0) == (ssize_t)sizeof(header);
+#else
+    stream.seekp(0);
+    bool written = (bool)stream.write((const char*)&header, sizeof(header));
+#endif
+    if (!written) {
+        std::cerr << "Error writing tile file " << path << std::endl;
+        release();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Open a tile file made by create, no tiles are read until they are used
+ * @param path the tile file
+ * @param cacheTiles the most tiles kept in memory at once
+ * @return false if the file could not be opened or is not a tile file this version understands
+ */
+bool TiledGrid::open(const std::string& path, size_t cacheTiles) {
+    release();
+    if (!openFile(path, false, 0)) {
+        return false;
+    }
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+#ifdef TILEDGRID_MMAP
+    bool read = pread(file, &header, sizeof(header), 0) == (ssize_t)sizeof(header);
+    struct stat info;
+    size_t fileSize = fstat(file, &info) == 0 ? info.st_size : 0;
+#else
+    stream.seekg(0, std::ios::end);
+    size_t fileSize = stream.tellg();
+    stream.seekg(0);
+    bool read = (bool)stream.read((char*)&header, sizeof(header));
+#endif
+    const char* problem = nullptr;
+    if (!read || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        problem = "is not a tile file";
+    } else if (header.byteOrder != ENDIAN_MARKER) {
+        problem = "was written on a machine with a different byte order";
+    } else if (header.version != VERSION || header.tileSize != TILE_SIZE) {
+        problem = "was written by a different version";
+    } else if (header.rows <= 0 || header.cols <= 0) {
+        problem = "has no cells";
+    } else {
+        setSize(header.rows, header.cols, header.fill, cacheTiles);
+        if (fileSize < (tiles.size() + 1) * TILE_BYTES) {
+            problem = "is cut short";
+        }
+    }
+    if (problem != nullptr) {
+        std::cerr << "Tile file " << path << " " << problem << "." << std::endl;
+        release();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Open (or make) the file behind the grid
+ * @param fileSize the size to make a new file, untouched tiles are left as holes
+ */
+bool TiledGrid::openFile(const std::string& path, bool create, size_t fileSize) {
+    this->path = path;
+#ifdef TILEDGRID_MMAP
+    if (TILE_BYTES % sysconf(_SC_PAGESIZE) != 0) {
+        std::cerr << "Tiles of " << TILE_BYTES << " bytes cant be mapped with pages of " << sysconf(_SC_PAGESIZE) << " bytes." << std::endl;
+        return false;
+    }
+    file = ::open(path.c_str(), create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0644);
+    if (file < 0 || (create && ftruncate(file, fileSize) < 0)) {
+        std::cerr << "Error opening tile file " << path << std::endl;
+        release();
+        return false;
+    }
+#else
+    std::ios::openmode mode = std::ios::in | std::ios::out | std::ios::binary;
+    stream.open(path, create ? mode | std::ios::trunc : mode);
+    if (create && stream) {
+        stream.seekp(fileSize - 1);
+        stream.put(0);
+    }
+    if (!stream) {
+        std::cerr << "Error opening tile file " << path << std::endl;
+        release();
+        return false;
+    }
+#endif
+    return true;
+}
+
+/**
+ * Bring a tile into memory. Once the cache is full the clock hand goes round the resident tiles, a tile used since
+ * the hand last passed it gets another round and the first one that wasnt is dropped to make room. Every access only
+ * marks its tile, and the hand clears at most one mark per tile before it finds one, so making room is O(1) on average
+ * @param tile the index of the tile (tileRow * tileCols + tileCol)
+ */
+void TiledGrid::load(size_t tile) {
+    size_t slot = resident.size();
+    if (resident.size() >= cacheTiles) {
+        while (used[resident[hand]]) {
+            used[resident[hand]] = 0;
+            hand = (hand + 1) % resident.size();
+        }
+        slot = hand;
+        hand = (hand + 1) % resident.size();
+        unload(resident[slot]);
+    } else {
+        resident.push_back(tile);
+    }
+    size_t offset = (tile + 1) * TILE_BYTES;
+#ifdef TILEDGRID_MMAP
+    // shared so writes land in the file, the kernel writes them back after the tile is unmapped
+    void* mapped = mmap(nullptr, TILE_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, file, offset);
+    if (mapped == MAP_FAILED) {
+        // every cell access goes through here so there is no one to hand an error back to
+        std::cerr << "Error mapping tile " << tile << " of " << path << std::endl;
+        std::abort();
+    }
+    tiles[tile] = (int32_t*)mapped;
+#else
+    int32_t* cells = new int32_t[TILE_SIZE * TILE_SIZE];
+    stream.seekg(offset);
+    stream.read((char*)cells, TILE_BYTES);
+    tiles[tile] = cells;
+#endif
+    resident[slot] = tile;
+    tileLoads++;
+}
+
+/**
+ * Drop a tile out of memory, without mmap it is written back first if it was changed. The caller takes it out of
+ * resident
+ * @param tile the index of the tile, it has to be in memory
+ */
+void TiledGrid::unload(size_t tile) {
+#ifdef TILEDGRID_MMAP
+    munmap(tiles[tile], TILE_BYTES);
+#else
+    if (dirty[tile]) {
+        stream.seekp((tile + 1) * TILE_BYTES);
+        stream.write((const char*)tiles[tile], TILE_BYTES);
+    }
+    delete[] tiles[tile];
+#endif
+    tiles[tile] = nullptr;
+    dirty[tile] = false;
+}
+
+/**
+ * Make sure every change so far is in the file
+ * @return false if it could not be written
+ */
+bool TiledGrid::flush() {
+    if (!isFileBacked()) {
+        return true;
+    }
+#ifdef TILEDGRID_MMAP
+    for (size_t tile : resident) {
+        if (dirty[tile] && msync(tiles[tile], TILE_BYTES, MS_SYNC) < 0) {
+            std::cerr << "Error writing tile file " << path << std::endl;
+            return false;
+        }
+        dirty[tile] = false;
+    }
+    if (fsync(file) < 0) {
+        std::cerr << "Error writing tile file " << path << std::endl;
+        return false;
+    }
+#else
+    for (size_t tile : resident) {
+        if (dirty[tile]) {
+            stream.seekp((tile + 1) * TILE_BYTES);
+            stream.write((const char*)tiles[tile], TILE_BYTES);
+            dirty[tile] = false;
+        }
+    }
+    if (!stream.flush()) {
+        std::cerr << "Error writing tile file " << path << std::endl;
+        return false;
+    }
+#endif
+    return true;
+}
+
+/**
+ * Drop whatever the grid holds, unmapping every tile and closing the file if there is one
+ */
+void TiledGrid::release() {
+    if (isFileBacked()) {
+        METRICS_COUNT("tiled_grid.tile_loads", tileLoads);
+        for (size_t tile : resident) {
+            unload(tile);
+        }
+    }
+#ifdef TILEDGRID_MMAP
+    if (file >= 0) {
+        ::close(file);
+    }
+#endif
+    file = -1;
+    if (stream.is_open()) {
+        stream.close();
+    }
+    tiles.clear();
+    memory.clear();
+    memory.shrink_to_fit();
+    used.clear();
+    resident.clear();
+    hand = 0;
+    dirty.clear();
+    rows = 0;
+    cols = 0;
+}
+
+int TiledGrid::getRows() const {
+    return rows;
+}
+
+int TiledGrid::getCols() const {
+    return cols;
+}
+
+/**
+ * @return the value cells have before anything is written to them
+ */
+int32_t TiledGrid::getFill() const {
+    return fill;
+}
+
+bool TiledGrid::isFileBacked() const {
+    return file >= 0 || stream.is_open();
+}
+
+/**
+ * @return how many tiles are in memory right now, all of them without a file
+ */
+size_t TiledGrid::getResidentTiles() const {
+    return isFileBacked() ? resident.size() : tiles.size();
+}
+
+/**
+ * @return how many times a tile had to be brought in from the file
+ */
+long long TiledGrid::getTileLoads() const {
+    return tileLoads;
+}
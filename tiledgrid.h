@@ -0,0 +1,123 @@
+#ifndef TILEDGRID_H
+#define TILEDGRID_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*
+ * A grid of int32 cells cut into fixed size square tiles, either all kept in memory or stored in a file of which only
+ * a bounded number of tiles are mapped in (mmap) at a time. A tile that hasnt been used for a while is unmapped when
+ * a new one is needed (the clock algorithm, close to least recently used), so a map far bigger than memory can be
+ * generated, routed on and written out with a resident set of about cacheTiles * 16 KB. Nothing is paged in for tiles that are never touched.
+ * Cells are stored XORed with the fill value so a new file can be created sparse (all zero bytes) and still read back
+ * as fill everywhere. Coordinates are (row, col) like City
+ */
+class TiledGrid {
+public:
+    // 64x64 cells, a tile is 16 KB which is a whole number of pages so every tile can be mapped on its own
+    static const int TILE_SHIFT = 6;
+    static const int TILE_SIZE = 1 << TILE_SHIFT;
+    static const int TILE_MASK = TILE_SIZE - 1;
+    static const size_t TILE_BYTES = (size_t)TILE_SIZE * TILE_SIZE * sizeof(int32_t);
+    // tiles kept mapped in when no cache size is given, 16 MB
+    static const size_t DEFAULT_CACHE_TILES = 1024;
+
+    TiledGrid();
+    ~TiledGrid();
+    TiledGrid(const TiledGrid&) = delete;
+    TiledGrid& operator=(const TiledGrid&) = delete;
+
+    void allocate(int rows, int cols, int32_t fill);
+    bool create(const std::string& path, int rows, int cols, int32_t fill, size_t cacheTiles = DEFAULT_CACHE_TILES);
+    bool open(const std::string& path, size_t cacheTiles = DEFAULT_CACHE_TILES);
+    bool flush();
+
+    int getRows() const;
+    int getCols() const;
+    int32_t getFill() const;
+    bool isFileBacked() const;
+    size_t getResidentTiles() const;
+    long long getTileLoads() const;
+
+    /**
+     * @return the value of the cell at row, col, which has to be inside the grid
+     */
+    int32_t get(int row, int col) {
+        return tileAt(tileIndex(row, col))[cellIndex(row, col)] ^ fill;
+    }
+
+    /**
+     * Change the value of the cell at row, col, which has to be inside the grid
+     */
+    void set(int row, int col, int32_t value) {
+        size_t tile = tileIndex(row, col);
+        tileAt(tile)[cellIndex(row, col)] = value ^ fill;
+        dirty[tile] = true;
+    }
+
+private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder; // ENDIAN_MARKER as written by the machine that made the file
+        int32_t rows;
+        int32_t cols;
+        int32_t tileSize;
+        int32_t fill;
+    };
+
+    static const uint32_t VERSION = 1;
+    static const uint32_t ENDIAN_MARKER = 0x01020304;
+
+    int rows = 0;
+    int cols = 0;
+    int tileRows = 0;
+    int tileCols = 0;
+    int32_t fill = 0;
+
+    // the cells of every tile that is in memory, nullptr for the others. without a file they all point into memory
+    std::vector<int32_t*> tiles;
+    std::vector<int32_t> memory;
+    // file backed tiles: whether each was used since the clock hand last passed it, the ones in memory and whether
+    // they were written to. the hand goes round resident looking for a tile to drop
+    std::vector<uint8_t> used;
+    std::vector<size_t> resident;
+    std::vector<bool> dirty;
+    size_t hand = 0;
+    size_t cacheTiles = 0;
+    long long tileLoads = 0;
+
+    int file = -1;
+    std::fstream stream; // used instead of mmap where there is none
+    std::string path;
+
+    size_t tileIndex(int row, int col) const {
+        return (size_t)(row >> TILE_SHIFT) * tileCols + (col >> TILE_SHIFT);
+    }
+
+    static int cellIndex(int row, int col) {
+        return ((row & TILE_MASK) << TILE_SHIFT) | (col & TILE_MASK);
+    }
+
+    /**
+     * @return the cells of a tile, loaded in first if it isnt in memory
+     */
+    int32_t* tileAt(size_t tile) {
+        if (tiles[tile] == nullptr) {
+            load(tile);
+        }
+        used[tile] = 1;
+        return tiles[tile];
+    }
+
+    void setSize(int rows, int cols, int32_t fill, size_t cacheTiles);
+    bool openFile(const std::string& path, bool create, size_t fileSize);
+    void load(size_t tile);
+    void unload(size_t tile);
+    void release();
+};
+
+#endif
@@ -0,0 +1,234 @@
+#include "tiledrouter.h"
+#include "metrics.h"
+#include "directions.h"
+#include "searchtree.h"
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+const int TiledRouter::UNREACHABLE;
+
+/**
+ * Constructor, nothing is read from the grid until a search needs it
+ * @param grid the map, cells at the fill value are empty. it has to outlive the router
+ */
+TiledRouter::TiledRouter(TiledGrid& grid) : grid(grid) {
+    rows = grid.getRows();
+    cols = grid.getCols();
+    tileCols = (cols + TiledGrid::TILE_MASK) >> TiledGrid::TILE_SHIFT;
+    int tileRows = (rows + TiledGrid::TILE_MASK) >> TiledGrid::TILE_SHIFT;
+    empty = grid.getFill();
+    blockOf = std::vector<int>((size_t)tileRows * tileCols, -1);
+}
+
+bool TiledRouter::isPassable(int x, int y) {
+    return grid.get(y, x) != empty;
+}
+
+/**
+ * The search state of a cell, the block for its tile is handed out (or made) the first time the tile is reached
+ */
+int32_t& TiledRouter::stateOf(int x, int y) {
+    int tile = (y >> TiledGrid::TILE_SHIFT) * tileCols + (x >> TiledGrid::TILE_SHIFT);
+    if (blockOf[tile] < 0) {
+        if (usedTiles.size() == blocks.size()) {
+            blocks.push_back(std::vector<int32_t>(TiledGrid::TILE_SIZE * TiledGrid::TILE_SIZE));
+        }
+        blockOf[tile] = usedTiles.size();
+        std::fill(blocks[blockOf[tile]].begin(), blocks[blockOf[tile]].end(), -1);
+        usedTiles.push_back(tile);
+    }
+    return blocks[blockOf[tile]][((y & TiledGrid::TILE_MASK) << TiledGrid::TILE_SHIFT) | (x & TiledGrid::TILE_MASK)];
+}
+
+/**
+ * @return the search state of a cell, -1 if the search hasnt reached it (without making a block for it)
+ */
+int32_t TiledRouter::stateIfReached(int x, int y) const {
+    int tile = (y >> TiledGrid::TILE_SHIFT) * tileCols + (x >> TiledGrid::TILE_SHIFT);
+    if (blockOf[tile] < 0) {
+        return -1;
+    }
+    return blocks[blockOf[tile]][((y & TiledGrid::TILE_MASK) << TiledGrid::TILE_SHIFT) | (x & TiledGrid::TILE_MASK)];
+}
+
+/**
+ * Hand every block back so the next search starts with nothing reached
+ */
+void TiledRouter::reset() {
+    for (int tile : usedTiles) {
+        blockOf[tile] = -1;
+    }
+    usedTiles.clear();
+}
+
+/**
+ * A* from start to end, leaves the distances and parent directions in the blocks
+ * @return the distance in steps, UNREACHABLE if the end cant be reached
+ */
+int TiledRouter::search(int startX, int startY, int endX, int endY) {
+    reset();
+    if (!isPassable(startX, startY) || !isPassable(endX, endY)) {
+        return UNREACHABLE;
+    }
+    long long popped = 0;
+    long long pushes = 1;
+
+    // ((distance + manhattan, manhattan), (x, y)), on equal estimates the cell closer to the end is expanded first
+    typedef std::pair<std::pair<int, int>, std::pair<int, int>> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> pq;
+    stateOf(startX, startY) = 0;
+    int startBound = std::abs(endX - startX) + std::abs(endY - startY);
+    pq.push(Entry(std::make_pair(startBound, startBound), std::make_pair(startX, startY)));
+
+    int result = UNREACHABLE;
+    while (!pq.empty()) {
+        int x = pq.top().second.first;
+        int y = pq.top().second.second;
+        int distance = pq.top().first.first - pq.top().first.second;
+        pq.pop();
+        // skip entries for cells that were pushed again with a shorter distance
+        if ((stateOf(x, y) >> 2) != distance) {
+            continue;
+        }
+        popped++;
+        if (x == endX && y == endY) {
+            result = distance;
+            break;
+        }
+        for (int direction = 0; direction < 4; direction++) {
+            int newX = x + DIRECTION_X[direction];
+            int newY = y + DIRECTION_Y[direction];
+            if (newX < 0 || newX >= cols || newY < 0 || newY >= rows || !isPassable(newX, newY)) {
+                continue;
+            }
+            int32_t& state = stateOf(newX, newY);
+            if (state < 0 || (state >> 2) > distance + 1) {
+                state = (distance + 1) << 2 | direction;
+                int bound = std::abs(endX - newX) + std::abs(endY - newY);
+                pq.push(Entry(std::make_pair(distance + 1 + bound, bound), std::make_pair(newX, newY)));
+                pushes++;
+            }
+        }
+    }
+    METRICS_COUNT("tiled_router.nodes_popped", popped);
+    METRICS_COUNT("tiled_router.pushes", pushes);
+    METRICS_COUNT("tiled_router.state_tiles", usedTiles.size());
+    return result;
+}
+
+/**
+ * Shortest path between two cells
+ * @return the path from start to end, just the end cell if it cant be reached (like Dijkstra)
+ */
+CompactPath TiledRouter::findShortestPath(int startX, int startY, int endX, int endY) {
+    METRICS_TIMER("tiled_router.find_shortest_path");
+    if (search(startX, startY, endX, endY) == UNREACHABLE) {
+        return CompactPath(endX, endY);
+    }
+
+    return walkParents(startX, startY, endX, endY, [this](int x, int y) { return stateIfReached(x, y) & 3; });
+}
+
+/**
+ * @return the length of the shortest path in steps, UNREACHABLE if there is none
+ */
+int TiledRouter::findDistance(int startX, int startY, int endX, int endY) {
+    METRICS_TIMER("tiled_router.find_distance");
+    return search(startX, startY, endX, endY);
+}
+
+/**
+ * One to many search from the start that stops as soon as every target has been reached, the paths to the targets are
+ * walked out of it before the next search reuses the blocks. Planning a route over n stops takes n of these instead
+ * of n * n point to point searches, each of which would pull its own tiles through the cache
+ * @param targets the targets as (x, y) pairs
+ * @param distances gets the distance to each target in the same order as targets, UNREACHABLE if there is no path
+ * @return the path to each target in the same order, just the target cell if it cant be reached (like Dijkstra)
+ */
+std::vector<CompactPath> TiledRouter::findShortestPaths(int startX, int startY, const std::vector<std::pair<int, int>>& targets,
+                                                        std::vector<int>& distances) {
+    METRICS_TIMER("tiled_router.find_shortest_paths");
+    reset();
+    distances.assign(targets.size(), UNREACHABLE);
+    long long popped = 0;
+    long long pushes = 1;
+
+    // the targets sorted by cell so a reached cell can be matched to every target on it with a binary search, a
+    // target on an empty cell can never be reached so the search doesnt wait for it
+    std::vector<std::pair<long long, int>> targetCells;
+    for (int i = 0; i < targets.size(); i++) {
+        if (isPassable(targets[i].first, targets[i].second)) {
+            targetCells.push_back(std::make_pair((long long)targets[i].second * cols + targets[i].first, i));
+        }
+    }
+    std::sort(targetCells.begin(), targetCells.end());
+    int remaining = targetCells.size();
+
+    // records the distance of a cell if it is a target and returns how many targets were on it
+    auto reachTarget = [&](int x, int y, int distance) {
+        long long cell = (long long)y * cols + x;
+        auto it = std::lower_bound(targetCells.begin(), targetCells.end(), std::make_pair(cell, -1));
+        int found = 0;
+        for (; it != targetCells.end() && it->first == cell; ++it) {
+            distances[it->second] = distance;
+            found++;
+        }
+        return found;
+    };
+
+    // every step costs 1 so a first in first out queue reaches cells in order of distance, a cell is done the first
+    // time it is reached like in Dijkstra::findDistances
+    std::queue<std::pair<int, int>> queue;
+    if (isPassable(startX, startY)) {
+        stateOf(startX, startY) = 0;
+        queue.push(std::make_pair(startX, startY));
+        remaining -= reachTarget(startX, startY, 0);
+    }
+    while (!queue.empty() && remaining > 0) {
+        int x = queue.front().first;
+        int y = queue.front().second;
+        int distance = stateOf(x, y) >> 2;
+        queue.pop();
+        popped++;
+        for (int direction = 0; direction < 4; direction++) {
+            int newX = x + DIRECTION_X[direction];
+            int newY = y + DIRECTION_Y[direction];
+            if (newX < 0 || newX >= cols || newY < 0 || newY >= rows || !isPassable(newX, newY)) {
+                continue;
+            }
+            int32_t& state = stateOf(newX, newY);
+            if (state < 0) {
+                state = (distance + 1) << 2 | direction;
+                remaining -= reachTarget(newX, newY, distance + 1);
+                queue.push(std::make_pair(newX, newY));
+                pushes++;
+            }
+        }
+    }
+    METRICS_COUNT("tiled_router.one_to_many.nodes_popped", popped);
+    METRICS_COUNT("tiled_router.one_to_many.pushes", pushes);
+    METRICS_COUNT("tiled_router.state_tiles", usedTiles.size());
+
+    std::vector<CompactPath> paths;
+    for (int i = 0; i < targets.size(); i++) {
+        int endX = targets[i].first;
+        int endY = targets[i].second;
+        if (distances[i] == UNREACHABLE) {
+            paths.push_back(CompactPath(endX, endY));
+        } else {
+            paths.push_back(walkParents(startX, startY, endX, endY, [this](int x, int y) { return stateIfReached(x, y) & 3; }));
+        }
+    }
+    return paths;
+}
+
+/**
+ * @return how many tiles of search state the last search needed, the rest of the map never got any
+ */
+size_t TiledRouter::getStateTiles() const {
+    return usedTiles.size();
+}
@@ -0,0 +1,50 @@
+#ifndef TILEDROUTER_H
+#define TILEDROUTER_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "compactpath.h"
+#include "tiledgrid.h"
+
+/*
+ * A* with the manhattan distance on a TiledGrid, for maps too big to hold a road mask or search state for every cell.
+ * Cells are read through the grid's tile cache and the search state is kept per tile as well, a tile of state is only
+ * made once the search reaches that tile. Memory follows how far the search spreads, not how big the map is.
+ * Cells still at the grid's fill value are empty and cant be driven on, everything else can (like a 0 in map.txt).
+ * Every step costs 1 so the paths are as long as Dijkstra's. Coordinates are (x, y) like Dijkstra
+ */
+class TiledRouter {
+public:
+    // distance reported for targets that cant be reached
+    static const int UNREACHABLE = INT32_MAX / 4;
+
+    explicit TiledRouter(TiledGrid& grid);
+
+    CompactPath findShortestPath(int startX, int startY, int endX, int endY);
+    int findDistance(int startX, int startY, int endX, int endY);
+    std::vector<CompactPath> findShortestPaths(int startX, int startY, const std::vector<std::pair<int, int>>& targets,
+                                               std::vector<int>& distances);
+    size_t getStateTiles() const;
+
+private:
+    TiledGrid& grid;
+    int rows;
+    int cols;
+    int tileCols;
+    int32_t empty;
+
+    // one block of TILE_SIZE * TILE_SIZE cells per tile the search reached, (distance << 2 | parent direction)
+    // or -1 if the cell hasnt been reached. blocks are kept for the next search instead of freed
+    std::vector<std::vector<int32_t>> blocks;
+    std::vector<int> blockOf; // the block of every tile, -1 if the search hasnt reached it
+    std::vector<int> usedTiles;
+
+    bool isPassable(int x, int y);
+    int32_t& stateOf(int x, int y);
+    int32_t stateIfReached(int x, int y) const;
+    void reset();
+    int search(int startX, int startY, int endX, int endY);
+};
+
+#endif
@@ -0,0 +1,200 @@
+#include "timedependentrouter.h"
+#include "metrics.h"
+#include "directions.h"
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+#include <vector>
+
+const int TimeDependentRouter::UNREACHABLE;
+
+/**
+ * Constructor
+ * @param rows the amount of rows in the grid
+ * @param cols the amount of collumns in the grid
+ * @param passable (rows * cols + 63) / 64 words, bit i is set if cell i can be driven on
+ * @param profiles the travel times of every cell, kept by reference so it can be changed between searches
+ */
+TimeDependentRouter::TimeDependentRouter(int rows, int cols, const uint64_t* passable, const TrafficProfiles& profiles)
+    : profiles(profiles) {
+    this->rows = rows;
+    this->cols = cols;
+    int cells = rows * cols;
+    this->passable = std::vector<uint64_t>(passable, passable + (cells + 63) / 64);
+    arrivals = std::vector<int>(cells, UNREACHABLE);
+    settled = std::vector<uint64_t>((cells + 63) / 64, 0);
+    parents = std::vector<uint8_t>(cells, 0);
+}
+
+bool TimeDependentRouter::isPassable(int index) const {
+    return (passable[index >> 6] >> (index & 63)) & 1;
+}
+
+/**
+ * Open or close a cell, so closures made after the router was built are driven around
+ */
+void TimeDependentRouter::setPassable(int x, int y, bool open) {
+    int index = y * cols + x;
+    if (open) {
+        passable[index >> 6] |= (uint64_t)1 << (index & 63);
+    } else {
+        passable[index >> 6] &= ~((uint64_t)1 << (index & 63));
+    }
+}
+
+bool TimeDependentRouter::isSettled(int index) const {
+    return (settled[index >> 6] >> (index & 63)) & 1;
+}
+
+void TimeDependentRouter::reach(int index, int arrival, int direction) {
+    if (arrivals[index] == UNREACHABLE) {
+        touched.push_back(index);
+    }
+    arrivals[index] = arrival;
+    parents[index] = direction;
+}
+
+/**
+ * Clear only the cells the last search touched, a short route doesnt pay for the whole grid
+ */
+void TimeDependentRouter::reset() {
+    for (int index : touched) {
+        arrivals[index] = UNREACHABLE;
+        settled[index >> 6] &= ~((uint64_t)1 << (index & 63));
+    }
+    touched.clear();
+}
+
+/**
+ * Fastest path leaving at a given time
+ * @param departure the time we leave the start, in seconds
+ * @param arrival set to the time we reach the end, UNREACHABLE if there is no path
+ * @return the path as (x, y) pairs from start to end, just the end if it cant be reached
+ */
+std::vector<std::pair<int, int>> TimeDependentRouter::findFastestPath(int startX, int startY, int endX, int endY, int departure, int& arrival) {
+    METRICS_TIMER("time_dependent_router.find_fastest_path");
+    reset();
+    long long popped = 0;
+    long long stale = 0;
+    int minimum = profiles.getMinimumTravelTime();
+    auto heuristic = [&](int index) {
+        return (std::abs(index % cols - endX) + std::abs(index / cols - endY)) * minimum;
+    };
+
+    // (arrival + heuristic, cell), a cell can be in the queue more than once and only its best entry is expanded
+    std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>, std::greater<std::pair<int, int>>> pq;
+    int startIndex = startY * cols + startX;
+    int endIndex = endY * cols + endX;
+    reach(startIndex, departure, 0);
+    pq.push(std::make_pair(departure + heuristic(startIndex), startIndex));
+
+    while (!pq.empty()) {
+        int index = pq.top().second;
+        pq.pop();
+        if (isSettled(index)) {
+            stale++;
+            continue;
+        }
+        settled[index >> 6] |= (uint64_t)1 << (index & 63);
+        popped++;
+        if (index == endIndex) {
+            break;
+        }
+        int time = arrivals[index];
+        int x = index % cols;
+        int y = index / cols;
+        for (int direction = 0; direction < 4; direction++) {
+            int newX = x + DIRECTION_X[direction];
+            int newY = y + DIRECTION_Y[direction];
+            if (newX < 0 || newX >= cols || newY < 0 || newY >= rows) {
+                continue;
+            }
+            int newIndex = newY * cols + newX;
+            if (!isPassable(newIndex) || isSettled(newIndex)) {
+                continue;
+            }
+            int newTime = time + profiles.travelTime(newIndex, time);
+            if (newTime < arrivals[newIndex]) {
+                reach(newIndex, newTime, direction);
+                pq.push(std::make_pair(newTime + heuristic(newIndex), newIndex));
+            }
+        }
+    }
+    METRICS_COUNT("time_dependent_router.nodes_popped", popped);
+    METRICS_COUNT("time_dependent_router.stale_pops", stale);
+
+    std::vector<std::pair<int, int>> path;
+    path.push_back(std::make_pair(endX, endY));
+    if (!isSettled(endIndex)) {
+        arrival = UNREACHABLE;
+        return path;
+    }
+    arrival = arrivals[endIndex];
+    int index = endIndex;
+    while (index != startIndex) {
+        int direction = parents[index];
+        index -= DIRECTION_Y[direction] * cols + DIRECTION_X[direction];
+        path.push_back(std::make_pair(index % cols, index / cols));
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+/**
+ * One to many search, the earliest arrival at every target leaving the start at a given time, for ETAs
+ * the search stops as soon as every target has been settled
+ * @param departure the time we leave the start, in seconds
+ * @param targets the targets as (x, y) pairs
+ * @return the arrival time at each target in the same order as targets, UNREACHABLE if there is no path
+ */
+std::vector<int> TimeDependentRouter::findArrivalTimes(int startX, int startY, int departure, const std::vector<std::pair<int, int>>& targets) {
+    METRICS_TIMER("time_dependent_router.find_arrival_times");
+    reset();
+    std::vector<int> result(targets.size(), UNREACHABLE);
+    std::vector<std::pair<int, int>> targetCells;
+    for (int i = 0; i < targets.size(); i++) {
+        targetCells.push_back(std::make_pair(targets[i].second * cols + targets[i].first, i));
+    }
+    std::sort(targetCells.begin(), targetCells.end());
+    int remaining = targetCells.size();
+
+    std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>, std::greater<std::pair<int, int>>> pq;
+    int startIndex = startY * cols + startX;
+    reach(startIndex, departure, 0);
+    pq.push(std::make_pair(departure, startIndex));
+
+    while (!pq.empty() && remaining > 0) {
+        int time = pq.top().first;
+        int index = pq.top().second;
+        pq.pop();
+        if (isSettled(index)) {
+            continue;
+        }
+        settled[index >> 6] |= (uint64_t)1 << (index & 63);
+        auto it = std::lower_bound(targetCells.begin(), targetCells.end(), std::make_pair(index, -1));
+        for (; it != targetCells.end() && it->first == index; ++it) {
+            result[it->second] = time;
+            remaining--;
+        }
+        int x = index % cols;
+        int y = index / cols;
+        for (int direction = 0; direction < 4; direction++) {
+            int newX = x + DIRECTION_X[direction];
+            int newY = y + DIRECTION_Y[direction];
+            if (newX < 0 || newX >= cols || newY < 0 || newY >= rows) {
+                continue;
+            }
+            int newIndex = newY * cols + newX;
+            if (!isPassable(newIndex) || isSettled(newIndex)) {
+                continue;
+            }
+            int newTime = time + profiles.travelTime(newIndex, time);
+            if (newTime < arrivals[newIndex]) {
+                reach(newIndex, newTime, direction);
+                pq.push(std::make_pair(newTime, newIndex));
+            }
+        }
+    }
+    return result;
+}
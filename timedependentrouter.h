@@ -0,0 +1,44 @@
+#ifndef TIMEDEPENDENTROUTER_H
+#define TIMEDEPENDENTROUTER_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "trafficprofile.h"
+
+/*
+ * Time dependent routing, finds the fastest path when the travel time of every cell depends on when it is entered.
+ * The search is Dijkstra on arrival times instead of step counts, made into A* with the manhattan distance times the
+ * fastest possible travel time of a cell as the heuristic. Because every profile is FIFO the first time a cell is
+ * settled is also its earliest arrival, so each cell is only expanded once.
+ * Coordinates are (x, y) like Dijkstra, times are seconds like TrafficProfiles
+ */
+class TimeDependentRouter {
+public:
+    // arrival time reported for cells that cant be reached
+    static const int UNREACHABLE = INT32_MAX / 4;
+
+    TimeDependentRouter(int rows, int cols, const uint64_t* passable, const TrafficProfiles& profiles);
+
+    std::vector<std::pair<int, int>> findFastestPath(int startX, int startY, int endX, int endY, int departure, int& arrival);
+    std::vector<int> findArrivalTimes(int startX, int startY, int departure, const std::vector<std::pair<int, int>>& targets);
+    void setPassable(int x, int y, bool open);
+
+private:
+    int rows;
+    int cols;
+    std::vector<uint64_t> passable;
+    const TrafficProfiles& profiles;
+    // earliest arrival at every cell, only the cells a search touched are reset afterwards
+    std::vector<int> arrivals;
+    std::vector<uint64_t> settled;
+    std::vector<uint8_t> parents;
+    std::vector<int> touched;
+
+    bool isPassable(int index) const;
+    bool isSettled(int index) const;
+    void reach(int index, int arrival, int direction);
+    void reset();
+};
+
+#endif
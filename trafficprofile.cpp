@@ -0,0 +1,130 @@
+#include "trafficprofile.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+const int TrafficProfiles::DAY;
+const int TrafficProfiles::SAMPLES;
+const int TrafficProfiles::STEP;
+const int TrafficProfiles::FREE_FLOW;
+
+/**
+ * Constructor, every cell starts out as free flow
+ * @param rows the amount of rows in the grid
+ * @param cols the amount of collumns in the grid
+ * @param freeFlowSeconds how long it takes to drive through a cell without traffic
+ */
+TrafficProfiles::TrafficProfiles(int rows, int cols, int freeFlowSeconds) {
+    this->rows = rows;
+    this->cols = cols;
+    this->freeFlowSeconds = std::max(1, freeFlowSeconds);
+    minimumTravelTime = this->freeFlowSeconds;
+    cellProfiles = std::vector<uint8_t>(rows * cols, FREE_FLOW);
+    // profile 0 is stored too so the ids line up with the table, it is never read
+    table = std::vector<uint16_t>(SAMPLES + 1, this->freeFlowSeconds);
+}
+
+/**
+ * Add a travel time profile that cells can then use
+ * @param samples SAMPLES travel times in seconds, the first at midnight and then one every STEP seconds
+ * @return the id of the profile, -1 if the samples are not a valid profile
+ */
+int TrafficProfiles::addProfile(const std::vector<int>& samples) {
+    if (samples.size() != SAMPLES) {
+        std::cerr << "A traffic profile needs " << SAMPLES << " samples, got " << samples.size() << std::endl;
+        return -1;
+    }
+    if (getProfileCount() > 255) {
+        std::cerr << "Too many traffic profiles, at most 255 can be added." << std::endl;
+        return -1;
+    }
+    for (int i = 0; i < SAMPLES; i++) {
+        if (samples[i] < 1 || samples[i] > 65535) {
+            std::cerr << "Traffic profile travel times have to be between 1 and 65535 seconds." << std::endl;
+            return -1;
+        }
+        // the travel time can not drop faster than the clock moves, otherwise waiting would get you there earlier
+        if (samples[i] - samples[(i + 1) % SAMPLES] > STEP) {
+            std::cerr << "Traffic profile is not FIFO, the travel time drops by more than " << STEP << " seconds at sample " << i << std::endl;
+            return -1;
+        }
+    }
+    for (int i = 0; i <= SAMPLES; i++) {
+        table.push_back(samples[i % SAMPLES]);
+    }
+    minimumTravelTime = std::min(minimumTravelTime, *std::min_element(samples.begin(), samples.end()));
+    return getProfileCount() - 1;
+}
+
+/**
+ * Give one cell a profile
+ * @return false if the cell or the profile doesnt exist
+ */
+bool TrafficProfiles::setProfile(int x, int y, int profile) {
+    if (x < 0 || x >= cols || y < 0 || y >= rows || profile < 0 || profile >= getProfileCount()) {
+        return false;
+    }
+    cellProfiles[y * cols + x] = profile;
+    return true;
+}
+
+/**
+ * Give a straight road segment a profile, every cell from (x1, y1) to (x2, y2) including both ends
+ * @return how many cells were set, -1 if the segment isnt horizontal or vertical or leaves the grid
+ */
+int TrafficProfiles::setSegmentProfile(int x1, int y1, int x2, int y2, int profile) {
+    if ((x1 != x2 && y1 != y2) || profile < 0 || profile >= getProfileCount() ||
+        std::min(x1, x2) < 0 || std::max(x1, x2) >= cols || std::min(y1, y2) < 0 || std::max(y1, y2) >= rows) {
+        return -1;
+    }
+    int count = 0;
+    for (int y = std::min(y1, y2); y <= std::max(y1, y2); y++) {
+        for (int x = std::min(x1, x2); x <= std::max(x1, x2); x++) {
+            cellProfiles[y * cols + x] = profile;
+            count++;
+        }
+    }
+    return count;
+}
+
+int TrafficProfiles::getProfile(int x, int y) const {
+    return cellProfiles[y * cols + x];
+}
+
+/**
+ * @return the amount of profiles including free flow
+ */
+int TrafficProfiles::getProfileCount() const {
+    return table.size() / (SAMPLES + 1);
+}
+
+int TrafficProfiles::getFreeFlowSeconds() const {
+    return freeFlowSeconds;
+}
+
+/**
+ * @return the smallest travel time any cell can have at any time, a lower bound for the A* heuristic
+ */
+int TrafficProfiles::getMinimumTravelTime() const {
+    return minimumTravelTime;
+}
+
+/**
+ * Build a typical weekday profile with a morning peak around 8:00 and an evening peak around 17:30
+ * @param freeFlowSeconds the travel time outside the peaks
+ * @param morningFactor how many times slower the morning peak is
+ * @param eveningFactor how many times slower the evening peak is
+ * @return SAMPLES travel times that can be passed to addProfile
+ */
+std::vector<int> TrafficProfiles::rushHour(int freeFlowSeconds, double morningFactor, double eveningFactor) {
+    std::vector<int> samples;
+    for (int i = 0; i < SAMPLES; i++) {
+        double hour = i * STEP / 3600.0;
+        // two bell curves about an hour and a half wide on top of free flow
+        double morning = (morningFactor - 1) * std::exp(-(hour - 8.0) * (hour - 8.0) / 1.5);
+        double evening = (eveningFactor - 1) * std::exp(-(hour - 17.5) * (hour - 17.5) / 1.5);
+        samples.push_back(std::max(1, (int)std::lround(freeFlowSeconds * (1 + morning + evening))));
+    }
+    return samples;
+}
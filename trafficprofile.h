@@ -0,0 +1,68 @@
+#ifndef TRAFFICPROFILE_H
+#define TRAFFICPROFILE_H
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * How long it takes to drive through every cell of the grid at any time of the day.
+ * Travel times are piecewise linear functions over a day, stored as one sample every 15 minutes (SAMPLES per day)
+ * and interpolated in between. Cells dont store a function themselves, they store the id of a shared profile in a
+ * single byte, so a whole city needs 1 byte per cell plus a tiny table of profiles. Profile 0 is free flow, the
+ * same travel time all day, and is answered without touching the table.
+ * Times are in seconds, any time can be passed and is wrapped into the day.
+ * Every profile is checked to be FIFO (leaving later never gets you there earlier), which is what lets the time
+ * dependent search settle every cell only once like plain Dijkstra
+ */
+class TrafficProfiles {
+public:
+    static const int DAY = 24 * 60 * 60;
+    static const int SAMPLES = 96;
+    static const int STEP = DAY / SAMPLES;
+    static const int FREE_FLOW = 0;
+
+    TrafficProfiles(int rows, int cols, int freeFlowSeconds = 10);
+
+    int addProfile(const std::vector<int>& samples);
+    bool setProfile(int x, int y, int profile);
+    int setSegmentProfile(int x1, int y1, int x2, int y2, int profile);
+    int getProfile(int x, int y) const;
+    int getProfileCount() const;
+    int getFreeFlowSeconds() const;
+    int getMinimumTravelTime() const;
+
+    static std::vector<int> rushHour(int freeFlowSeconds, double morningFactor, double eveningFactor);
+
+    /**
+     * Travel time through a cell when entering it at a time, called for every neighbour in the search so it is
+     * kept inline: a table lookup and one interpolation, or nothing at all for free flow cells
+     * @param cell the cell index (y * cols + x)
+     * @param time seconds since the start of some day, can be more than a day
+     * @return the travel time in seconds
+     */
+    int travelTime(int cell, int time) const {
+        int profile = cellProfiles[cell];
+        if (profile == FREE_FLOW) {
+            return freeFlowSeconds;
+        }
+        // every profile has SAMPLES + 1 entries, the last one repeats midnight so slot + 1 never needs wrapping
+        const uint16_t* samples = &table[profile * (SAMPLES + 1)];
+        int timeOfDay = time % DAY;
+        if (timeOfDay < 0) {
+            timeOfDay += DAY;
+        }
+        int slot = timeOfDay / STEP;
+        int offset = timeOfDay - slot * STEP;
+        return samples[slot] + (samples[slot + 1] - samples[slot]) * offset / STEP;
+    }
+
+private:
+    int rows;
+    int cols;
+    int freeFlowSeconds;
+    int minimumTravelTime;
+    std::vector<uint8_t> cellProfiles;
+    std::vector<uint16_t> table;
+};
+
+#endif
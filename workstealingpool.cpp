@@ -0,0 +1,122 @@
+#include "workstealingpool.h"
+#include <algorithm>
+#include <thread>
+
+/**
+ * Constructor for the pool, the threads are only started while run is going
+ * @param threads the amount of workers, 0 uses one per hardware thread
+ */
+WorkStealingPool::WorkStealingPool(int threads) {
+    if (threads <= 0) {
+        threads = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+    this->threads = threads;
+    for (int worker = 0; worker < threads; worker++) {
+        shares.push_back(std::unique_ptr<Share>(new Share()));
+    }
+}
+
+int WorkStealingPool::size() const {
+    return threads;
+}
+
+/**
+ * Run task(worker, n) for every n from 0 to count - 1 and wait for all of them. The calling thread is worker 0
+ * @param count how many tasks there are
+ * @param task called once per task number, worker is 0 -> size() - 1 and only one task runs on a worker at a time
+ *             so the worker can index state that belongs to it
+ */
+void WorkStealingPool::run(int count, const std::function<void(int worker, int task)>& task) {
+    for (int worker = 0; worker < threads; worker++) {
+        std::lock_guard<std::mutex> lock(shares[worker]->mutex);
+        shares[worker]->begin = (long long)count * worker / threads;
+        shares[worker]->end = (long long)count * (worker + 1) / threads;
+    }
+    std::vector<std::thread> workers;
+    for (int worker = 1; worker < threads; worker++) {
+        workers.push_back(std::thread([this, worker, &task]() { work(worker, task); }));
+    }
+    work(0, task);
+    for (std::thread& thread : workers) {
+        thread.join();
+    }
+}
+
+/**
+ * @return how many times a worker took work from another one, over every run
+ */
+long long WorkStealingPool::getSteals() const {
+    return steals.load();
+}
+
+/**
+ * Take the next task from the front of a workers own share
+ * @return false if its share is empty
+ */
+bool WorkStealingPool::takeOwn(int worker, int& task) {
+    Share& share = *shares[worker];
+    std::lock_guard<std::mutex> lock(share.mutex);
+    if (share.begin >= share.end) {
+        return false;
+    }
+    task = share.begin++;
+    return true;
+}
+
+/**
+ * Move the back half of the biggest share over to a worker that ran out, only one lock is held at a time
+ * @return false if there was nothing left anywhere
+ */
+bool WorkStealingPool::steal(int worker) {
+    while (true) {
+        int victim = -1;
+        int most = 0;
+        for (int other = 0; other < threads; other++) {
+            if (other == worker) {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(shares[other]->mutex);
+            if (shares[other]->end - shares[other]->begin > most) {
+                most = shares[other]->end - shares[other]->begin;
+                victim = other;
+            }
+        }
+        if (victim < 0) {
+            return false;
+        }
+
+        int begin;
+        int end;
+        {
+            std::lock_guard<std::mutex> lock(shares[victim]->mutex);
+            int left = shares[victim]->end - shares[victim]->begin;
+            // someone else got there first, look again
+            if (left <= 0) {
+                continue;
+            }
+            end = shares[victim]->end;
+            begin = end - (left + 1) / 2;
+            shares[victim]->end = begin;
+        }
+        std::lock_guard<std::mutex> lock(shares[worker]->mutex);
+        shares[worker]->begin = begin;
+        shares[worker]->end = end;
+        steals++;
+        return true;
+    }
+}
+
+/**
+ * Run tasks until there are none left in any share, tasks never add more so an empty pool stays empty
+ */
+void WorkStealingPool::work(int worker, const std::function<void(int worker, int task)>& task) {
+    int next;
+    while (true) {
+        if (takeOwn(worker, next)) {
+            task(worker, next);
+        } else if (!steal(worker)) {
+            // what was stolen can be stolen again before it is taken, so only an empty pool ends the loop
+            return;
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/*
+ * Runs a numbered batch of independent tasks on a fixed amount of workers with work stealing. Every worker starts
+ * with an even share of the task numbers and takes them from the front of its own share, so workers dont touch each
+ * others state while they all have work. A worker that runs out steals the back half of whatever share has the most
+ * left, which evens the load out when some tasks take much longer than others.
+ * Unlike ThreadPool there is no shared queue that every task goes through
+ */
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(int threads = 0);
+
+    int size() const;
+    void run(int count, const std::function<void(int worker, int task)>& task);
+    long long getSteals() const;
+
+private:
+    // the task numbers [begin, end) a worker still has to run, on its own cache line
+    struct alignas(64) Share {
+        std::mutex mutex;
+        int begin = 0;
+        int end = 0;
+    };
+
+    int threads;
+    std::vector<std::unique_ptr<Share>> shares;
+    std::atomic<long long> steals{0};
+
+    bool takeOwn(int worker, int& task);
+    bool steal(int worker);
+    void work(int worker, const std::function<void(int worker, int task)>& task);
+};
+
+#endif